@@ -46,6 +46,14 @@
 #include <cstring>
 #include <climits>
 
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+  #include <xmmintrin.h>
+#endif
+#if defined(__SSSE3__)
+  #include <tmmintrin.h>
+#endif
+
 // Static variable definitions.
 const unsigned int RtApi::MAX_SAMPLE_RATES = 14;
 const unsigned int RtApi::SAMPLE_RATES[] = {
@@ -58,15 +66,33 @@ const unsigned int RtApi::SAMPLE_RATES[] = {
   #define MUTEX_DESTROY(A)    DeleteCriticalSection(A)
   #define MUTEX_LOCK(A)       EnterCriticalSection(A)
   #define MUTEX_UNLOCK(A)     LeaveCriticalSection(A)
+  #define ATOMIC_LOAD(A)      InterlockedCompareExchange( (LONG volatile *) (A), 0, 0 )
+  #define ATOMIC_STORE(A,V)   InterlockedExchange( (LONG volatile *) (A), (LONG) (V) )
+  #define ATOMIC_INC(A)       InterlockedIncrement( (LONG volatile *) (A) )
+  #define ATOMIC_DEC(A)       InterlockedDecrement( (LONG volatile *) (A) )
+  #define THREAD_YIELD()      Sleep( 0 )
 #elif defined(__LINUX_ALSA__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
   // pthread API
   #define MUTEX_INITIALIZE(A) pthread_mutex_init(A, NULL)
   #define MUTEX_DESTROY(A)    pthread_mutex_destroy(A)
   #define MUTEX_LOCK(A)       pthread_mutex_lock(A)
   #define MUTEX_UNLOCK(A)     pthread_mutex_unlock(A)
+  // sequentially consistent, so the enterCallback() / setStreamState()
+  // write-then-load pairs cannot both miss each other
+  #include <sched.h>
+  #define ATOMIC_LOAD(A)      __atomic_load_n( (int *) (A), __ATOMIC_SEQ_CST )
+  #define ATOMIC_STORE(A,V)   __atomic_store_n( (int *) (A), (int) (V), __ATOMIC_SEQ_CST )
+  #define ATOMIC_INC(A)       __atomic_fetch_add( (int *) (A), 1, __ATOMIC_SEQ_CST )
+  #define ATOMIC_DEC(A)       __atomic_fetch_sub( (int *) (A), 1, __ATOMIC_SEQ_CST )
+  #define THREAD_YIELD()      sched_yield()
 #else
   #define MUTEX_INITIALIZE(A) abs(*A) // dummy definitions
   #define MUTEX_DESTROY(A)    abs(*A) // dummy definitions
+  #define ATOMIC_LOAD(A)      (*(A))  // dummy definitions
+  #define ATOMIC_STORE(A,V)   (*(A) = (V))
+  #define ATOMIC_INC(A)       (++*(A))
+  #define ATOMIC_DEC(A)       (--*(A))
+  #define THREAD_YIELD()
 #endif
 
 // *************************************************** //
@@ -326,6 +352,34 @@ void RtApi :: tickStreamTime( void )
 #endif
 }
 
+bool RtApi :: enterCallback( void )
+{
+  // Announce the callback before checking the state; setStreamState()
+  // does the reverse, so at least one side sees the other.  A count,
+  // not a flag: a CoreAudio duplex stream on two devices runs this on
+  // both devices' IOProcs at once.
+  ATOMIC_INC( &stream_.callbackActive );
+  if ( ATOMIC_LOAD( &stream_.state ) == STREAM_RUNNING ) return true;
+
+  ATOMIC_DEC( &stream_.callbackActive );
+  return false;
+}
+
+void RtApi :: leaveCallback( void )
+{
+  ATOMIC_DEC( &stream_.callbackActive );
+}
+
+void RtApi :: setStreamState( StreamState state )
+{
+  ATOMIC_STORE( &stream_.state, state );
+  if ( state == STREAM_RUNNING ) return;
+
+  // The section is one block of device I/O at most, so spin it out.
+  while ( ATOMIC_LOAD( &stream_.callbackActive ) )
+    THREAD_YIELD();
+}
+
 long RtApi :: getStreamLatency( void )
 {
   verifyStream();
@@ -1378,7 +1432,7 @@ void RtApiCore :: startStream( void )
 
   handle->drainCounter = 0;
   handle->internalDrain = false;
-  stream_.state = STREAM_RUNNING;
+  setStreamState( STREAM_RUNNING );
 
  unlock:
   MUTEX_UNLOCK( &stream_.mutex );
@@ -1434,7 +1488,7 @@ void RtApiCore :: stopStream( void )
     }
   }
 
-  stream_.state = STREAM_STOPPED;
+  setStreamState( STREAM_STOPPED );
 
  unlock:
   MUTEX_UNLOCK( &stream_.mutex );
@@ -1476,18 +1530,17 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
   if ( handle->drainCounter > 3 ) {
     if ( handle->internalDrain == true )
       stopStream();
-    else // external call to stopStream()
+    else { // external call to stopStream(), which waits on the condition
+      MUTEX_LOCK( &stream_.mutex );
       pthread_cond_signal( &handle->condition );
+      MUTEX_UNLOCK( &stream_.mutex );
+    }
     return SUCCESS;
   }
 
-  MUTEX_LOCK( &stream_.mutex );
-
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_UNLOCK( &stream_.mutex );
-    return SUCCESS;
-  }
+  // No mutex on the per-block path; stopStream() waits for this
+  // section to finish before the stream is marked stopped.
+  if ( !enterCallback() ) return SUCCESS;
 
   AudioDeviceID outputDevice = handle->id[0];
 
@@ -1510,7 +1563,7 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
     handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
                                      stream_.bufferSize, streamTime, status, info->userData );
     if ( handle->drainCounter == 2 ) {
-      MUTEX_UNLOCK( &stream_.mutex );
+      leaveCallback();
       abortStream();
       return SUCCESS;
     }
@@ -1618,7 +1671,7 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
 
     if ( handle->drainCounter ) {
       handle->drainCounter++;
-      goto unlock;
+      goto leave;
     }
   }
 
@@ -1712,8 +1765,8 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
     }
   }
 
- unlock:
-  MUTEX_UNLOCK( &stream_.mutex );
+ leave:
+  leaveCallback();
 
   RtApi::tickStreamTime();
   return SUCCESS;
@@ -2354,7 +2407,7 @@ void RtApiJack :: startStream( void )
 
   handle->drainCounter = 0;
   handle->internalDrain = false;
-  stream_.state = STREAM_RUNNING;
+  setStreamState( STREAM_RUNNING );
 
  unlock:
   MUTEX_UNLOCK(&stream_.mutex);
@@ -2388,8 +2441,12 @@ void RtApiJack :: stopStream( void )
     }
   }
 
+  // jack_deactivate() waits out the process cycle, which may be
+  // taking the mutex to signal the drain, so don't hold it across.
+  MUTEX_UNLOCK( &stream_.mutex );
   jack_deactivate( handle->client );
-  stream_.state = STREAM_STOPPED;
+  MUTEX_LOCK( &stream_.mutex );
+  setStreamState( STREAM_STOPPED );
 
   MUTEX_UNLOCK( &stream_.mutex );
 }
@@ -2445,18 +2502,17 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
   if ( handle->drainCounter > 3 ) {
     if ( handle->internalDrain == true )
       pthread_create( &threadId, NULL, jackStopStream, info );
-    else
+    else { // external call to stopStream(), which waits on the condition
+      MUTEX_LOCK( &stream_.mutex );
       pthread_cond_signal( &handle->condition );
+      MUTEX_UNLOCK( &stream_.mutex );
+    }
     return SUCCESS;
   }
 
-  MUTEX_LOCK( &stream_.mutex );
-
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_UNLOCK( &stream_.mutex );
-    return SUCCESS;
-  }
+  // No mutex on the per-block path; stopStream() waits for this
+  // section to finish before the stream is marked stopped.
+  if ( !enterCallback() ) return SUCCESS;
 
   // Invoke user callback first, to get fresh output data.
   if ( handle->drainCounter == 0 ) {
@@ -2474,7 +2530,7 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
     handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
                                      stream_.bufferSize, streamTime, status, info->userData );
     if ( handle->drainCounter == 2 ) {
-      MUTEX_UNLOCK( &stream_.mutex );
+      leaveCallback();
       ThreadHandle id;
       pthread_create( &id, NULL, jackStopStream, info );
       return SUCCESS;
@@ -2513,7 +2569,7 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
 
     if ( handle->drainCounter ) {
       handle->drainCounter++;
-      goto unlock;
+      goto leave;
     }
   }
 
@@ -2534,8 +2590,8 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
     }
   }
 
- unlock:
-  MUTEX_UNLOCK(&stream_.mutex);
+ leave:
+  leaveCallback();
 
   RtApi::tickStreamTime();
   return SUCCESS;
@@ -5150,11 +5206,14 @@ struct AlsaHandle {
   snd_pcm_t *handles[2];
   bool synchronized;
   bool xrun[2];
+  bool mmap;                      // capture uses mmap access
+  snd_pcm_format_t captureFormat; // device sample format, for snd_pcm_areas_copy()
+  std::vector<snd_pcm_channel_area_t> captureAreas; // mmap gather target, one per device channel
   pthread_cond_t runnable_cv;
   bool runnable;
 
   AlsaHandle()
-    :synchronized(false), runnable(false) { xrun[0] = false; xrun[1] = false; }
+    :synchronized(false), mmap(false), captureFormat(SND_PCM_FORMAT_UNKNOWN), runnable(false) { xrun[0] = false; xrun[1] = false; }
 };
 
 extern "C" void *alsaCallbackHandler( void * ptr );
@@ -5583,26 +5642,44 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   snd_pcm_hw_params_dump( hw_params, out );
 #endif
 
-  // Set access ... check user preference.
-  if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
-    stream_.userInterleaved = false;
-    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
+  // Set access ... check user preference.  Capture streams opened with
+  // RTAUDIO_ALSA_MMAP try the mmap access types first and fall back to
+  // read/write access if the device refuses both.
+  bool useMmap = false;
+  if ( mode == INPUT && options && options->flags & RTAUDIO_ALSA_MMAP ) {
+    bool planar = ( options->flags & RTAUDIO_NONINTERLEAVED ) != 0;
+    stream_.userInterleaved = !planar;
+    result = snd_pcm_hw_params_set_access( phandle, hw_params, planar ? SND_PCM_ACCESS_MMAP_NONINTERLEAVED : SND_PCM_ACCESS_MMAP_INTERLEAVED );
     if ( result < 0 ) {
-      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
-      stream_.deviceInterleaved[mode] =  true;
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, planar ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_MMAP_NONINTERLEAVED );
+      stream_.deviceInterleaved[mode] = planar;
     }
     else
-      stream_.deviceInterleaved[mode] = false;
+      stream_.deviceInterleaved[mode] = !planar;
+    useMmap = ( result >= 0 );
   }
-  else {
-    stream_.userInterleaved = true;
-    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
-    if ( result < 0 ) {
+
+  if ( !useMmap ) {
+    if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
+      stream_.userInterleaved = false;
       result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
-      stream_.deviceInterleaved[mode] =  false;
+      if ( result < 0 ) {
+        result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
+        stream_.deviceInterleaved[mode] =  true;
+      }
+      else
+        stream_.deviceInterleaved[mode] = false;
+    }
+    else {
+      stream_.userInterleaved = true;
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
+      if ( result < 0 ) {
+        result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
+        stream_.deviceInterleaved[mode] =  false;
+      }
+      else
+        stream_.deviceInterleaved[mode] =  true;
     }
-    else
-      stream_.deviceInterleaved[mode] =  true;
   }
 
   if ( result < 0 ) {
@@ -5797,6 +5874,8 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   snd_pcm_sw_params_set_start_threshold( phandle, sw_params, *bufferSize );
   snd_pcm_sw_params_set_stop_threshold( phandle, sw_params, ULONG_MAX );
   snd_pcm_sw_params_set_silence_threshold( phandle, sw_params, 0 );
+  // mmap capture waits in snd_pcm_wait(), so wake only for a full block.
+  if ( useMmap ) snd_pcm_sw_params_set_avail_min( phandle, sw_params, *bufferSize );
 
   // The following two settings were suggested by Theo Veenker
   //snd_pcm_sw_params_set_avail_min( phandle, sw_params, *bufferSize );
@@ -5855,6 +5934,11 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     apiInfo = (AlsaHandle *) stream_.apiHandle;
   }
   apiInfo->handles[mode] = phandle;
+  if ( mode == INPUT ) {
+    apiInfo->mmap = useMmap;
+    apiInfo->captureFormat = deviceFormat;
+    if ( useMmap ) apiInfo->captureAreas.resize( stream_.nDeviceChannels[1] );
+  }
 
   // Allocate necessary internal buffers.
   unsigned long bufferBytes;
@@ -6068,7 +6152,7 @@ void RtApiAlsa :: startStream()
     }
   }
 
-  stream_.state = STREAM_RUNNING;
+  setStreamState( STREAM_RUNNING );
 
  unlock:
   apiInfo->runnable = true;
@@ -6088,17 +6172,16 @@ void RtApiAlsa :: stopStream()
     return;
   }
 
-  stream_.state = STREAM_STOPPED;
   MUTEX_LOCK( &stream_.mutex );
 
-  //if ( stream_.state == STREAM_STOPPED ) {
-  //  MUTEX_UNLOCK( &stream_.mutex );
-  //  return;
-  //}
-
+  // Park the callback thread and wait out any block it is moving
+  // before touching the device.
   int result = 0;
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
+  apiInfo->runnable = false;
+  setStreamState( STREAM_STOPPED );
+
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
     if ( apiInfo->synchronized ) 
       result = snd_pcm_drop( handle[0] );
@@ -6121,7 +6204,6 @@ void RtApiAlsa :: stopStream()
   }
 
  unlock:
-  stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
 
   if ( result >= 0 ) return;
@@ -6137,17 +6219,14 @@ void RtApiAlsa :: abortStream()
     return;
   }
 
-  stream_.state = STREAM_STOPPED;
   MUTEX_LOCK( &stream_.mutex );
 
-  //if ( stream_.state == STREAM_STOPPED ) {
-  //  MUTEX_UNLOCK( &stream_.mutex );
-  //  return;
-  //}
-
   int result = 0;
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
+  apiInfo->runnable = false;
+  setStreamState( STREAM_STOPPED );
+
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
     result = snd_pcm_drop( handle[0] );
     if ( result < 0 ) {
@@ -6167,7 +6246,6 @@ void RtApiAlsa :: abortStream()
   }
 
  unlock:
-  stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
 
   if ( result >= 0 ) return;
@@ -6195,6 +6273,15 @@ void RtApiAlsa :: callbackEvent()
     return;
   }
 
+  // With mmap capture the block is fetched before the callback runs, so
+  // the callback can read it in place from the device ring.
+  char *inputBuffer = stream_.userBuffer[1];
+  unsigned long mmapOffset = 0, mmapFrames = 0;
+  if ( apiInfo->mmap && stream_.mode != OUTPUT && enterCallback() ) {
+    inputBuffer = captureMmap( &mmapOffset, &mmapFrames );
+    leaveCallback();
+  }
+
   int doStopStream = 0;
   RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
   double streamTime = getStreamTime();
@@ -6207,7 +6294,7 @@ void RtApiAlsa :: callbackEvent()
     status |= RTAUDIO_INPUT_OVERFLOW;
     apiInfo->xrun[1] = false;
   }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+  doStopStream = callback( stream_.userBuffer[0], inputBuffer,
                            stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
 
   if ( doStopStream == 2 ) {
@@ -6215,10 +6302,19 @@ void RtApiAlsa :: callbackEvent()
     return;
   }
 
-  MUTEX_LOCK( &stream_.mutex );
+  // No mutex here: stopStream() and abortStream() wait for this
+  // section to finish before they touch the device.
+  if ( !enterCallback() ) goto tick;
 
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) goto unlock;
+  // Hand the ring region back once the callback is done reading it.
+  if ( mmapFrames > 0 ) {
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit( apiInfo->handles[1], mmapOffset, mmapFrames );
+    if ( committed != (snd_pcm_sframes_t) mmapFrames ) {
+      errorStream_ << "RtApiAlsa::callbackEvent: error committing mmap capture area, " << snd_strerror( (int) committed ) << ".";
+      errorText_ = errorStream_.str();
+      error( RtError::WARNING );
+    }
+  }
 
   int result;
   char *buffer;
@@ -6228,7 +6324,13 @@ void RtApiAlsa :: callbackEvent()
   RtAudioFormat format;
   handle = (snd_pcm_t **) apiInfo->handles;
 
-  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && apiInfo->mmap ) {
+
+    // The next block is fetched by captureMmap() ahead of the callback.
+    result = snd_pcm_delay( handle[1], &frames );
+    if ( result == 0 && frames > 0 ) stream_.latency[1] = frames;
+  }
+  else if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
 
     // Setup parameters.
     if ( stream_.doConvertBuffer[1] ) {
@@ -6345,7 +6447,7 @@ void RtApiAlsa :: callbackEvent()
         errorText_ = errorStream_.str();
       }
       error( RtError::WARNING );
-      goto unlock;
+      goto leave;
     }
 
     // Check stream latency
@@ -6353,13 +6455,147 @@ void RtApiAlsa :: callbackEvent()
     if ( result == 0 && frames > 0 ) stream_.latency[0] = frames;
   }
 
- unlock:
-  MUTEX_UNLOCK( &stream_.mutex );
+ leave:
+  leaveCallback();
 
+ tick:
   RtApi::tickStreamTime();
   if ( doStopStream == 1 ) this->stopStream();
 }
 
+// Wait for a full block in the mmap capture ring and hand it to the
+// callback.  If the block is contiguous, interleaved and needs no byte
+// swapping, it is either passed through in place -- the region then stays
+// mapped until callbackEvent() commits it, and *offset / *frames describe
+// it -- or converted in one pass from the ring into the user buffer.
+// Anything else is gathered out of the ring and committed here.
+char *RtApiAlsa :: captureMmap( unsigned long *offset, unsigned long *frames )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[1];
+  snd_pcm_uframes_t bufferSize = stream_.bufferSize;
+  *offset = 0;
+  *frames = 0;
+
+  // Wait for the block, restarting the device after an overrun.
+  int result;
+  snd_pcm_sframes_t avail;
+  while ( true ) {
+    if ( stream_.state != STREAM_RUNNING ) return stream_.userBuffer[1];
+
+    avail = 0;
+    if ( snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED )
+      avail = snd_pcm_start( handle );
+    if ( avail == 0 ) {
+      avail = snd_pcm_avail_update( handle );
+      if ( avail >= (snd_pcm_sframes_t) bufferSize ) break;
+      if ( avail >= 0 ) avail = snd_pcm_wait( handle, 1000 );
+      if ( avail >= 0 ) continue;
+    }
+
+    if ( stream_.state != STREAM_RUNNING ) return stream_.userBuffer[1];
+    if ( avail == -EPIPE && snd_pcm_state( handle ) == SND_PCM_STATE_XRUN ) {
+      apiInfo->xrun[1] = true;
+      result = snd_pcm_prepare( handle );
+      if ( result >= 0 ) continue;
+      errorStream_ << "RtApiAlsa::captureMmap: error preparing device after overrun, " << snd_strerror( result ) << ".";
+    }
+    else
+      errorStream_ << "RtApiAlsa::captureMmap: error waiting for capture data, " << snd_strerror( (int) avail ) << ".";
+    errorText_ = errorStream_.str();
+    error( RtError::WARNING );
+    return stream_.userBuffer[1];
+  }
+
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t mapOffset, mapFrames = bufferSize;
+  result = snd_pcm_mmap_begin( handle, &areas, &mapOffset, &mapFrames );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::captureMmap: error mapping capture area, " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    error( RtError::WARNING );
+    return stream_.userBuffer[1];
+  }
+
+  unsigned int i, channels = stream_.nDeviceChannels[1];
+  unsigned int bits = formatBytes( stream_.deviceFormat[1] ) * 8;
+  bool inPlace = ( mapFrames == bufferSize && !stream_.doByteSwap[1] );
+  for ( i=0; inPlace && i<channels; i++ )
+    inPlace = ( areas[i].addr == areas[0].addr && areas[i].first == areas[0].first + i * bits &&
+                areas[i].step == channels * bits );
+
+  snd_pcm_sframes_t committed;
+  if ( inPlace ) {
+    char *ring = (char *) areas[0].addr + ( areas[0].first + mapOffset * areas[0].step ) / 8;
+    if ( !stream_.doConvertBuffer[1] ) {
+      *offset = mapOffset;
+      *frames = mapFrames;
+      return ring;
+    }
+
+    convertBuffer( stream_.userBuffer[1], ring, stream_.convertInfo[1] );
+    committed = snd_pcm_mmap_commit( handle, mapOffset, mapFrames );
+    if ( committed != (snd_pcm_sframes_t) mapFrames ) {
+      errorStream_ << "RtApiAlsa::captureMmap: error committing capture area, " << snd_strerror( (int) committed ) << ".";
+      errorText_ = errorStream_.str();
+      error( RtError::WARNING );
+    }
+    return stream_.userBuffer[1];
+  }
+
+  // Gather the block in the device layout (the ring may wrap mid-block),
+  // then byte swap and convert as the read/write path does.
+  char *buffer = stream_.doConvertBuffer[1] ? stream_.deviceBuffer : stream_.userBuffer[1];
+  snd_pcm_channel_area_t *dst = &apiInfo->captureAreas[0];
+  for ( i=0; i<channels; i++ ) {
+    if ( stream_.deviceInterleaved[1] ) {
+      dst[i].addr = buffer;
+      dst[i].first = i * bits;
+      dst[i].step = channels * bits;
+    }
+    else {
+      dst[i].addr = buffer + i * bufferSize * ( bits / 8 );
+      dst[i].first = 0;
+      dst[i].step = bits;
+    }
+  }
+
+  snd_pcm_uframes_t done = 0;
+  while ( true ) {
+    snd_pcm_areas_copy( dst, done, areas, mapOffset, channels, mapFrames, apiInfo->captureFormat );
+    committed = snd_pcm_mmap_commit( handle, mapOffset, mapFrames );
+    if ( committed != (snd_pcm_sframes_t) mapFrames ) {
+      result = (int) committed;
+      break;
+    }
+    done += mapFrames;
+    if ( done >= bufferSize ) break;
+
+    mapFrames = bufferSize - done;
+    result = snd_pcm_mmap_begin( handle, &areas, &mapOffset, &mapFrames );
+    if ( result < 0 ) break;
+    if ( mapFrames == 0 ) {
+      result = -EIO;
+      break;
+    }
+  }
+
+  if ( done < bufferSize ) {
+    errorStream_ << "RtApiAlsa::captureMmap: error reading capture area, " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    error( RtError::WARNING );
+    return stream_.userBuffer[1];
+  }
+
+  if ( stream_.doByteSwap[1] )
+    byteSwapBuffer( buffer, bufferSize * channels, stream_.deviceFormat[1] );
+
+  if ( stream_.doConvertBuffer[1] )
+    convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
+
+  return stream_.userBuffer[1];
+}
+
 extern "C" void *alsaCallbackHandler( void *ptr )
 {
   CallbackInfo *info = (CallbackInfo *) ptr;
@@ -7034,7 +7270,7 @@ void RtApiOss :: startStream()
 
   MUTEX_LOCK( &stream_.mutex );
 
-  stream_.state = STREAM_RUNNING;
+  setStreamState( STREAM_RUNNING );
 
   // No need to do anything else here ... OSS automatically starts
   // when fed samples.
@@ -7062,6 +7298,9 @@ void RtApiOss :: stopStream()
     return;
   }
 
+  // Wait out any block the callback thread is moving before flushing.
+  setStreamState( STREAM_STOPPED );
+
   int result = 0;
   OssHandle *handle = (OssHandle *) stream_.apiHandle;
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
@@ -7110,7 +7349,6 @@ void RtApiOss :: stopStream()
   }
 
  unlock:
-  stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
 
   if ( result != -1 ) return;
@@ -7134,6 +7372,8 @@ void RtApiOss :: abortStream()
     return;
   }
 
+  setStreamState( STREAM_STOPPED );
+
   int result = 0;
   OssHandle *handle = (OssHandle *) stream_.apiHandle;
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
@@ -7156,7 +7396,6 @@ void RtApiOss :: abortStream()
   }
 
  unlock:
-  stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
 
   if ( result != -1 ) return;
@@ -7202,10 +7441,9 @@ void RtApiOss :: callbackEvent()
     return;
   }
 
-  MUTEX_LOCK( &stream_.mutex );
-
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) goto unlock;
+  // No mutex here: stopStream() and abortStream() wait for this
+  // section to finish before they touch the device.
+  if ( !enterCallback() ) goto tick;
 
   int result;
   char *buffer;
@@ -7276,7 +7514,7 @@ void RtApiOss :: callbackEvent()
       handle->xrun[1] = true;
       errorText_ = "RtApiOss::callbackEvent: audio read error.";
       error( RtError::WARNING );
-      goto unlock;
+      goto leave;
     }
 
     // Do byte swapping if necessary.
@@ -7288,9 +7526,10 @@ void RtApiOss :: callbackEvent()
       convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
   }
 
- unlock:
-  MUTEX_UNLOCK( &stream_.mutex );
+ leave:
+  leaveCallback();
 
+ tick:
   RtApi::tickStreamTime();
   if ( doStopStream == 1 ) this->stopStream();
 }
@@ -7342,6 +7581,7 @@ void RtApi :: clearStreamInfo()
 {
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
+  stream_.callbackActive = 0;
   stream_.sampleRate = 0;
   stream_.bufferSize = 0;
   stream_.nBuffers = 0;
@@ -7371,6 +7611,7 @@ void RtApi :: clearStreamInfo()
     stream_.convertInfo[i].outFormat = 0;
     stream_.convertInfo[i].inOffset.clear();
     stream_.convertInfo[i].outOffset.clear();
+    stream_.convertInfo[i].layout = CONVERT_GENERIC;
   }
 }
 
@@ -7470,6 +7711,213 @@ void RtApi :: setConvertInfo( StreamMode mode, unsigned int firstChannel )
       }
     }
   }
+
+  // Recognize the layouts convertBufferFast() handles.
+  ConvertInfo &info = stream_.convertInfo[mode];
+  int channels = info.channels;
+  bool inFrames = true, outFrames = true, inPlanes = true, outPlanes = true;
+  for ( int k=0; k<channels; k++ ) {
+    inFrames = inFrames && info.inOffset[k] == k;
+    outFrames = outFrames && info.outOffset[k] == k;
+    inPlanes = inPlanes && info.inOffset[k] == (int) ( k * stream_.bufferSize );
+    outPlanes = outPlanes && info.outOffset[k] == (int) ( k * stream_.bufferSize );
+  }
+  inFrames = inFrames && info.inJump == channels;
+  outFrames = outFrames && info.outJump == channels;
+  inPlanes = inPlanes && info.inJump == 1;
+  outPlanes = outPlanes && info.outJump == 1;
+
+  info.layout = CONVERT_GENERIC;
+  if ( ( inFrames && outFrames ) || ( inPlanes && outPlanes ) )
+    info.layout = CONVERT_CONTIGUOUS;
+  else if ( inFrames && outPlanes &&
+            ( channels == 1 || channels == 2 || channels == 4 || channels == 8 ) )
+    info.layout = CONVERT_DEINTERLEAVE;
+}
+
+// Vectorized conversion kernels.  Each one performs exactly the arithmetic
+// of the matching scalar loop in convertBuffer() (same operations, same
+// order, same rounding), so the results are bit-identical; the scalar tail
+// loops are written the same way.
+
+static void int16ToFloat32( const short *in, float *out, unsigned long n )
+{
+  const float scale = (float) ( 1.0 / 32767.5 );
+  unsigned long i = 0;
+#if defined(__SSE2__)
+  const __m128 half = _mm_set1_ps( 0.5f ), vscale = _mm_set1_ps( scale );
+  for ( ; i+8<=n; i+=8 ) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) ( in + i ) );
+    __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 );
+    __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 );
+    _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( lo ), half ), vscale ) );
+    _mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( hi ), half ), vscale ) );
+  }
+#endif
+  for ( ; i<n; i++ ) {
+    out[i] = (float) in[i];
+    out[i] += 0.5;
+    out[i] *= scale;
+  }
+}
+
+// 24-bit samples sit in the lower three bytes of a 32-bit word.
+static void int24ToFloat32( const int *in, float *out, unsigned long n )
+{
+  const float scale = (float) ( 1.0 / 8388607.5 );
+  unsigned long i = 0;
+#if defined(__SSE2__)
+  const __m128 half = _mm_set1_ps( 0.5f ), vscale = _mm_set1_ps( scale );
+  const __m128i mask = _mm_set1_epi32( 0x00ffffff );
+  for ( ; i+4<=n; i+=4 ) {
+    __m128i v = _mm_and_si128( _mm_loadu_si128( (const __m128i *) ( in + i ) ), mask );
+    _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( v ), half ), vscale ) );
+  }
+#endif
+  for ( ; i<n; i++ ) {
+    out[i] = (float) ( in[i] & 0x00ffffff );
+    out[i] += 0.5;
+    out[i] *= scale;
+  }
+}
+
+static void int32ToFloat32( const int *in, float *out, unsigned long n )
+{
+  const float scale = (float) ( 1.0 / 2147483647.5 );
+  unsigned long i = 0;
+#if defined(__SSE2__)
+  const __m128 half = _mm_set1_ps( 0.5f ), vscale = _mm_set1_ps( scale );
+  for ( ; i+4<=n; i+=4 ) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) ( in + i ) );
+    _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( v ), half ), vscale ) );
+  }
+#endif
+  for ( ; i<n; i++ ) {
+    out[i] = (float) in[i];
+    out[i] += 0.5;
+    out[i] *= scale;
+  }
+}
+
+// The scalar path computes in double and truncates, keeping the low 16 bits
+// of the 32-bit result; the vector path does the same.
+static void float32ToInt16( const float *in, short *out, unsigned long n )
+{
+  unsigned long i = 0;
+#if defined(__SSE2__)
+  const __m128d scale = _mm_set1_pd( 32767.5 ), half = _mm_set1_pd( 0.5 );
+  for ( ; i+4<=n; i+=4 ) {
+    __m128 f = _mm_loadu_ps( in + i );
+    __m128d lo = _mm_sub_pd( _mm_mul_pd( _mm_cvtps_pd( f ), scale ), half );
+    __m128d hi = _mm_sub_pd( _mm_mul_pd( _mm_cvtps_pd( _mm_movehl_ps( f, f ) ), scale ), half );
+    __m128i v = _mm_unpacklo_epi64( _mm_cvttpd_epi32( lo ), _mm_cvttpd_epi32( hi ) );
+    v = _mm_srai_epi32( _mm_slli_epi32( v, 16 ), 16 );
+    _mm_storel_epi64( (__m128i *) ( out + i ), _mm_packs_epi32( v, v ) );
+  }
+#endif
+  for ( ; i<n; i++ )
+    out[i] = (short) ( in[i] * 32767.5 - 0.5 );
+}
+
+// Split interleaved frames into planes that are stride samples apart.
+static void deinterleaveFloat32( const float *in, float *out, int channels,
+                                 unsigned long frames, unsigned long stride )
+{
+  unsigned long i = 0;
+  if ( channels == 1 ) {
+    memcpy( out, in, frames * sizeof(float) );
+    return;
+  }
+#if defined(__SSE2__)
+  if ( channels == 2 ) {
+    for ( ; i+4<=frames; i+=4 ) {
+      __m128 a = _mm_loadu_ps( in + 2*i ), b = _mm_loadu_ps( in + 2*i + 4 );
+      _mm_storeu_ps( out + i, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+      _mm_storeu_ps( out + stride + i, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+    }
+  }
+  else if ( channels == 4 ) {
+    for ( ; i+4<=frames; i+=4 ) {
+      __m128 r0 = _mm_loadu_ps( in + 4*i ), r1 = _mm_loadu_ps( in + 4*i + 4 );
+      __m128 r2 = _mm_loadu_ps( in + 4*i + 8 ), r3 = _mm_loadu_ps( in + 4*i + 12 );
+      _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+      _mm_storeu_ps( out + i, r0 );
+      _mm_storeu_ps( out + stride + i, r1 );
+      _mm_storeu_ps( out + 2*stride + i, r2 );
+      _mm_storeu_ps( out + 3*stride + i, r3 );
+    }
+  }
+  else if ( channels == 8 ) {
+    for ( ; i+4<=frames; i+=4 ) {
+      for ( int h=0; h<2; h++ ) {
+        // Channels 4h .. 4h+3 of four frames.
+        const float *p = in + 8*i + 4*h;
+        __m128 r0 = _mm_loadu_ps( p ), r1 = _mm_loadu_ps( p + 8 );
+        __m128 r2 = _mm_loadu_ps( p + 16 ), r3 = _mm_loadu_ps( p + 24 );
+        _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+        float *o = out + 4*h*stride + i;
+        _mm_storeu_ps( o, r0 );
+        _mm_storeu_ps( o + stride, r1 );
+        _mm_storeu_ps( o + 2*stride, r2 );
+        _mm_storeu_ps( o + 3*stride, r3 );
+      }
+    }
+  }
+#endif
+  for ( ; i<frames; i++ )
+    for ( int k=0; k<channels; k++ )
+      out[k*stride + i] = in[i*channels + k];
+}
+
+bool RtApi :: convertBufferFast( char *outBuffer, char *inBuffer, ConvertInfo &info )
+{
+  if ( info.layout == CONVERT_GENERIC ) return false;
+
+  bool toFloat32 = info.outFormat == RTAUDIO_FLOAT32 &&
+    ( info.inFormat == RTAUDIO_SINT16 || info.inFormat == RTAUDIO_SINT24 ||
+      info.inFormat == RTAUDIO_SINT32 || info.inFormat == RTAUDIO_FLOAT32 );
+  bool toInt16 = info.outFormat == RTAUDIO_SINT16 && info.inFormat == RTAUDIO_FLOAT32;
+  unsigned long frames = stream_.bufferSize;
+
+  if ( info.layout == CONVERT_CONTIGUOUS ) {
+    unsigned long n = frames * info.channels;
+    if ( toInt16 )
+      float32ToInt16( (Float32 *) inBuffer, (Int16 *) outBuffer, n );
+    else if ( !toFloat32 )
+      return false;
+    else if ( info.inFormat == RTAUDIO_FLOAT32 )
+      memmove( outBuffer, inBuffer, n * sizeof(Float32) );
+    else if ( info.inFormat == RTAUDIO_SINT16 )
+      int16ToFloat32( (Int16 *) inBuffer, (Float32 *) outBuffer, n );
+    else if ( info.inFormat == RTAUDIO_SINT24 )
+      int24ToFloat32( (Int32 *) inBuffer, (Float32 *) outBuffer, n );
+    else
+      int32ToFloat32( (Int32 *) inBuffer, (Float32 *) outBuffer, n );
+    return true;
+  }
+
+  // CONVERT_DEINTERLEAVE: convert a cache-sized run of frames, then split it.
+  if ( !toFloat32 ) return false;
+  const unsigned long CHUNK = 256;
+  Float32 chunk[CHUNK * 8];
+  Float32 *out = (Float32 *) outBuffer;
+  unsigned int inBytes = formatBytes( info.inFormat );
+  for ( unsigned long start=0; start<frames; start+=CHUNK ) {
+    unsigned long count = frames - start < CHUNK ? frames - start : CHUNK;
+    unsigned long n = count * info.channels;
+    char *in = inBuffer + start * info.channels * inBytes;
+    Float32 *src = chunk;
+    if ( info.inFormat == RTAUDIO_FLOAT32 )
+      src = (Float32 *) in;
+    else if ( info.inFormat == RTAUDIO_SINT16 )
+      int16ToFloat32( (Int16 *) in, chunk, n );
+    else if ( info.inFormat == RTAUDIO_SINT24 )
+      int24ToFloat32( (Int32 *) in, chunk, n );
+    else
+      int32ToFloat32( (Int32 *) in, chunk, n );
+    deinterleaveFloat32( src, out + start, info.channels, count, frames );
+  }
+  return true;
 }
 
 void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info )
@@ -7483,6 +7931,8 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
        ( stream_.nDeviceChannels[0] < stream_.nDeviceChannels[1] ) )
     memset( outBuffer, 0, stream_.bufferSize * info.outJump * formatBytes( info.outFormat ) );
 
+  if ( convertBufferFast( outBuffer, inBuffer, info ) ) return;
+
   int j;
   if (info.outFormat == RTAUDIO_FLOAT64) {
     Float64 scale;
@@ -7909,12 +8359,62 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
   //static inline uint32_t bswap_32(uint32_t x) { return (bswap_16(x&0xffff)<<16) | (bswap_16(x>>16)); }
   //static inline uint64_t bswap_64(uint64_t x) { return (((unsigned long long)bswap_32(x&0xffffffffull))<<32) | (bswap_32(x>>32)); }
 
+// Vectorized byte swapping: 16 bytes per step.  Returns the number of
+// samples done; byteSwapBuffer() finishes the tail.  24-bit samples occupy
+// 32-bit words here, so they share the 32-bit path.
+static unsigned int byteSwapVector( char *buffer, unsigned int samples, unsigned int bytes )
+{
+  unsigned int i = 0;
+#if defined(__SSSE3__)
+  const __m128i rev16 = _mm_setr_epi8( 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 );
+  const __m128i rev32 = _mm_setr_epi8( 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 );
+  const __m128i rev64 = _mm_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 );
+  const __m128i order = bytes == 2 ? rev16 : ( bytes == 4 ? rev32 : rev64 );
+  const unsigned int step = 16 / bytes;
+  for ( ; i+step<=samples; i+=step ) {
+    __m128i *p = (__m128i *) ( buffer + i * bytes );
+    _mm_storeu_si128( p, _mm_shuffle_epi8( _mm_loadu_si128( p ), order ) );
+  }
+#elif defined(__SSE2__)
+  const unsigned int step = 16 / bytes;
+  for ( ; i+step<=samples; i+=step ) {
+    __m128i *p = (__m128i *) ( buffer + i * bytes );
+    __m128i v = _mm_loadu_si128( p );
+    // Swap the bytes of every 16-bit word ...
+    v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+    // ... then reverse the word order within each sample.
+    if ( bytes == 4 ) {
+      v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+      v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    }
+    else if ( bytes == 8 ) {
+      v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+      v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+    }
+    _mm_storeu_si128( p, v );
+  }
+#else
+  (void) buffer; (void) samples; (void) bytes;
+#endif
+  return i;
+}
+
 void RtApi :: byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format )
 {
   register char val;
   register char *ptr;
+  unsigned int done = 0;
+
+  if ( format == RTAUDIO_SINT16 )
+    done = byteSwapVector( buffer, samples, 2 );
+  else if ( format == RTAUDIO_SINT24 || format == RTAUDIO_SINT32 ||
+            format == RTAUDIO_FLOAT32 )
+    done = byteSwapVector( buffer, samples, 4 );
+  else if ( format == RTAUDIO_FLOAT64 )
+    done = byteSwapVector( buffer, samples, 8 );
+  ptr = buffer + done * formatBytes( format );
+  samples -= done;
 
-  ptr = buffer;
   if ( format == RTAUDIO_SINT16 ) {
     for ( unsigned int i=0; i<samples; i++ ) {
       // Swap 1st and 2nd bytes.
@@ -87,6 +87,7 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     - \e RTAUDIO_MINIMIZE_LATENCY: Attempt to set stream parameters for lowest possible latency.
     - \e RTAUDIO_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ALSA_MMAP:        Use mmap access for capture (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -118,6 +119,12 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     If the RTAUDIO_ALSA_USE_DEFAULT flag is set, RtAudio will attempt to
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
+
+    If the RTAUDIO_ALSA_MMAP flag is set, an ALSA capture stream is
+    opened with mmap access.  When no format conversion or byte swapping
+    is needed, the callback's input buffer then points directly into the
+    device ring and is only valid for the duration of the callback.
+    Devices that refuse mmap access fall back to read/write access.
 */
 typedef unsigned int RtAudioStreamFlags;
 static const RtAudioStreamFlags RTAUDIO_NONINTERLEAVED = 0x1;    // Use non-interleaved buffers (default = interleaved).
@@ -125,6 +132,7 @@ static const RtAudioStreamFlags RTAUDIO_MINIMIZE_LATENCY = 0x2;  // Attempt to s
 static const RtAudioStreamFlags RTAUDIO_HOG_DEVICE = 0x4;        // Attempt grab device and prevent use by others.
 static const RtAudioStreamFlags RTAUDIO_SCHEDULE_REALTIME = 0x8; // Try to select realtime scheduling for callback thread.
 static const RtAudioStreamFlags RTAUDIO_ALSA_USE_DEFAULT = 0x10; // Use the "default" PCM device (ALSA only).
+static const RtAudioStreamFlags RTAUDIO_ALSA_MMAP = 0x20;        // Use mmap access for capture (ALSA only).
 
 /*! \typedef typedef unsigned long RtAudioStreamStatus;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -257,6 +265,7 @@ class RtAudio
     - \e RTAUDIO_HOG_DEVICE:        Attempt grab device for exclusive use.
     - \e RTAUDIO_SCHEDULE_REALTIME: Attempt to select realtime scheduling for callback thread.
     - \e RTAUDIO_ALSA_USE_DEFAULT:  Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ALSA_MMAP:         Use mmap access for capture (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -291,6 +300,12 @@ class RtAudio
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
 
+    If the RTAUDIO_ALSA_MMAP flag is set, an ALSA capture stream is
+    opened with mmap access.  When no format conversion or byte swapping
+    is needed, the callback's input buffer then points directly into the
+    device ring and is only valid for the duration of the callback.
+    Devices that refuse mmap access fall back to read/write access.
+
     The \c numberOfBuffers parameter can be used to control stream
     latency in the Windows DirectSound, Linux OSS, and Linux Alsa APIs
     only.  A value of two is usually the smallest allowed.  Larger
@@ -305,7 +320,7 @@ class RtAudio
     RtAudio with Jack, each instance must have a unique client name.
   */
   struct StreamOptions {
-    RtAudioStreamFlags flags;      /*!< A bit-mask of stream flags (RTAUDIO_NONINTERLEAVED, RTAUDIO_MINIMIZE_LATENCY, RTAUDIO_HOG_DEVICE, RTAUDIO_ALSA_USE_DEFAULT). */
+    RtAudioStreamFlags flags;      /*!< A bit-mask of stream flags (RTAUDIO_NONINTERLEAVED, RTAUDIO_MINIMIZE_LATENCY, RTAUDIO_HOG_DEVICE, RTAUDIO_ALSA_USE_DEFAULT, RTAUDIO_ALSA_MMAP). */
     unsigned int numberOfBuffers;  /*!< Number of stream buffers. */
     std::string streamName;        /*!< A stream name (currently used only in Jack). */
     int priority;                  /*!< Scheduling priority of callback thread (only used with flag RTAUDIO_SCHEDULE_REALTIME). */
@@ -610,6 +625,13 @@ protected:
     UNINITIALIZED = -75
   };
 
+  // Buffer layouts that convertBuffer() has vectorized paths for.
+  enum ConvertLayout {
+    CONVERT_GENERIC,      // Anything; per-sample offset lookups.
+    CONVERT_CONTIGUOUS,   // Same layout in and out, all channels used.
+    CONVERT_DEINTERLEAVE  // Interleaved in, planar out, 1/2/4/8 channels.
+  };
+
   // A protected structure used for buffer conversion.
   struct ConvertInfo {
     int channels;
@@ -617,6 +639,7 @@ protected:
     RtAudioFormat inFormat, outFormat;
     std::vector<int> inOffset;
     std::vector<int> outOffset;
+    ConvertLayout layout;  // Set by setConvertInfo().
   };
 
   // A protected structure for audio streams.
@@ -625,6 +648,7 @@ protected:
     void *apiHandle;           // void pointer for API specific stream handle information
     StreamMode mode;           // OUTPUT, INPUT, or DUPLEX.
     StreamState state;         // STOPPED, RUNNING, or CLOSED
+    int callbackActive;        // Callback threads in their device I/O section.
     char *userBuffer[2];       // Playback and record, respectively.
     char *deviceBuffer;
     bool doConvertBuffer[2];   // Playback and record, respectively.
@@ -650,7 +674,7 @@ protected:
 #endif
 
     RtApiStream()
-      :apiHandle(0), deviceBuffer(0) { device[0] = 11111; device[1] = 11111; }
+      :apiHandle(0), callbackActive(0), deviceBuffer(0) { device[0] = 11111; device[1] = 11111; }
   };
 
   typedef signed short Int16;
@@ -681,6 +705,21 @@ protected:
   //! Protected common method to clear an RtApiStream structure.
   void clearStreamInfo();
 
+  /*!
+    Protected methods forming a lock-free handshake between the
+    callback thread and the start/stop/close methods, so the callback
+    takes no mutex per block.  The callback brackets its device I/O
+    with enterCallback() / leaveCallback(); enterCallback() returns
+    false once the stream is no longer running.  setStreamState()
+    publishes a new state and, when leaving STREAM_RUNNING, returns
+    only after every callback in that section has left it, so the
+    caller may then stop or drain the device.  The stream mutex and
+    condition variables remain for start/stop transitions only.
+  */
+  bool enterCallback( void );
+  void leaveCallback( void );
+  void setStreamState( StreamState state );
+
   /*!
     Protected common method that throws an RtError (type =
     INVALID_USE) if a stream is not open.
@@ -696,6 +735,13 @@ protected:
   */
   void convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info );
 
+  /*!
+    Protected method holding the vectorized conversions for the common
+    layout/format combinations.  Returns false if the generic path in
+    convertBuffer() has to do the work.  Results are bit-identical.
+  */
+  bool convertBufferFast( char *outBuffer, char *inBuffer, ConvertInfo &info );
+
   //! Protected common method used to perform byte-swapping on buffers.
   void byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format );
 
@@ -907,6 +953,7 @@ public:
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
                         RtAudio::StreamOptions *options );
+  char *captureMmap( unsigned long *offset, unsigned long *frames );
 };
 
 #endif
@@ -952,7 +999,7 @@ public:
   RtApiDummy() { errorText_ = "RtApiDummy: This class provides no functionality."; error( RtError::WARNING ); };
   RtAudio::Api getCurrentApi( void ) { return RtAudio::RTAUDIO_DUMMY; };
   unsigned int getDeviceCount( void ) { return 0; };
-  RtAudio::DeviceInfo getDeviceInfo( unsigned int device ) { RtAudio::DeviceInfo info; return info; };
+  RtAudio::DeviceInfo getDeviceInfo( unsigned int /*device*/ ) { RtAudio::DeviceInfo info; return info; };
   void closeStream( void ) {};
   void startStream( void ) {};
   void stopStream( void ) {};
@@ -960,10 +1007,10 @@ public:
 
   private:
 
-  bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels, 
-                        unsigned int firstChannel, unsigned int sampleRate,
-                        RtAudioFormat format, unsigned int *bufferSize,
-                        RtAudio::StreamOptions *options ) { return false; };
+  bool probeDeviceOpen( unsigned int /*device*/, StreamMode /*mode*/, unsigned int /*channels*/,
+                        unsigned int /*firstChannel*/, unsigned int /*sampleRate*/,
+                        RtAudioFormat /*format*/, unsigned int * /*bufferSize*/,
+                        RtAudio::StreamOptions * /*options*/ ) { return false; };
 };
 
 #endif
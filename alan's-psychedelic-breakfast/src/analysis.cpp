@@ -0,0 +1,256 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - analysis.cpp
+// desc: analysis stage and its thread
+//-----------------------------------------------------------------------------
+#include "analysis.h"
+#include "arena.h"
+#include "cqt.h"
+#include "dsp.h"
+#include "harmony.h"
+#include "loudness.h"
+#include "pitch.h"
+#include "spectral.h"
+#include "threads.h"
+#include <pthread.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+// how long the thread naps when the ring doesn't hold a block yet; a
+// small fraction of a block period, so it adds little latency
+#define POLL_NS 1000000
+
+static Arena g_arena;
+static long g_blockFrames;
+static double g_srate;
+static float * g_block;             // raw block (thread only)
+static float * g_fftBuf;
+static float * g_window;
+static SpectralPack g_spectral;
+static FeatureTracker g_tracker;
+static Cqt g_cqt;
+static HarmonyTracker g_harmony;
+static PitchTracker g_pitch;
+static LoudnessMeter g_loudness;
+static double g_lastStreamTime;   // of the previous block, < 0 = none
+static FeatureFrame g_frame;        // being built
+static NetFeed * g_publisher;
+static ShmBus * g_bus;
+static Recorder * g_recorder;
+// newest finished frame, for readers on other threads
+static pthread_mutex_t g_latestLock = PTHREAD_MUTEX_INITIALIZER;
+static FeatureFrame g_latest;
+static float * g_latestMag;         // and its full magnitude spectrum
+static bool g_haveLatest;
+// the thread
+static pthread_t g_thread;
+static SampleRing * g_ring;
+static int g_running;               // atomic
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: analysis_init()
+// desc: see header
+//-----------------------------------------------------------------------------
+void analysis_init( long blockFrames, double srate, NetFeed * publisher, ShmBus * bus,
+                    Recorder * recorder )
+{
+    g_blockFrames = blockFrames;
+    g_srate = srate;
+    g_publisher = publisher;
+    g_bus = bus;
+    g_recorder = recorder;
+
+    int octaves = FEATURE_SEMITONES / CQT_BINS_PER_OCTAVE;
+    arena_reserve( &g_arena, 3 * arena_size( sizeof(float) * blockFrames ) +
+                   arena_size( sizeof(float) * blockFrames / 2 ) +
+                   spectral_size( blockFrames / 2 ) +
+                   cqt_size( blockFrames, octaves, srate, CQT_DEFAULT_FMIN ) +
+                   pitch_size( blockFrames, srate ) + loudness_size( blockFrames ) );
+    g_block = arena_array<float>( &g_arena, blockFrames );
+    g_fftBuf = arena_array<float>( &g_arena, blockFrames );
+    g_latestMag = arena_array<float>( &g_arena, blockFrames / 2 );
+    g_window = arena_array<float>( &g_arena, blockFrames );
+    hanning( g_window, blockFrames );
+
+    spectral_init( &g_spectral, &g_arena, blockFrames / 2, srate );
+    feature_init( &g_tracker, blockFrames / 2, srate );
+    cqt_init( &g_cqt, &g_arena, blockFrames, octaves, srate, CQT_DEFAULT_FMIN );
+    harmony_init( &g_harmony );
+    pitch_init( &g_pitch, &g_arena, blockFrames, srate );
+    loudness_init( &g_loudness, &g_arena, blockFrames, srate );
+    g_lastStreamTime = -1;
+    g_haveLatest = false;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: finish()
+// desc: stamp g_frame, send it wherever it goes and make it the latest
+//-----------------------------------------------------------------------------
+static void finish( const float * block, const float * mag, double captured )
+{
+    g_frame.time = captured;
+    if( g_publisher )
+        netfeed_publish( g_publisher, &g_frame );
+    if( g_bus )
+        shmbus_write( g_bus, &g_frame, block, g_blockFrames );
+    if( g_recorder )
+        recorder_feature( g_recorder, &g_frame );
+
+    pthread_mutex_lock( &g_latestLock );
+    g_latest = g_frame;
+    memcpy( g_latestMag, mag, sizeof(float) * g_blockFrames / 2 );
+    g_haveLatest = true;
+    pthread_mutex_unlock( &g_latestLock );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: analyze()
+// desc: same windowed fft as the renderer's, then the features. offline,
+//       blocks overlap by however much the frame step is shorter, so the
+//       stages that keep their own history (the constant-Q transform, its
+//       top octaves zero if the rate is too low for them, the pitch and
+//       loudness) take only the frames the block adds; harmony follows
+//       the constant-Q magnitudes
+//-----------------------------------------------------------------------------
+static void analyze( const float * block, float * windowed, double streamTime, double captured )
+{
+    long fresh = g_blockFrames;
+    if( g_lastStreamTime >= 0 && streamTime >= g_lastStreamTime )
+        fresh = lrint( (streamTime - g_lastStreamTime) * g_srate );
+    if( fresh > g_blockFrames )
+        fresh = g_blockFrames;
+    g_lastStreamTime = streamTime;
+    const float * tail = block + g_blockFrames - fresh;
+
+    dsp_rfft( windowed, g_blockFrames / 2, FFT_FORWARD );
+    spectral_process( &g_spectral, (complex *)windowed );
+
+    feature_compute( &g_tracker, block, g_blockFrames, g_spectral.mag, streamTime, &g_frame );
+    g_frame.centroid = g_spectral.centroid;
+    g_frame.spread = g_spectral.spread;
+    g_frame.rolloff = g_spectral.rolloff;
+    g_frame.flatness = g_spectral.flatness;
+    g_frame.flux = g_spectral.flux;
+    cqt_process( &g_cqt, tail, fresh );
+    long bins = cqt_bins( &g_cqt );
+    memcpy( g_frame.semitones, cqt_magnitudes( &g_cqt ), sizeof(float) * bins );
+    memset( g_frame.semitones + bins, 0, sizeof(float) * (FEATURE_SEMITONES - bins) );
+    harmony_process( &g_harmony, g_frame.semitones, FEATURE_SEMITONES, fresh / g_srate );
+    memcpy( g_frame.chroma, g_harmony.chroma, sizeof(g_frame.chroma) );
+    g_frame.key = (int8_t)g_harmony.key;
+    g_frame.chord = (int8_t)g_harmony.chord;
+    pitch_process( &g_pitch, tail, fresh );
+    g_frame.pitch = g_pitch.f0;
+    g_frame.pitchClarity = g_pitch.clarity;
+    g_frame.voiced = g_pitch.voiced;
+
+    loudness_process( &g_loudness, tail, fresh );
+    g_frame.momentary = g_loudness.momentary;
+    g_frame.shortTerm = g_loudness.shortTerm;
+    g_frame.rms = g_loudness.rms;
+    g_frame.peak = g_loudness.peak;
+    g_frame.truePeak = g_loudness.truePeak;
+    finish( block, g_spectral.mag, captured );
+}
+
+void analysis_block( const float * block, double streamTime, double captured )
+{
+    dsp_window_copy( g_fftBuf, block, g_window, g_blockFrames );
+    analyze( block, g_fftBuf, streamTime, captured );
+}
+
+void analysis_block_windowed( const float * block, float * windowed, double streamTime,
+                              double captured )
+{
+    analyze( block, windowed, streamTime, captured );
+}
+
+void analysis_replay( const FeatureFrame * frame, const float * mag, const float * block,
+                      double captured )
+{
+    g_frame = *frame;
+    finish( block, mag, captured );
+}
+
+bool analysis_latest( FeatureFrame * out )
+{
+    pthread_mutex_lock( &g_latestLock );
+    bool have = g_haveLatest;
+    if( have )
+        *out = g_latest;
+    pthread_mutex_unlock( &g_latestLock );
+    return have;
+}
+
+bool analysis_latest_spectrum( float * mag, long bins )
+{
+    if( bins > g_blockFrames / 2 )
+        bins = g_blockFrames / 2;
+    pthread_mutex_lock( &g_latestLock );
+    bool have = g_haveLatest;
+    if( have )
+        memcpy( mag, g_latestMag, sizeof(float) * bins );
+    pthread_mutex_unlock( &g_latestLock );
+    return have;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: analysisThread()
+// desc: one block at a time; the capture time is backed off by whatever
+//       is still queued behind the block
+//-----------------------------------------------------------------------------
+static void * analysisThread( void * )
+{
+    threads_apply( THREAD_ANALYSIS );
+    unsigned long blocks = 0;
+    struct timespec nap = { 0, POLL_NS };
+
+    while( __atomic_load_n( &g_running, __ATOMIC_ACQUIRE ) )
+    {
+        if( !ring_read( g_ring, g_block, g_blockFrames ) )
+        {
+            nanosleep( &nap, NULL );
+            continue;
+        }
+        double captured = netfeed_clock() - ring_available( g_ring ) / g_srate;
+
+        ALLOC_CHECK_BEGIN();
+        analysis_block( g_block, blocks * g_blockFrames / g_srate, captured );
+        ALLOC_CHECK_END();
+        blocks++;
+    }
+    return NULL;
+}
+
+void analysis_start( SampleRing * ring )
+{
+    g_ring = ring;
+    __atomic_store_n( &g_running, 1, __ATOMIC_RELEASE );
+    pthread_create( &g_thread, NULL, analysisThread, NULL );
+}
+
+void analysis_stop()
+{
+    if( !__atomic_load_n( &g_running, __ATOMIC_ACQUIRE ) )
+        return;
+    __atomic_store_n( &g_running, 0, __ATOMIC_RELEASE );
+    pthread_join( g_thread, NULL );
+}
+
+void analysis_free()
+{
+    analysis_stop();
+    arena_free( &g_arena );
+}
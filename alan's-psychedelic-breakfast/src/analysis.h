@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - analysis.h
+// desc: the analysis stage, apart from the renderer: blocks of audio in,
+//       feature frames out (to the renderer, and onto the network and/or
+//       the shared memory bus, if publishing), semitone magnitudes from a
+//       constant-Q transform, the chroma, key and chord from them, a
+//       monophonic pitch, the loudness and spectral descriptors included.
+//       live it runs on its own thread, fed by the callback through a
+//       sample ring; offline the render loop calls it once per frame, so
+//       runs stay reproducible
+//
+//       budget, per hop of 1024 frames at 44.1 kHz (a 23.2 ms period):
+//       fft, spectral descriptors and features ~30 us, constant-Q ~55 us,
+//       harmony (chroma, key, chord) under 1 us, pitch ~45 us (half
+//       decimation, half its two ffts), loudness ~20 us; ~150 us in all.
+//       keep the stage under 1 ms, so it never competes with the renderer
+//       for a core, and anything new in here should say what it costs
+//-----------------------------------------------------------------------------
+#ifndef __APB_ANALYSIS_H__
+#define __APB_ANALYSIS_H__
+
+#include "feature.h"
+#include "netfeed.h"
+#include "recorder.h"
+#include "ring.h"
+#include "shmbus.h"
+
+// buffers for this block size (from the stage's own arena); frames go to
+// publisher, bus and/or recorder, where they aren't NULL
+void analysis_init( long blockFrames, double srate, NetFeed * publisher, ShmBus * bus,
+                    Recorder * recorder );
+// analyze one block: streamTime is its position in the audio (seconds),
+// captured its wall clock capture time. stamps, publishes and makes it
+// the latest frame. no allocation
+void analysis_block( const float * block, double streamTime, double captured );
+// the same, for a caller that windowed the block already (with a hanning
+// window of blockFrames) on its way in; the transform overwrites windowed
+void analysis_block_windowed( const float * block, float * windowed, double streamTime,
+                              double captured );
+// the same, for a frame and spectrum analyzed before (see featcache.h):
+// only stamped, published and made the latest. no allocation
+void analysis_replay( const FeatureFrame * frame, const float * mag, const float * block,
+                      double captured );
+// run on a thread, one block at a time as the ring fills up
+void analysis_start( SampleRing * ring );
+void analysis_stop();
+// copy of the newest frame (any thread); false if there isn't one yet
+bool analysis_latest( FeatureFrame * out );
+// and of its full magnitude spectrum (blockFrames / 2 bins, windowed), so
+// consumers needn't transform the block again
+bool analysis_latest_spectrum( float * mag, long bins );
+void analysis_free();
+
+
+#endif
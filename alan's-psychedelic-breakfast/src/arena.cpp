@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - arena.cpp
+// desc: DSP buffer arena and the allocation check
+//-----------------------------------------------------------------------------
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <new>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: arena_reserve()
+// desc: grow (never shrink) and reset
+//-----------------------------------------------------------------------------
+void arena_reserve( Arena * arena, size_t bytes )
+{
+    if( bytes > arena->capacity )
+    {
+        arena_free( arena );
+        void * p = NULL;
+        if( posix_memalign( &p, ARENA_ALIGN, bytes ) != 0 )
+        {
+            fprintf( stderr, "arena: can't allocate %lu bytes\n", (unsigned long)bytes );
+            abort();
+        }
+        arena->base = (char *)p;
+        arena->capacity = bytes;
+    }
+    arena->used = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: arena_alloc()
+// desc: bump allocation
+//-----------------------------------------------------------------------------
+void * arena_alloc( Arena * arena, size_t bytes, size_t align )
+{
+    size_t start = (arena->used + align - 1) & ~(align - 1);
+    if( start + bytes > arena->capacity )
+    {
+        fprintf( stderr, "arena: out of room (%lu of %lu bytes used, %lu wanted)\n",
+                 (unsigned long)arena->used, (unsigned long)arena->capacity,
+                 (unsigned long)bytes );
+        abort();
+    }
+    arena->used = start + bytes;
+    memset( arena->base + start, 0, bytes );
+    return arena->base + start;
+}
+
+size_t arena_size( size_t bytes, size_t align )
+{
+    return (bytes + align - 1) & ~(align - 1);
+}
+
+void arena_free( Arena * arena )
+{
+    free( arena->base );
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+
+
+
+#ifdef APB_ALLOC_CHECK
+//-----------------------------------------------------------------------------
+// name: operator new / delete
+// desc: route through malloc, but abort when the calling thread is inside
+//       a no-alloc section
+//-----------------------------------------------------------------------------
+static thread_local int t_forbidAlloc = 0;
+
+void arena_forbid_alloc( bool forbid )
+{
+    t_forbidAlloc += forbid ? 1 : -1;
+}
+
+static void * checked_alloc( size_t bytes )
+{
+    if( t_forbidAlloc > 0 )
+    {
+        // don't recurse into the check while reporting
+        t_forbidAlloc = 0;
+        fprintf( stderr, "alloc check: %lu byte heap allocation in a no-alloc section\n",
+                 (unsigned long)bytes );
+        abort();
+    }
+    void * p = malloc( bytes ? bytes : 1 );
+    if( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+void * operator new( size_t bytes ) { return checked_alloc( bytes ); }
+void * operator new[]( size_t bytes ) { return checked_alloc( bytes ); }
+void operator delete( void * p ) noexcept { free( p ); }
+void operator delete[]( void * p ) noexcept { free( p ); }
+void operator delete( void * p, size_t ) noexcept { free( p ); }
+void operator delete[]( void * p, size_t ) noexcept { free( p ); }
+#endif
@@ -0,0 +1,50 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - arena.h
+// desc: one preallocated, aligned block that all DSP buffers are carved
+//       from, plus an optional check (build with -DAPB_ALLOC_CHECK) that
+//       aborts on any C++ heap allocation inside a no-alloc section
+//-----------------------------------------------------------------------------
+#ifndef __APB_ARENA_H__
+#define __APB_ARENA_H__
+
+#include <stddef.h>
+
+// default alignment for carved buffers (a cache line, enough for avx512)
+#define ARENA_ALIGN 64
+
+struct Arena
+{
+    char * base;
+    size_t capacity;
+    size_t used;
+};
+
+// make sure the arena holds at least bytes and empty it; memory is only
+// reallocated when it has to grow, so reconfiguring reuses it
+void arena_reserve( Arena * arena, size_t bytes );
+// bytes of aligned, zeroed memory; aborts if the arena is out of room
+void * arena_alloc( Arena * arena, size_t bytes, size_t align = ARENA_ALIGN );
+// bytes needed for a buffer of this size (including alignment padding)
+size_t arena_size( size_t bytes, size_t align = ARENA_ALIGN );
+// give everything back
+void arena_free( Arena * arena );
+
+// typed helper
+template <class T> T * arena_array( Arena * arena, long count )
+{
+    return (T *)arena_alloc( arena, sizeof(T) * count );
+}
+
+
+// no-alloc sections: audio callback and per-frame work after startup
+#ifdef APB_ALLOC_CHECK
+void arena_forbid_alloc( bool forbid );
+#define ALLOC_CHECK_BEGIN() arena_forbid_alloc( true )
+#define ALLOC_CHECK_END() arena_forbid_alloc( false )
+#else
+#define ALLOC_CHECK_BEGIN()
+#define ALLOC_CHECK_END()
+#endif
+
+
+#endif
@@ -0,0 +1,258 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - cqt.cpp
+// desc: constant-Q engine (after Brown & Puckette's spectral kernels, with
+//       octave-wise decimation as in Schoerkhuber & Klapuri)
+//-----------------------------------------------------------------------------
+#include "cqt.h"
+#include "dsp.h"
+#include <math.h>
+#include <string.h>
+
+// bandwidth of one semitone: Q = f / bandwidth
+#define Q_FACTOR (1.0 / (pow( 2.0, 1.0 / CQT_BINS_PER_OCTAVE ) - 1.0))
+// spectral kernel entries below this fraction of the peak are dropped
+#define KERNEL_THRESHOLD 0.01
+// decimation lowpass cutoff, in cycles per input sample; the octave below
+// only looks at content under a tenth of its input rate (see layout())
+#define DECIMATION_CUTOFF 0.2
+// highest bin at or below this fraction of the rate, so every octave sits
+// well inside the decimator's passband
+#define TOP_EDGE 0.2
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: layout()
+// desc: trims octaves to fit, returns the fft size: the longest kernel
+//       (the top octave's lowest bin) rounded up to a power of 2
+//-----------------------------------------------------------------------------
+static long layout( int * octaves, double srate, double fmin )
+{
+    while( *octaves > 1 && fmin * pow( 2.0, *octaves ) > TOP_EDGE * srate )
+        (*octaves)--;
+    double fTop = fmin * pow( 2.0, *octaves - 1 );
+    long longest = (long)ceil( Q_FACTOR * srate / fTop );
+    long n = 2;
+    while( n < longest )
+        n <<= 1;
+    return n;
+}
+
+size_t cqt_size( long blockFrames, int octaves, double srate, double fmin )
+{
+    long n = layout( &octaves, srate, fmin );
+    long entries = CQT_BINS_PER_OCTAVE * (n / 2);
+    return arena_size( sizeof(CqtOctave) * octaves ) +
+        octaves * arena_size( sizeof(float) * n ) +
+        arena_size( sizeof(long) * entries ) + arena_size( sizeof(float) * 2 * entries ) +
+        2 * arena_size( sizeof(float) * n ) +
+        2 * arena_size( sizeof(float) * (blockFrames / 2 + 1) ) +
+        arena_size( sizeof(float) * octaves * CQT_BINS_PER_OCTAVE );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: kernelProduct()
+// desc: |sum of X[j] * conj(K[j])| over bin b's kernel entries, X being
+//       an rfft'd block
+//-----------------------------------------------------------------------------
+static float kernelProduct( const Cqt * c, int b, const float * X )
+{
+    float re = 0, im = 0;
+    for( long i = c->first[b]; i < c->first[b] + c->count[b]; i++ )
+    {
+        long j = c->index[i];
+        float xr = X[2 * j], xi = X[2 * j + 1];
+        float kr = c->kernel[2 * i], ki = c->kernel[2 * i + 1];
+        re += xr * kr + xi * ki;
+        im += xi * kr - xr * ki;
+    }
+    return sqrtf( re * re + im * im );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cqt_init()
+// desc: kernels are hann windowed complex exponentials, right aligned so
+//       every bin looks at the newest samples, then transformed, thinned
+//       out and calibrated against a sine at the bin's frequency. the
+//       transform is a direct dft (in rfft's sign convention), as it
+//       only runs here
+//-----------------------------------------------------------------------------
+void cqt_init( Cqt * c, Arena * arena, long blockFrames, int octaves, double srate, double fmin )
+{
+    memset( c, 0, sizeof(*c) );
+    long n = layout( &octaves, srate, fmin );
+    c->octaves = octaves;
+    c->fmin = fmin;
+    c->srate = srate;
+    c->fftSize = n;
+
+    c->octave = arena_array<CqtOctave>( arena, octaves );
+    for( int k = 0; k < octaves; k++ )
+        c->octave[k].history = arena_array<float>( arena, n );
+    long entries = CQT_BINS_PER_OCTAVE * (n / 2);
+    c->index = arena_array<long>( arena, entries );
+    c->kernel = arena_array<float>( arena, 2 * entries );
+    c->fftBuf = arena_array<float>( arena, n );
+    float * spectrum = arena_array<float>( arena, n );
+    c->scratch[0] = arena_array<float>( arena, blockFrames / 2 + 1 );
+    c->scratch[1] = arena_array<float>( arena, blockFrames / 2 + 1 );
+    c->mag = arena_array<float>( arena, octaves * CQT_BINS_PER_OCTAVE );
+
+    // decimation lowpass: hann windowed sinc, unity gain at dc
+    const int mid = CQT_DECIMATION_TAPS / 2;
+    float sum = 0;
+    for( int i = 0; i < CQT_DECIMATION_TAPS; i++ )
+    {
+        double x = 2 * M_PI * DECIMATION_CUTOFF * (i - mid);
+        double w = 0.5 - 0.5 * cos( 2 * M_PI * (i + 1) / (CQT_DECIMATION_TAPS + 1) );
+        c->fir[i] = (float)((i == mid ? 1.0 : sin( x ) / x) * w);
+        sum += c->fir[i];
+    }
+    for( int i = 0; i < CQT_DECIMATION_TAPS; i++ )
+        c->fir[i] /= sum;
+
+    // top octave kernels, in cycles per sample; the others reuse them
+    double fTop = fmin * pow( 2.0, octaves - 1 );
+    long used = 0;
+    for( int b = 0; b < CQT_BINS_PER_OCTAVE; b++ )
+    {
+        double r = fTop * pow( 2.0, b / (double)CQT_BINS_PER_OCTAVE ) / srate;
+        long len = (long)ceil( Q_FACTOR / r );
+        if( len > n ) len = n;
+
+        // K[j] = sum over the support of w(t) exp(i 2 pi (j / n - r) t)
+        for( long j = 1; j < n / 2; j++ )
+        {
+            double re = 0, im = 0;
+            for( long i = 0; i < len; i++ )
+            {
+                long t = n - len + i;
+                double w = 0.5 - 0.5 * cos( 2 * M_PI * (i + 1) / (len + 1) );
+                double phase = 2 * M_PI * ((double)j / n - r) * t;
+                re += w * cos( phase );
+                im += w * sin( phase );
+            }
+            spectrum[2 * j] = (float)re;
+            spectrum[2 * j + 1] = (float)im;
+        }
+
+        float peak = 0;
+        for( long j = 1; j < n / 2; j++ )
+            peak = fmaxf( peak, hypotf( spectrum[2 * j], spectrum[2 * j + 1] ) );
+        c->first[b] = used;
+        for( long j = 1; j < n / 2; j++ )
+            if( hypotf( spectrum[2 * j], spectrum[2 * j + 1] ) >= KERNEL_THRESHOLD * peak )
+            {
+                c->index[used] = j;
+                c->kernel[2 * used] = spectrum[2 * j];
+                c->kernel[2 * used + 1] = spectrum[2 * j + 1];
+                used++;
+            }
+        c->count[b] = used - c->first[b];
+
+        for( long t = 0; t < n; t++ )
+            c->fftBuf[t] = (float)cos( 2 * M_PI * r * t );
+        dsp_rfft( c->fftBuf, n / 2, FFT_FORWARD );
+        float m = kernelProduct( c, b, c->fftBuf );
+        c->scale[b] = m > 0 ? 1 / m : 0;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: append()
+// desc: slide a history window along by n new samples
+//-----------------------------------------------------------------------------
+static void append( float * history, long size, const float * in, long n )
+{
+    if( n >= size )
+        memcpy( history, in + n - size, sizeof(float) * size );
+    else
+    {
+        memmove( history, history + n, sizeof(float) * (size - n) );
+        memcpy( history + size - n, in, sizeof(float) * n );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decimate()
+// desc: lowpass and keep every other sample, carrying state across hops;
+//       returns how many came out
+//-----------------------------------------------------------------------------
+static long decimate( const Cqt * c, CqtOctave * o, const float * in, long n, float * out )
+{
+    long m = 0;
+    for( long i = 0; i < n; i++ )
+    {
+        // written twice, so the newest taps are always contiguous
+        o->delay[o->delayPos] = o->delay[o->delayPos + CQT_DECIMATION_TAPS] = in[i];
+        o->delayPos = (o->delayPos + 1) % CQT_DECIMATION_TAPS;
+        o->phase = !o->phase;
+        if( o->phase )
+            continue;
+        const float * d = o->delay + o->delayPos;
+        float acc = 0;
+        for( int k = 0; k < CQT_DECIMATION_TAPS; k++ )
+            acc += c->fir[k] * d[k];
+        out[m++] = acc;
+    }
+    return m;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cqt_process()
+// desc: top octave first; each one hands its new samples, decimated, to
+//       the one below
+//-----------------------------------------------------------------------------
+void cqt_process( Cqt * c, const float * block, long frames )
+{
+    const float * in = block;
+    long n = frames;
+    for( int k = 0; k < c->octaves; k++ )
+    {
+        CqtOctave * o = &c->octave[k];
+        append( o->history, c->fftSize, in, n );
+        if( k + 1 < c->octaves )
+        {
+            float * out = c->scratch[k & 1];
+            n = decimate( c, o, in, n, out );
+            in = out;
+        }
+
+        memcpy( c->fftBuf, o->history, sizeof(float) * c->fftSize );
+        dsp_rfft( c->fftBuf, c->fftSize / 2, FFT_FORWARD );
+        float * mag = c->mag + (c->octaves - 1 - k) * CQT_BINS_PER_OCTAVE;
+        for( int b = 0; b < CQT_BINS_PER_OCTAVE; b++ )
+            mag[b] = c->scale[b] * kernelProduct( c, b, c->fftBuf );
+    }
+}
+
+long cqt_bins( const Cqt * c )
+{
+    return c->octaves * CQT_BINS_PER_OCTAVE;
+}
+
+const float * cqt_magnitudes( const Cqt * c )
+{
+    return c->mag;
+}
+
+double cqt_frequency( const Cqt * c, long bin )
+{
+    return c->fmin * pow( 2.0, bin / (double)CQT_BINS_PER_OCTAVE );
+}
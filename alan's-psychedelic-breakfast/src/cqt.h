@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - cqt.h
+// desc: constant-Q transform, one bin per semitone, by the spectral kernel
+//       method: the top octave's kernels are transformed once and kept
+//       sparse, so each octave costs one small fft plus a few complex
+//       multiplies per bin. lower octaves reuse the same kernels on the
+//       signal decimated by 2 per octave, which gives them the long
+//       windows they need without long ffts. runs incrementally: each
+//       hop appends to every octave's history and refreshes all bins
+//-----------------------------------------------------------------------------
+#ifndef __APB_CQT_H__
+#define __APB_CQT_H__
+
+#include "arena.h"
+
+#define CQT_BINS_PER_OCTAVE 12
+// C1, the bottom of the default range
+#define CQT_DEFAULT_FMIN 32.703
+// taps of the decimation lowpass
+#define CQT_DECIMATION_TAPS 23
+
+struct CqtOctave
+{
+    float * history;                        // last fftSize samples at this octave's rate
+    float delay[2 * CQT_DECIMATION_TAPS];   // decimator input (written twice)
+    int delayPos;
+    int phase;                              // which input the decimator keeps next
+};
+
+struct Cqt
+{
+    int octaves;
+    double fmin;                            // hz of bin 0
+    double srate;
+    long fftSize;
+    CqtOctave * octave;                     // [0] is the top (full rate) octave
+    // sparse spectral kernels of the top octave: bin b's entries are
+    // index[first[b] .. first[b] + count[b]) with values kernel[2 * i], [2 * i + 1]
+    long first[CQT_BINS_PER_OCTAVE];
+    long count[CQT_BINS_PER_OCTAVE];
+    long * index;
+    float * kernel;
+    float scale[CQT_BINS_PER_OCTAVE];       // a full scale sine reads 1
+    float fir[CQT_DECIMATION_TAPS];
+    float * fftBuf;
+    float * scratch[2];                     // decimator output, ping-pong
+    float * mag;                            // octaves * 12, lowest first
+};
+
+// arena bytes for cqt_init() with these settings
+size_t cqt_size( long blockFrames, int octaves, double srate, double fmin );
+// octaves from fmin up; fewer if the top one wouldn't fit below nyquist
+void cqt_init( Cqt * c, Arena * arena, long blockFrames, int octaves, double srate, double fmin );
+// append one hop of samples (at most blockFrames) and refresh every bin.
+// no allocation
+void cqt_process( Cqt * c, const float * block, long frames );
+// octaves * CQT_BINS_PER_OCTAVE magnitudes, bin 0 at fmin
+long cqt_bins( const Cqt * c );
+const float * cqt_magnitudes( const Cqt * c );
+double cqt_frequency( const Cqt * c, long bin );
+
+
+#endif
@@ -0,0 +1,406 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - decoder.cpp
+// desc: playlist decoding and pacing
+//-----------------------------------------------------------------------------
+#include "decoder.h"
+#include "threads.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// frames per decode step
+#define CHUNK 4096
+// how long the thread naps with nothing to decode or hand on
+#define POLL_NS 1000000
+// what we ask of a pipe's buffer, so the writer can get well ahead
+#define PIPE_BYTES (1 << 20)
+
+static double monotonic()
+{
+    struct timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+
+
+static long pcmFrameBytes( Decoder * d )
+{
+    return d->pcmChannels * (d->pcmFormat == PCM_S16LE ? 2 : 4);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: allocate()
+// desc: the decode-ahead ring rounds up to a power of two
+//-----------------------------------------------------------------------------
+static void allocate( Decoder * d, double aheadSeconds )
+{
+    unsigned long size = 1;
+    while( size < aheadSeconds * d->srate || size < 2 * CHUNK || size < 2 * (unsigned long)d->blockFrames )
+        size *= 2;
+    long pipeBytes = d->pipe ? CHUNK * pcmFrameBytes( d ) : 0;
+    arena_reserve( &d->arena, arena_size( sizeof(float) * size ) +
+                   arena_size( sizeof(float) * CHUNK ) + arena_size( sizeof(float) * d->blockFrames ) +
+                   arena_size( sizeof(long) * d->count ) + arena_size( pipeBytes ) );
+    ring_init( &d->ahead, arena_array<float>( &d->arena, size ), size );
+    d->chunk = arena_array<float>( &d->arena, CHUNK );
+    d->block = arena_array<float>( &d->arena, d->blockFrames );
+    d->trackStart = arena_array<long>( &d->arena, d->count );
+    for( int i = 1; i < d->count; i++ )
+        d->trackStart[i] = LONG_MAX;
+    if( d->pipe )
+        d->pipeBuf = arena_array<unsigned char>( &d->arena, pipeBytes );
+}
+
+bool decoder_open( Decoder * d, const char * const * paths, int count, long blockFrames,
+                   double aheadSeconds, bool realtime )
+{
+    memset( d, 0, sizeof(*d) );
+    d->paths = paths;
+    d->count = count;
+    d->blockFrames = blockFrames;
+    d->realtime = realtime;
+    d->startTime = -1;
+    if( count < 1 || !wav_open( &d->file, paths[0] ) )
+        return false;
+    d->srate = d->file.srate;
+    allocate( d, aheadSeconds );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decoder_open_pipe()
+// desc: a fifo is opened blocking, so there's a writer before the first
+//       read (with none, a non-blocking read is end of stream), and then
+//       switched to non-blocking. stdin is taken as it is
+//-----------------------------------------------------------------------------
+bool decoder_open_pipe( Decoder * d, const char * path, PcmFormat format, double srate,
+                        int channels, long blockFrames, double aheadSeconds, bool realtime )
+{
+    memset( d, 0, sizeof(*d) );
+    d->pipe = true;
+    d->pipePath = path;
+    d->paths = &d->pipePath;
+    d->count = 1;
+    d->pcmFormat = format;
+    d->pcmChannels = channels;
+    d->srate = srate;
+    d->blockFrames = blockFrames;
+    d->realtime = realtime;
+    d->startTime = -1;
+
+    bool in = !strcmp( path, "-" );
+    if( in && isatty( 0 ) )
+    {
+        fprintf( stderr, "decoder: stdin is a terminal; pipe raw PCM into it\n" );
+        return false;
+    }
+    d->pipeFd = in ? 0 : open( path, O_RDONLY );
+    if( d->pipeFd < 0 )
+    {
+        fprintf( stderr, "decoder: can't open %s: %s\n", path, strerror( errno ) );
+        return false;
+    }
+    fcntl( d->pipeFd, F_SETFL, fcntl( d->pipeFd, F_GETFL ) | O_NONBLOCK );
+    // best effort; plain files and older kernels don't have it
+    fcntl( d->pipeFd, F_SETPIPE_SZ, PIPE_BYTES );
+    allocate( d, aheadSeconds );
+    return true;
+}
+
+bool decoder_parse_format( const char * name, PcmFormat * format )
+{
+    if( !strcmp( name, "s16le" ) )
+        *format = PCM_S16LE;
+    else if( !strcmp( name, "f32le" ) )
+        *format = PCM_F32LE;
+    else
+        return false;
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: nextTrack()
+// desc: open the track after the current one, skipping any that won't
+//       open or don't match the rate (they take no time); false at the end
+//-----------------------------------------------------------------------------
+static bool nextTrack( Decoder * d )
+{
+    wav_close( &d->file );
+    while( ++d->current < d->count )
+    {
+        d->trackStart[d->current] = d->decoded;
+        d->filePos = 0;
+        if( !wav_open( &d->file, d->paths[d->current] ) )
+            continue;
+        if( d->file.srate == d->srate )
+            return true;
+        fprintf( stderr, "decoder: %s is at %u Hz, the playlist at %.0f; skipped\n",
+                 d->paths[d->current], d->file.srate, d->srate );
+        wav_close( &d->file );
+    }
+    return false;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decodeChunk()
+// desc: up to CHUNK frames into the ring, running on into the next track
+//       where this one ends; false once the playlist is exhausted
+//-----------------------------------------------------------------------------
+static bool decodeChunk( Decoder * d )
+{
+    long filled = 0;
+    bool more = true;
+    while( filled < CHUNK )
+    {
+        long got = wav_read( &d->file, d->filePos, d->chunk + filled, CHUNK - filled );
+        d->filePos += got;
+        d->decoded += got;
+        filled += got;
+        if( filled < CHUNK && !(more = nextTrack( d )) )
+            break;
+    }
+    ring_write( &d->ahead, d->chunk, filled );
+    return more;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: readPipe()
+// desc: whatever has arrived, up to a chunk of frames, in one read, mixed
+//       down into the ring; a partial frame waits for the rest. false at
+//       end of stream
+//-----------------------------------------------------------------------------
+static bool readPipe( Decoder * d )
+{
+    const long frameBytes = pcmFrameBytes( d );
+    ssize_t got = read( d->pipeFd, d->pipeBuf + d->pipeFill, CHUNK * frameBytes - d->pipeFill );
+    if( got < 0 && (errno == EAGAIN || errno == EINTR) )
+        return true;
+    if( got < 0 )
+        fprintf( stderr, "decoder: reading %s: %s\n", d->pipePath, strerror( errno ) );
+    if( got <= 0 )
+        return false;
+    __atomic_fetch_add( &d->stats.bytes, got, __ATOMIC_RELAXED );
+
+    d->pipeFill += got;
+    long frames = d->pipeFill / frameBytes;
+    const int channels = d->pcmChannels;
+    const float gain = 1.0f / channels;
+    if( d->pcmFormat == PCM_S16LE )
+    {
+        const unsigned char * p = d->pipeBuf;
+        for( long i = 0; i < frames; i++ )
+        {
+            float sum = 0;
+            for( int c = 0; c < channels; c++, p += 2 )
+                sum += (int16_t)(p[0] | (p[1] << 8)) / 32768.0f;
+            d->chunk[i] = sum * gain;
+        }
+    }
+    else
+    {
+        // little-endian hosts: floats as they lie
+        const unsigned char * p = d->pipeBuf;
+        for( long i = 0; i < frames; i++ )
+        {
+            float sum = 0;
+            for( int c = 0; c < channels; c++, p += 4 )
+            {
+                float f;
+                memcpy( &f, p, 4 );
+                sum += f;
+            }
+            d->chunk[i] = sum * gain;
+        }
+    }
+    ring_write( &d->ahead, d->chunk, frames );
+    d->decoded += frames;
+
+    d->pipeFill -= frames * frameBytes;
+    memmove( d->pipeBuf, d->pipeBuf + frames * frameBytes, d->pipeFill );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: handOn()
+// desc: offer the pending block, when it's due; paced playback that fell
+//       behind (the decoding, or the machine, stalled) picks up from now
+//       rather than rushing to catch up. true if it was taken
+//-----------------------------------------------------------------------------
+static bool handOn( Decoder * d, double * wait )
+{
+    double now = monotonic();
+    if( d->startTime < 0 )
+        d->startTime = now;
+    double period = d->blockFrames / d->srate;
+    double due = d->startTime + d->released / d->srate;
+    *wait = 0;
+    if( d->realtime && now < due )
+    {
+        *wait = due - now;
+        return false;
+    }
+    if( d->realtime && now - due > period )
+    {
+        d->startTime += now - due;
+        __atomic_fetch_add( &d->stats.underruns, 1, __ATOMIC_RELAXED );
+    }
+    if( !d->callback( d->block, d->blockFrames, d->released / d->srate, d->data ) )
+    {
+        __atomic_fetch_add( &d->stats.refusals, 1, __ATOMIC_RELAXED );
+        return false;
+    }
+
+    d->released += d->blockFrames;
+    int playing = d->playing;
+    while( playing + 1 < d->count && (long)d->released > d->trackStart[playing + 1] )
+        playing++;
+    __atomic_store_n( &d->playing, playing, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &d->stats.blocks, 1, __ATOMIC_RELAXED );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decoderThread()
+// desc: stands in for the audio callback's thread (and takes its role's
+//       settings): keep the ring topped up a chunk at a time, between
+//       offering blocks. the last block is padded with silence
+//-----------------------------------------------------------------------------
+static void * decoderThread( void * arg )
+{
+    Decoder * d = (Decoder *)arg;
+    threads_apply( THREAD_AUDIO );
+    bool more = true, pending = false;
+
+    while( __atomic_load_n( &d->running, __ATOMIC_ACQUIRE ) )
+    {
+        unsigned long decoded = d->decoded;
+        if( more && ring_space( &d->ahead ) >= CHUNK )
+            more = d->pipe ? readPipe( d ) : decodeChunk( d );
+        bool progress = d->decoded != decoded;
+        if( !pending )
+        {
+            long avail = ring_available( &d->ahead );
+            long n = avail < d->blockFrames ? avail : d->blockFrames;
+            if( n == d->blockFrames || (!more && n > 0) )
+            {
+                ring_read( &d->ahead, d->block, n );
+                memset( d->block + n, 0, sizeof(float) * (d->blockFrames - n) );
+                pending = true;
+            }
+            else if( !more )
+                break;
+        }
+
+        double wait = 0;
+        if( pending && handOn( d, &wait ) )
+        {
+            pending = false;
+            progress = true;
+        }
+        if( !progress )
+        {
+            struct timespec nap = { 0, POLL_NS };
+            if( wait > 0 && wait < POLL_NS * 1e-9 )
+                nap.tv_nsec = (long)(wait * 1e9);
+            nanosleep( &nap, NULL );
+        }
+    }
+    __atomic_store_n( &d->finished, 1, __ATOMIC_RELEASE );
+    return NULL;
+}
+
+void decoder_start( Decoder * d, DecoderCallback callback, void * data )
+{
+    d->callback = callback;
+    d->data = data;
+    __atomic_store_n( &d->running, 1, __ATOMIC_RELEASE );
+    pthread_create( &d->thread, NULL, decoderThread, d );
+}
+
+bool decoder_finished( Decoder * d )
+{
+    return __atomic_load_n( &d->finished, __ATOMIC_ACQUIRE ) != 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decoder_stats() / decoder_format()
+// desc: where the playlist is, and how the pacing is going
+//-----------------------------------------------------------------------------
+void decoder_stats( Decoder * d, DecoderStats * out )
+{
+    out->track = __atomic_load_n( &d->playing, __ATOMIC_RELAXED );
+    out->blocks = __atomic_load_n( &d->stats.blocks, __ATOMIC_RELAXED );
+    out->underruns = __atomic_load_n( &d->stats.underruns, __ATOMIC_RELAXED );
+    out->refusals = __atomic_load_n( &d->stats.refusals, __ATOMIC_RELAXED );
+    out->ahead = ring_available( &d->ahead ) / d->srate;
+    out->played = out->blocks * d->blockFrames / d->srate;
+    double start = d->startTime;
+    out->elapsed = start < 0 ? 0 : monotonic() - start;
+    out->bytes = __atomic_load_n( &d->stats.bytes, __ATOMIC_RELAXED );
+}
+
+void decoder_format( Decoder * d, char * buf, unsigned long size )
+{
+    DecoderStats s;
+    decoder_stats( d, &s );
+    if( d->pipe )
+    {
+        // throughput off the pipe, and how that compares to real time
+        snprintf( buf, size, "pipe %s %s/%dch @ %.0f, %.1f s in %.1f s (%s, %.1fx, %.2f MB/s), "
+                  "ahead %.1f s, %lu underruns",
+                  d->pipePath, d->pcmFormat == PCM_S16LE ? "s16le" : "f32le", d->pcmChannels,
+                  d->srate, s.played, s.elapsed, d->realtime ? "paced" : "free-run",
+                  s.elapsed > 0 ? s.played / s.elapsed : 0.0,
+                  s.elapsed > 0 ? s.bytes / s.elapsed / 1e6 : 0.0, s.ahead, s.underruns );
+        return;
+    }
+    const char * path = d->paths[s.track];
+    const char * name = strrchr( path, '/' );
+    snprintf( buf, size, "track %d/%d %s, %.1f s in %.1f s (%s), ahead %.1f s, %lu underruns",
+              s.track + 1, d->count, name ? name + 1 : path, s.played, s.elapsed,
+              d->realtime ? "paced" : "free-run", s.ahead, s.underruns );
+}
+
+void decoder_close( Decoder * d )
+{
+    if( __atomic_load_n( &d->running, __ATOMIC_ACQUIRE ) )
+    {
+        __atomic_store_n( &d->running, 0, __ATOMIC_RELEASE );
+        pthread_join( d->thread, NULL );
+    }
+    wav_close( &d->file );
+    if( d->pipe && d->pipeFd > 0 )
+        close( d->pipeFd );
+    arena_free( &d->arena );
+}
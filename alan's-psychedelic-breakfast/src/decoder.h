@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - decoder.h
+// desc: playlist source: files (WAV or AIFF, see wavfile.h) decoded on a
+//       thread of their own, into a decode-ahead ring some seconds deep,
+//       and handed on a block at a time, as the audio callback would: at
+//       the audio's own pace by the wall clock, or as fast as the consumer
+//       takes them. tracks follow each other sample for sample, so a set
+//       split into files plays back without gaps. or, instead of files,
+//       raw PCM on a pipe (stdin, say, from ffmpeg), read as it arrives in
+//       large non-blocking reads; once the ring is full, reading stops and
+//       the writer blocks, so nothing is dropped
+//-----------------------------------------------------------------------------
+#ifndef __APB_DECODER_H__
+#define __APB_DECODER_H__
+
+#include "arena.h"
+#include "ring.h"
+#include "wavfile.h"
+#include <pthread.h>
+
+// raw sample formats on a pipe, interleaved
+enum PcmFormat
+{
+    PCM_S16LE,
+    PCM_F32LE
+};
+
+// a block for the consumer, streamTime seconds into the playlist. return
+// false to have it offered again shortly (free-run backpressure)
+typedef bool (* DecoderCallback)( const float * block, long frames, double streamTime, void * data );
+
+struct DecoderStats
+{
+    int track;                      // playing now, from 0
+    unsigned long blocks;           // handed on
+    unsigned long underruns;        // paced blocks that weren't decoded in time
+    unsigned long refusals;         // offers the consumer turned down
+    double ahead;                   // decoded seconds waiting
+    double played;                  // seconds handed on
+    double elapsed;                 // wall clock seconds since the first block
+    unsigned long long bytes;       // read off a pipe
+};
+
+struct Decoder
+{
+    const char * const * paths;
+    int count;
+    int current;                    // track being decoded
+    int playing;                    // track being handed on (atomic)
+    long * trackStart;              // playlist frame each track starts at
+    WavFile file;
+    long filePos;
+    double srate;
+    long blockFrames;
+    bool realtime;
+    // a pipe instead of files
+    bool pipe;
+    const char * pipePath;
+    int pipeFd;
+    PcmFormat pcmFormat;
+    int pcmChannels;
+    unsigned char * pipeBuf;        // one chunk of frames, as read
+    long pipeFill;                  // bytes in it
+    Arena arena;
+    SampleRing ahead;
+    float * chunk;                  // one decode step
+    float * block;
+    DecoderCallback callback;
+    void * data;
+    pthread_t thread;
+    int running;                    // atomic
+    int finished;                   // atomic: every block handed on
+    double startTime;
+    unsigned long decoded;          // playlist frames into the ring
+    unsigned long released;         // and out of it
+    DecoderStats stats;             // (atomic fields)
+};
+
+// open the first of count paths (the rate for the whole list; later
+// tracks at another rate are skipped), with aheadSeconds of decode-ahead;
+// false, with a message, if it can't be played
+bool decoder_open( Decoder * d, const char * const * paths, int count, long blockFrames,
+                   double aheadSeconds, bool realtime );
+// the same for raw PCM at srate on path (a fifo, or "-" for stdin, which
+// mustn't be a terminal): one endless track, over at end of stream
+bool decoder_open_pipe( Decoder * d, const char * path, PcmFormat format, double srate,
+                        int channels, long blockFrames, double aheadSeconds, bool realtime );
+// "s16le" or "f32le"; false if it's neither
+bool decoder_parse_format( const char * name, PcmFormat * format );
+// start handing blocks to callback, on the decoder's thread
+void decoder_start( Decoder * d, DecoderCallback callback, void * data );
+// true once the last block has been handed on (any thread)
+bool decoder_finished( Decoder * d );
+void decoder_stats( Decoder * d, DecoderStats * out );
+// one-line summary for the log or overlay
+void decoder_format( Decoder * d, char * buf, unsigned long size );
+void decoder_close( Decoder * d );
+
+
+#endif
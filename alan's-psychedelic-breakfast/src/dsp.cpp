@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - dsp.cpp
+// desc: runtime selection of the kernel variants
+//-----------------------------------------------------------------------------
+#include "dsp.h"
+
+
+#if defined(DSP_X86_VARIANTS)
+DSP_DECLARE_VARIANT(sse2)
+DSP_DECLARE_VARIANT(avx2)
+DSP_DECLARE_VARIANT(avx512)
+#define DSP_DEFAULT(f) f##_sse2
+#else
+DSP_DECLARE_VARIANT(generic)
+#define DSP_DEFAULT(f) f##_generic
+#endif
+
+// start on the baseline variant so nothing breaks before dsp_init()
+void (*dsp_rfft)( float *, long, unsigned int ) = DSP_DEFAULT(rfft);
+void (*dsp_apply_window)( float *, const float *, long ) = DSP_DEFAULT(dsp_apply_window);
+void (*dsp_window_copy)( float *, const float *, const float *, long ) = DSP_DEFAULT(dsp_window_copy);
+void (*dsp_magnitude)( const complex *, float *, long ) = DSP_DEFAULT(dsp_magnitude);
+float (*dsp_band_sum)( const float *, long, long ) = DSP_DEFAULT(dsp_band_sum);
+float (*dsp_abs_sum)( const float *, long ) = DSP_DEFAULT(dsp_abs_sum);
+void (*dsp_filterbank)( const float *, const float *, const long *, const long *, long, float * ) =
+    DSP_DEFAULT(dsp_filterbank);
+void (*dsp_spectral_pack)( const complex *, const float *, long, float *, float *, float * ) =
+    DSP_DEFAULT(dsp_spectral_pack);
+float (*dsp_fir_peak)( const float *, const float *, long, long ) = DSP_DEFAULT(dsp_fir_peak);
+
+static const char * g_dspIsa =
+#if defined(DSP_X86_VARIANTS)
+    "sse2";
+#else
+    "generic";
+#endif
+
+#define DSP_USE(isa) \
+    do { \
+        dsp_rfft = rfft_##isa; \
+        dsp_apply_window = dsp_apply_window_##isa; \
+        dsp_window_copy = dsp_window_copy_##isa; \
+        dsp_magnitude = dsp_magnitude_##isa; \
+        dsp_band_sum = dsp_band_sum_##isa; \
+        dsp_abs_sum = dsp_abs_sum_##isa; \
+        dsp_filterbank = dsp_filterbank_##isa; \
+        dsp_spectral_pack = dsp_spectral_pack_##isa; \
+        dsp_fir_peak = dsp_fir_peak_##isa; \
+        g_dspIsa = #isa; \
+    } while( 0 )
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_init()
+// desc: best variant the cpu (and os, for the wider registers) supports
+//-----------------------------------------------------------------------------
+void dsp_init()
+{
+#if defined(DSP_X86_VARIANTS)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" ) &&
+        __builtin_cpu_supports( "avx512vl" ) )
+        DSP_USE(avx512);
+    else if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+        DSP_USE(avx2);
+    else
+        DSP_USE(sse2);
+#endif
+}
+
+const char * dsp_isa()
+{
+    return g_dspIsa;
+}
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - dsp.h
+// desc: hot analysis kernels (fft, windowing, magnitudes, sums). each is
+//       compiled once per instruction set (see makefile) and dsp_init()
+//       points these at the best variant the cpu supports
+//-----------------------------------------------------------------------------
+#ifndef __APB_DSP_H__
+#define __APB_DSP_H__
+
+#include "chuck_fft.h"
+
+
+// pick kernel variants for this cpu; call once before any kernel
+void dsp_init();
+// name of the variant in use ("sse2", "avx2", "avx512" or "generic")
+const char * dsp_isa();
+
+// chuck_fft rfft(), same contract
+extern void (*dsp_rfft)( float * x, long N, unsigned int forward );
+// data[i] *= window[i]
+extern void (*dsp_apply_window)( float * data, const float * window, long length );
+// out[i] = in[i] * window[i]: the copy and the windowing in one pass
+extern void (*dsp_window_copy)( float * out, const float * in, const float * window, long length );
+// mag[i] = |in[i]|
+extern void (*dsp_magnitude)( const complex * in, float * mag, long length );
+// sum of x[lo..hi)
+extern float (*dsp_band_sum)( const float * x, long lo, long hi );
+// sum of |x[i]| over length samples
+extern float (*dsp_abs_sum)( const float * x, long length );
+// sparse weighted sums of power: out[b] = sum over k < count[b] of
+// weights[k] * mag[first[b] + k]^2, the weights packed band after band
+extern void (*dsp_filterbank)( const float * mag, const float * weights, const long * first,
+                               const long * count, long bands, float * out );
+// magnitudes of bins complex values (as dsp_magnitude()), the same in dB
+// (20 log10, floored at DSP_MAG_FLOOR) and, into sums[DSP_SUMS], their
+// totals: sum of mag, bin * mag, bin^2 * mag, mag^2 and dB, and the
+// squared rise over prev (the previous magnitudes), for the flux
+extern void (*dsp_spectral_pack)( const complex * in, const float * prev, long bins,
+                                  float * mag, float * db, float * sums );
+// largest |y[i]| over length outputs of y[i] = sum of taps[j] * x[i + j];
+// x holds length + numTaps - 1 samples
+extern float (*dsp_fir_peak)( const float * x, const float * taps, long numTaps, long length );
+
+// dsp_spectral_pack()'s sums
+#define DSP_SUM_MAG 0
+#define DSP_SUM_MOMENT1 1
+#define DSP_SUM_MOMENT2 2
+#define DSP_SUM_POWER 3
+#define DSP_SUM_DB 4
+#define DSP_SUM_FLUX 5
+#define DSP_SUMS 6
+// magnitudes below this count as this, in dB (-200 dB)
+#define DSP_MAG_FLOOR 1e-10f
+
+
+// the variants, as built by dsp_kernels.cpp (one set per DSP_ISA)
+#define DSP_DECLARE_VARIANT(isa) \
+    extern "C" void rfft_##isa( float * x, long N, unsigned int forward ); \
+    void dsp_apply_window_##isa( float * data, const float * window, long length ); \
+    void dsp_window_copy_##isa( float * out, const float * in, const float * window, long length ); \
+    void dsp_magnitude_##isa( const complex * in, float * mag, long length ); \
+    float dsp_band_sum_##isa( const float * x, long lo, long hi ); \
+    float dsp_abs_sum_##isa( const float * x, long length ); \
+    void dsp_filterbank_##isa( const float * mag, const float * weights, const long * first, \
+                               const long * count, long bands, float * out ); \
+    void dsp_spectral_pack_##isa( const complex * in, const float * prev, long bins, \
+                                  float * mag, float * db, float * sums ); \
+    float dsp_fir_peak_##isa( const float * x, const float * taps, long numTaps, long length );
+
+
+#endif
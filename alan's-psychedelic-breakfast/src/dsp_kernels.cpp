@@ -0,0 +1,265 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - dsp_kernels.cpp
+// desc: kernel bodies, compiled once per instruction set with -DDSP_ISA=<isa>
+//       and matching -m flags. the code is plain loops written so the
+//       compiler can vectorize them; every variant performs the same float
+//       operations in the same order (reductions use a fixed set of 8
+//       partial sums, fp contraction is off) so all machines render the
+//       same frames
+//-----------------------------------------------------------------------------
+#ifndef DSP_ISA
+#error "build with -DDSP_ISA=<isa>"
+#endif
+
+#define DSP_CAT2(a, b) a##_##b
+#define DSP_CAT(a, b) DSP_CAT2(a, b)
+#define DSP_NAME(f) DSP_CAT(f, DSP_ISA)
+
+// a private copy of chuck_fft for this instruction set
+#define hanning DSP_NAME(hanning)
+#define hamming DSP_NAME(hamming)
+#define blackman DSP_NAME(blackman)
+#define apply_window DSP_NAME(apply_window)
+#define rfft DSP_NAME(rfft)
+#define cfft DSP_NAME(cfft)
+#define bit_reverse DSP_NAME(bit_reverse)
+#include "chuck_fft.c"
+#undef hanning
+#undef hamming
+#undef blackman
+#undef apply_window
+#undef rfft
+#undef cfft
+#undef bit_reverse
+
+#include "dsp.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_apply_window_<isa>() / dsp_window_copy_<isa>()
+// desc: data[i] *= window[i]; out[i] = in[i] * window[i]
+//-----------------------------------------------------------------------------
+void DSP_NAME(dsp_apply_window)( float * __restrict data,
+                                 const float * __restrict window, long length )
+{
+    for( long i = 0; i < length; i++ )
+        data[i] *= window[i];
+}
+
+void DSP_NAME(dsp_window_copy)( float * __restrict out, const float * __restrict in,
+                                const float * __restrict window, long length )
+{
+    for( long i = 0; i < length; i++ )
+        out[i] = in[i] * window[i];
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_magnitude_<isa>()
+// desc: complex magnitudes
+//-----------------------------------------------------------------------------
+void DSP_NAME(dsp_magnitude)( const complex * __restrict in,
+                              float * __restrict mag, long length )
+{
+    const float * c = (const float *)in;
+    for( long i = 0; i < length; i++ )
+    {
+        float re = c[2 * i], im = c[2 * i + 1];
+        mag[i] = sqrtf( re * re + im * im );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_band_sum_<isa>() / dsp_abs_sum_<isa>()
+// desc: sums over 8 interleaved partial accumulators, combined pairwise
+//-----------------------------------------------------------------------------
+static inline float combine( const float * acc )
+{
+    return ((acc[0] + acc[4]) + (acc[1] + acc[5])) +
+           ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+float DSP_NAME(dsp_band_sum)( const float * x, long lo, long hi )
+{
+    float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    long i = lo;
+    for( ; i + 8 <= hi; i += 8 )
+        for( int k = 0; k < 8; k++ )
+            acc[k] += x[i + k];
+    float sum = combine( acc );
+    for( ; i < hi; i++ )
+        sum += x[i];
+    return sum;
+}
+
+float DSP_NAME(dsp_abs_sum)( const float * x, long length )
+{
+    float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    long i = 0;
+    for( ; i + 8 <= length; i += 8 )
+        for( int k = 0; k < 8; k++ )
+            acc[k] += fabsf( x[i + k] );
+    float sum = combine( acc );
+    for( ; i < length; i++ )
+        sum += fabsf( x[i] );
+    return sum;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_filterbank_<isa>()
+// desc: one sparse dot product per band, squaring the magnitudes on the
+//       way in; same 8 partial sums as above
+//-----------------------------------------------------------------------------
+void DSP_NAME(dsp_filterbank)( const float * __restrict mag, const float * __restrict weights,
+                               const long * first, const long * count, long bands,
+                               float * __restrict out )
+{
+    for( long b = 0; b < bands; b++ )
+    {
+        const float * m = mag + first[b];
+        long n = count[b];
+        float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        long i = 0;
+        for( ; i + 8 <= n; i += 8 )
+            for( int k = 0; k < 8; k++ )
+                acc[k] += weights[i + k] * (m[i + k] * m[i + k]);
+        float sum = combine( acc );
+        for( ; i < n; i++ )
+            sum += weights[i] * (m[i] * m[i]);
+        out[b] = sum;
+        weights += n;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decibels()
+// desc: 20 log10(x) for normal x > 0, from the exponent bits and a short
+//       atanh series on the mantissa (folded into [sqrt(1/2), sqrt(2)),
+//       error ~1e-6 dB). plain arithmetic, unlike logf(), so it vectorizes
+//       and gives the same bits everywhere
+//-----------------------------------------------------------------------------
+static inline float decibels( float x )
+{
+    uint32_t bits;
+    memcpy( &bits, &x, 4 );
+    int e = (int)(bits >> 23) - 127;
+    uint32_t mbits = (bits & 0x7fffff) | 0x3f800000;
+    float m;
+    memcpy( &m, &mbits, 4 );
+    bool high = m > 1.41421356f;
+    m = high ? 0.5f * m : m;
+    e = high ? e + 1 : e;
+    float z = (m - 1) / (m + 1), z2 = z * z;
+    float ln = e * 0.693147181f + 2 * z * (1 + z2 * (1 / 3.0f + z2 * (1 / 5.0f + z2 * (1 / 7.0f))));
+    return 8.68588964f * ln;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_spectral_pack_<isa>()
+// desc: one pass over the spectrum for magnitudes, decibels and every sum
+//       the descriptors need; the same 8 partial sums per quantity
+//-----------------------------------------------------------------------------
+void DSP_NAME(dsp_spectral_pack)( const complex * __restrict in, const float * __restrict prev,
+                                  long bins, float * __restrict mag, float * __restrict db,
+                                  float * sums )
+{
+    const float * c = (const float *)in;
+    float acc[DSP_SUMS][8];
+    memset( acc, 0, sizeof(acc) );
+    long i = 0;
+    for( ; i + 8 <= bins; i += 8 )
+        for( int k = 0; k < 8; k++ )
+        {
+            float re = c[2 * (i + k)], im = c[2 * (i + k) + 1];
+            float power = re * re + im * im;
+            float m = sqrtf( power );
+            float d = decibels( m > DSP_MAG_FLOOR ? m : DSP_MAG_FLOOR );
+            float rise = m - prev[i + k];
+            float bin = (float)(i + k);
+            mag[i + k] = m;
+            db[i + k] = d;
+            acc[DSP_SUM_MAG][k] += m;
+            acc[DSP_SUM_MOMENT1][k] += bin * m;
+            acc[DSP_SUM_MOMENT2][k] += (bin * bin) * m;
+            acc[DSP_SUM_POWER][k] += power;
+            acc[DSP_SUM_DB][k] += d;
+            acc[DSP_SUM_FLUX][k] += rise > 0 ? rise * rise : 0;
+        }
+    for( int s = 0; s < DSP_SUMS; s++ )
+        sums[s] = combine( acc[s] );
+    for( ; i < bins; i++ )
+    {
+        float re = c[2 * i], im = c[2 * i + 1];
+        float power = re * re + im * im;
+        float m = sqrtf( power );
+        float d = decibels( m > DSP_MAG_FLOOR ? m : DSP_MAG_FLOOR );
+        float rise = m - prev[i];
+        float bin = (float)i;
+        mag[i] = m;
+        db[i] = d;
+        sums[DSP_SUM_MAG] += m;
+        sums[DSP_SUM_MOMENT1] += bin * m;
+        sums[DSP_SUM_MOMENT2] += (bin * bin) * m;
+        sums[DSP_SUM_POWER] += power;
+        sums[DSP_SUM_DB] += d;
+        sums[DSP_SUM_FLUX] += rise > 0 ? rise * rise : 0;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dsp_fir_peak_<isa>()
+// desc: eight outputs at a time, each its own lane; max is exact, so the
+//       order the lanes are combined in doesn't matter
+//-----------------------------------------------------------------------------
+float DSP_NAME(dsp_fir_peak)( const float * __restrict x, const float * __restrict taps,
+                              long numTaps, long length )
+{
+    float top[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    long i = 0;
+    for( ; i + 8 <= length; i += 8 )
+    {
+        float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        for( long j = 0; j < numTaps; j++ )
+            for( int k = 0; k < 8; k++ )
+                acc[k] += taps[j] * x[i + k + j];
+        for( int k = 0; k < 8; k++ )
+        {
+            float a = fabsf( acc[k] );
+            top[k] = a > top[k] ? a : top[k];
+        }
+    }
+    float peak = 0;
+    for( int k = 0; k < 8; k++ )
+        peak = top[k] > peak ? top[k] : peak;
+    for( ; i < length; i++ )
+    {
+        float acc = 0;
+        for( long j = 0; j < numTaps; j++ )
+            acc += taps[j] * x[i + j];
+        float a = fabsf( acc );
+        peak = a > peak ? a : peak;
+    }
+    return peak;
+}
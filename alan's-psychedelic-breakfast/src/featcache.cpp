@@ -0,0 +1,247 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - featcache.cpp
+// desc: memory mapped analysis cache
+//-----------------------------------------------------------------------------
+#include "featcache.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FEATCACHE_MAGIC 0x43425041  // "APBC"
+// bumped whenever the analysis computes something differently, as well
+// as for layout changes, so stale caches are rebuilt (2: offline blocks'
+// overlap no longer fed twice to the constant-Q transform)
+#define FEATCACHE_VERSION 2
+
+// layout: the header, then frames records of recordBytes (a multiple of
+// 8). the header is in host byte order (another host's cache just doesn't
+// match and is rebuilt); records are little-endian throughout
+struct FeatCacheHeader
+{
+    uint32_t magic;                 // written last, once every record is in
+    uint32_t version;
+    uint32_t featureVersion;
+    uint32_t recordBytes;
+    uint64_t content;
+    uint64_t config;
+    uint64_t frames;
+    uint32_t bins;
+    uint32_t blockFrames;
+    double srate;
+    double step;
+};
+
+static void reset( FeatCache * c )
+{
+    memset( c, 0, sizeof(*c) );
+    c->fd = -1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: configHash()
+// desc: FNV-1a over everything besides the audio that the records depend
+//       on, the formats' versions included
+//-----------------------------------------------------------------------------
+static uint64_t configHash( const FeatCacheKey * key )
+{
+    struct
+    {
+        double srate, step;
+        int64_t blockFrames, frames;
+        uint32_t version, featureVersion;
+    } config = { key->srate, key->step, key->blockFrames, key->frames,
+                 FEATCACHE_VERSION, FEATURE_VERSION };
+    const unsigned char * p = (const unsigned char *)&config;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for( size_t i = 0; i < sizeof(config); i++ )
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static void layout( FeatCache * c, const char * dir, const FeatCacheKey * key )
+{
+    c->bins = key->blockFrames / 2;
+    c->frames = key->frames;
+    c->recordBytes = (FEATURE_WIRE_SIZE + 4 * c->bins + 7) & ~(size_t)7;
+    c->size = sizeof(FeatCacheHeader) + c->frames * c->recordBytes;
+    snprintf( c->path, sizeof(c->path), "%s/%016llx-%016llx.apbc", dir,
+              (unsigned long long)key->content, (unsigned long long)configHash( key ) );
+    snprintf( c->partPath, sizeof(c->partPath), "%s.part", c->path );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: featcache_open()
+// desc: anything off (missing, short, unfinished, another version or
+//       key) just means no cache
+//-----------------------------------------------------------------------------
+bool featcache_open( FeatCache * c, const char * dir, const FeatCacheKey * key )
+{
+    reset( c );
+    layout( c, dir, key );
+    struct stat st;
+    c->fd = open( c->path, O_RDONLY );
+    if( c->fd < 0 || fstat( c->fd, &st ) < 0 || (size_t)st.st_size != c->size )
+    {
+        featcache_close( c );
+        return false;
+    }
+    void * p = mmap( NULL, c->size, PROT_READ, MAP_SHARED, c->fd, 0 );
+    if( p == MAP_FAILED )
+    {
+        featcache_close( c );
+        return false;
+    }
+    c->header = (FeatCacheHeader *)p;
+    c->records = (unsigned char *)(c->header + 1);
+
+    const FeatCacheHeader * h = c->header;
+    if( h->magic != FEATCACHE_MAGIC || h->version != FEATCACHE_VERSION ||
+        h->featureVersion != FEATURE_VERSION || h->recordBytes != c->recordBytes ||
+        h->content != key->content || h->config != configHash( key ) ||
+        h->frames != (uint64_t)c->frames || h->bins != (uint64_t)c->bins )
+    {
+        featcache_close( c );
+        return false;
+    }
+    // a render walks it front to back
+    madvise( p, c->size, MADV_SEQUENTIAL );
+    madvise( p, c->size, MADV_WILLNEED );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: featcache_create()
+// desc: the file is built under a .part name at its full size (allocated
+//       up front, so a full disk fails here rather than faulting later)
+//-----------------------------------------------------------------------------
+bool featcache_create( FeatCache * c, const char * dir, const FeatCacheKey * key )
+{
+    reset( c );
+    layout( c, dir, key );
+    c->writer = true;
+    mkdir( dir, 0755 );
+
+    int err = 0;
+    c->fd = open( c->partPath, O_CREAT | O_RDWR | O_TRUNC, 0644 );
+    if( c->fd < 0 )
+        err = errno;
+    else
+        err = posix_fallocate( c->fd, 0, c->size );
+    void * p = MAP_FAILED;
+    if( !err )
+    {
+        p = mmap( NULL, c->size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0 );
+        if( p == MAP_FAILED )
+            err = errno;
+    }
+    if( err )
+    {
+        fprintf( stderr, "featcache: %s: %s\n", c->partPath, strerror( err ) );
+        featcache_close( c );
+        return false;
+    }
+    c->header = (FeatCacheHeader *)p;
+    c->records = (unsigned char *)(c->header + 1);
+
+    FeatCacheHeader * h = c->header;
+    h->magic = 0;
+    h->version = FEATCACHE_VERSION;
+    h->featureVersion = FEATURE_VERSION;
+    h->recordBytes = (uint32_t)c->recordBytes;
+    h->content = key->content;
+    h->config = configHash( key );
+    h->frames = c->frames;
+    h->bins = (uint32_t)c->bins;
+    h->blockFrames = (uint32_t)key->blockFrames;
+    h->srate = key->srate;
+    h->step = key->step;
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: featcache_write() / featcache_read()
+// desc: one record: the wire frame, then the magnitudes. the render asks
+//       for frames in order; the writer counts how far it got
+//-----------------------------------------------------------------------------
+void featcache_write( FeatCache * c, long index, const FeatureFrame * frame, const float * mag )
+{
+    if( index < 0 || index >= c->frames )
+        return;
+    unsigned char * p = c->records + index * c->recordBytes;
+    feature_pack( frame, p );
+    p += FEATURE_WIRE_SIZE;
+    for( long i = 0; i < c->bins; i++ )
+    {
+        uint32_t u;
+        memcpy( &u, mag + i, 4 );
+        p[4 * i] = u & 0xff;
+        p[4 * i + 1] = (u >> 8) & 0xff;
+        p[4 * i + 2] = (u >> 16) & 0xff;
+        p[4 * i + 3] = u >> 24;
+    }
+    if( index == c->written )
+        c->written++;
+}
+
+void featcache_read( const FeatCache * c, long index, FeatureFrame * frame, float * mag )
+{
+    if( index >= c->frames )
+        index = c->frames - 1;
+    if( index < 0 )
+        index = 0;
+    const unsigned char * p = c->records + index * c->recordBytes;
+    feature_unpack( p, FEATURE_WIRE_SIZE, frame );
+    p += FEATURE_WIRE_SIZE;
+    for( long i = 0; i < c->bins; i++ )
+    {
+        uint32_t u = p[4 * i] | (p[4 * i + 1] << 8) | (p[4 * i + 2] << 16) |
+            ((uint32_t)p[4 * i + 3] << 24);
+        memcpy( mag + i, &u, 4 );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: featcache_close()
+// desc: a finished writer marks the header valid and renames the file
+//       into place, so readers only ever find whole caches
+//-----------------------------------------------------------------------------
+void featcache_close( FeatCache * c )
+{
+    bool publish = c->writer && c->header && c->frames > 0 && c->written == c->frames;
+    if( publish )
+    {
+        c->header->magic = FEATCACHE_MAGIC;
+        msync( c->header, c->size, MS_SYNC );
+    }
+    if( c->header )
+        munmap( c->header, c->size );
+    if( c->fd >= 0 )
+        close( c->fd );
+    if( c->writer )
+    {
+        if( publish && rename( c->partPath, c->path ) == 0 )
+            fprintf( stderr, "featcache: wrote %s (%ld frames)\n", c->path, c->frames );
+        else
+            unlink( c->partPath );
+    }
+    reset( c );
+}
@@ -0,0 +1,59 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - featcache.h
+// desc: precomputed analysis for offline renders: one record per render
+//       frame (the feature frame in its compact wire format, then the full
+//       magnitude spectrum, kept exact so a replayed render is the same
+//       render) in a versioned file, keyed by
+//       the audio's content hash and everything about the analysis that
+//       shapes its output. the first render of a file writes it through
+//       a shared mapping; later ones map it read-only and do no analysis
+//       at all, and any frame is a pointer away
+//-----------------------------------------------------------------------------
+#ifndef __APB_FEATCACHE_H__
+#define __APB_FEATCACHE_H__
+
+#include "feature.h"
+
+struct FeatCacheHeader;
+
+struct FeatCache
+{
+    int fd;
+    FeatCacheHeader * header;
+    unsigned char * records;
+    size_t size;                    // of the mapping
+    size_t recordBytes;
+    long frames;                    // records in the file
+    long bins;                      // magnitudes per record
+    bool writer;
+    long written;                   // writer: records filled so far
+    char path[1024];                // the cache file
+    char partPath[1040];            // writer: where it's built
+};
+
+// the analysis settings a cache depends on
+struct FeatCacheKey
+{
+    uint64_t content;               // wav_hash() of the audio
+    double srate;
+    long blockFrames;
+    double step;                    // sample frames per render frame
+    long frames;                    // render frames in the file
+};
+
+// map dir's cache for key; false (quietly) if there isn't a valid one
+bool featcache_open( FeatCache * c, const char * dir, const FeatCacheKey * key );
+// start one for key in dir, filled by featcache_write() as the render
+// goes; false, with a message, if it can't be made
+bool featcache_create( FeatCache * c, const char * dir, const FeatCacheKey * key );
+// writer: record frame index. no allocation, no system calls
+void featcache_write( FeatCache * c, long index, const FeatureFrame * frame, const float * mag );
+// reader: decode frame index (clamped to the last) into frame and bins
+// magnitudes. no allocation
+void featcache_read( const FeatCache * c, long index, FeatureFrame * frame, float * mag );
+// unmap; a writer with every record filled publishes the file under its
+// final name, one without throws it away
+void featcache_close( FeatCache * c );
+
+
+#endif
@@ -0,0 +1,354 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - feature.cpp
+// desc: feature extraction and the feature frame wire format
+//-----------------------------------------------------------------------------
+#include "feature.h"
+#include "dsp.h"
+#include <math.h>
+#include <string.h>
+
+// band edges: the first band is everything below this, the rest are
+// log-spaced up to nyquist
+#define LOWEST_EDGE_HZ 40.0
+// log compression before flux, so quiet and loud passages both register
+#define FLUX_COMPRESSION 1000.0f
+// onset when flux exceeds its running mean by this many deviations...
+#define ONSET_DEVIATIONS 2.0f
+// ...and this much in absolute terms (silence has no onsets)
+#define ONSET_MIN_FLUX 0.1f
+// per band jump that sets its onsetBands bit
+#define ONSET_BAND_JUMP 0.3f
+// no two onsets closer than this
+#define ONSET_REFRACTORY 0.1
+// beat periods are folded into this range (200 to 60 bpm)
+#define BEAT_MIN_PERIOD 0.3
+#define BEAT_MAX_PERIOD 1.0
+// forget the tempo after this long without onsets
+#define BEAT_TIMEOUT 4.0
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: feature_init()
+// desc: band layout and fresh onset/tempo state
+//-----------------------------------------------------------------------------
+void feature_init( FeatureTracker * t, long bins, double srate )
+{
+    memset( t, 0, sizeof(*t) );
+    t->lastOnset = -1;
+    t->bins = bins;
+    t->srate = srate;
+
+    double nyquist = srate / 2, binHz = nyquist / bins;
+    t->bandEdges[0] = 0;
+    for( int k = 1; k < FEATURE_BANDS; k++ )
+    {
+        double hz = LOWEST_EDGE_HZ * pow( nyquist / LOWEST_EDGE_HZ, (k - 1) / (double)(FEATURE_BANDS - 1) );
+        long edge = (long)(hz / binHz + 0.5);
+        // every band gets at least one bin
+        if( edge <= t->bandEdges[k - 1] ) edge = t->bandEdges[k - 1] + 1;
+        t->bandEdges[k] = edge < bins ? edge : bins;
+    }
+    t->bandEdges[FEATURE_BANDS] = bins;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: trackBeat()
+// desc: tempo from inter-onset intervals (folded into one octave of bpm),
+//       phase nudged toward each onset
+//-----------------------------------------------------------------------------
+static void trackBeat( FeatureTracker * t, bool onset, double time )
+{
+    if( onset )
+    {
+        double interval = t->lastOnset >= 0 ? time - t->lastOnset : 0;
+        if( interval > 0 && interval < BEAT_TIMEOUT )
+        {
+            while( interval < BEAT_MIN_PERIOD ) interval *= 2;
+            while( interval > BEAT_MAX_PERIOD ) interval /= 2;
+            if( t->beatPeriod <= 0 )
+            {
+                t->beatPeriod = interval;
+                t->lastBeat = time;
+            }
+            else
+            {
+                t->beatPeriod += 0.15 * (interval - t->beatPeriod);
+                // signed distance to the nearest predicted beat, in beats
+                double beats = (time - t->lastBeat) / t->beatPeriod;
+                t->lastBeat += 0.25 * (beats - floor( beats + 0.5 )) * t->beatPeriod;
+            }
+        }
+        t->lastOnset = time;
+    }
+    else if( t->beatPeriod > 0 && time - t->lastOnset > BEAT_TIMEOUT )
+        t->beatPeriod = 0;
+
+    // keep lastBeat within one period of now
+    if( t->beatPeriod > 0 )
+        while( time - t->lastBeat >= t->beatPeriod )
+            t->lastBeat += t->beatPeriod;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: feature_compute()
+// desc: level, bands, onsets, beat, and the decimated spectrum/waveform
+//-----------------------------------------------------------------------------
+void feature_compute( FeatureTracker * t, const float * block, long frames,
+                       const float * mag, double time, FeatureFrame * out )
+{
+    out->seq = t->seq++;
+    out->srate = (float)t->srate;
+    out->blockFrames = (uint32_t)frames;
+    out->level = dsp_abs_sum( block, frames ) / frames;
+
+    // band energies and spectral flux over them
+    float flux = 0;
+    out->onsetBands = 0;
+    for( int k = 0; k < FEATURE_BANDS; k++ )
+    {
+        long lo = t->bandEdges[k], hi = t->bandEdges[k + 1];
+        float e = hi > lo ? dsp_band_sum( mag, lo, hi ) / (hi - lo) : 0;
+        float rise = logf( 1 + FLUX_COMPRESSION * e ) - logf( 1 + FLUX_COMPRESSION * t->prevBands[k] );
+        if( rise > 0 )
+            flux += rise;
+        if( rise > ONSET_BAND_JUMP )
+            out->onsetBands |= 1 << k;
+        out->bands[k] = t->prevBands[k] = e;
+    }
+
+    // adaptive threshold: running mean and mean deviation of the flux
+    bool onset = flux > t->fluxMean + ONSET_DEVIATIONS * t->fluxDev &&
+        flux > ONSET_MIN_FLUX && (t->lastOnset < 0 || time - t->lastOnset > ONSET_REFRACTORY);
+    t->fluxDev += 0.05f * (fabsf( flux - t->fluxMean ) - t->fluxDev);
+    t->fluxMean += 0.05f * (flux - t->fluxMean);
+    out->onset = onset ? 1 : 0;
+
+    trackBeat( t, onset, time );
+    out->beatPhase = t->beatPeriod > 0 ? (float)((time - t->lastBeat) / t->beatPeriod) : -1;
+    out->tempo = t->beatPeriod > 0 ? (float)(60 / t->beatPeriod) : 0;
+
+    // decimated spectrum: mean of each group of bins
+    for( int i = 0; i < FEATURE_SPECTRUM; i++ )
+    {
+        long lo = i * t->bins / FEATURE_SPECTRUM, hi = (i + 1) * t->bins / FEATURE_SPECTRUM;
+        if( hi <= lo ) hi = lo + 1;
+        out->spectrum[i] = dsp_band_sum( mag, lo, hi ) / (hi - lo);
+    }
+
+    // decimated waveform: point samples keep the shape's edges
+    for( int i = 0; i < FEATURE_WAVEFORM; i++ )
+    {
+        float x = block[i * frames / FEATURE_WAVEFORM];
+        out->waveform[i] = x < -1 ? -1 : x > 1 ? 1 : x;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: half floats
+// desc: spectrum, semitone, chroma and clarity values are positive and
+//       small; 11 bits of mantissa is plenty for drawing, and halves the
+//       datagram
+//-----------------------------------------------------------------------------
+static uint16_t toHalf( float f )
+{
+    uint32_t x;
+    memcpy( &x, &f, 4 );
+    uint16_t sign = (x >> 16) & 0x8000;
+    int exp = (int)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    if( exp >= 31 ) return sign | 0x7c00;
+    if( exp > 0 ) return sign | (exp << 10) | (mant >> 13);
+    // subnormal, or too small: zero
+    if( exp < -10 ) return sign;
+    return sign | ((mant | 0x800000) >> (14 - exp));
+}
+
+static float fromHalf( uint16_t h )
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    int exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff, x;
+    if( exp == 0 )
+    {
+        float f = mant * (1.0f / 16777216);
+        return sign ? -f : f;
+    }
+    if( exp == 31 ) x = sign | 0x7f800000 | (mant << 13);
+    else x = sign | ((uint32_t)(exp - 15 + 127) << 23) | (mant << 13);
+    float f;
+    memcpy( &f, &x, 4 );
+    return f;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: little-endian field access
+//-----------------------------------------------------------------------------
+static unsigned char * put16( unsigned char * p, uint16_t v )
+{
+    p[0] = v; p[1] = v >> 8;
+    return p + 2;
+}
+
+static unsigned char * put32( unsigned char * p, uint32_t v )
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+    return p + 4;
+}
+
+static unsigned char * putFloat( unsigned char * p, float f )
+{
+    uint32_t v;
+    memcpy( &v, &f, 4 );
+    return put32( p, v );
+}
+
+static unsigned char * putDouble( unsigned char * p, double d )
+{
+    uint64_t v;
+    memcpy( &v, &d, 8 );
+    p = put32( p, (uint32_t)v );
+    return put32( p, (uint32_t)(v >> 32) );
+}
+
+static uint16_t get16( const unsigned char *& p )
+{
+    uint16_t v = p[0] | (p[1] << 8);
+    p += 2;
+    return v;
+}
+
+static uint32_t get32( const unsigned char *& p )
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    p += 4;
+    return v;
+}
+
+static float getFloat( const unsigned char *& p )
+{
+    uint32_t v = get32( p );
+    float f;
+    memcpy( &f, &v, 4 );
+    return f;
+}
+
+static double getDouble( const unsigned char *& p )
+{
+    uint64_t v = get32( p );
+    v |= (uint64_t)get32( p ) << 32;
+    double d;
+    memcpy( &d, &v, 8 );
+    return d;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: feature_pack() / feature_unpack()
+// desc: see FEATURE_WIRE_SIZE
+//-----------------------------------------------------------------------------
+void feature_pack( const FeatureFrame * f, unsigned char * out )
+{
+    unsigned char * p = out;
+    p = put32( p, FEATURE_MAGIC );
+    p = put16( p, FEATURE_VERSION );
+    p = put16( p, 0 );
+    p = put32( p, f->seq );
+    p = putDouble( p, f->time );
+    p = putFloat( p, f->srate );
+    p = put32( p, f->blockFrames );
+    p = putFloat( p, f->level );
+    *p++ = f->onset;
+    *p++ = f->onsetBands;
+    p = put16( p, 0 );
+    p = putFloat( p, f->beatPhase );
+    p = putFloat( p, f->tempo );
+    for( int i = 0; i < FEATURE_BANDS; i++ )
+        p = putFloat( p, f->bands[i] );
+    for( int i = 0; i < FEATURE_SPECTRUM; i++ )
+        p = put16( p, toHalf( f->spectrum[i] ) );
+    for( int i = 0; i < FEATURE_WAVEFORM; i++ )
+        p = put16( p, (uint16_t)(int16_t)lrintf( f->waveform[i] * 32767 ) );
+    for( int i = 0; i < FEATURE_SEMITONES; i++ )
+        p = put16( p, toHalf( f->semitones[i] ) );
+    for( int i = 0; i < FEATURE_CHROMA; i++ )
+        p = put16( p, toHalf( f->chroma[i] ) );
+    *p++ = (uint8_t)f->key;
+    *p++ = (uint8_t)f->chord;
+    p = put16( p, 0 );
+    p = putFloat( p, f->pitch );
+    p = put16( p, toHalf( f->pitchClarity ) );
+    *p++ = f->voiced;
+    *p++ = 0;
+    p = putFloat( p, f->momentary );
+    p = putFloat( p, f->shortTerm );
+    p = putFloat( p, f->rms );
+    p = putFloat( p, f->peak );
+    p = putFloat( p, f->truePeak );
+    p = putFloat( p, f->centroid );
+    p = putFloat( p, f->spread );
+    p = putFloat( p, f->rolloff );
+    p = putFloat( p, f->flatness );
+    p = putFloat( p, f->flux );
+}
+
+bool feature_unpack( const unsigned char * in, size_t size, FeatureFrame * f )
+{
+    const unsigned char * p = in;
+    if( size < FEATURE_WIRE_SIZE || get32( p ) != FEATURE_MAGIC || get16( p ) != FEATURE_VERSION )
+        return false;
+    get16( p );
+    f->seq = get32( p );
+    f->time = getDouble( p );
+    f->srate = getFloat( p );
+    f->blockFrames = get32( p );
+    f->level = getFloat( p );
+    f->onset = *p++;
+    f->onsetBands = *p++;
+    get16( p );
+    f->beatPhase = getFloat( p );
+    f->tempo = getFloat( p );
+    for( int i = 0; i < FEATURE_BANDS; i++ )
+        f->bands[i] = getFloat( p );
+    for( int i = 0; i < FEATURE_SPECTRUM; i++ )
+        f->spectrum[i] = fromHalf( get16( p ) );
+    for( int i = 0; i < FEATURE_WAVEFORM; i++ )
+        f->waveform[i] = (int16_t)get16( p ) / 32767.0f;
+    for( int i = 0; i < FEATURE_SEMITONES; i++ )
+        f->semitones[i] = fromHalf( get16( p ) );
+    for( int i = 0; i < FEATURE_CHROMA; i++ )
+        f->chroma[i] = fromHalf( get16( p ) );
+    f->key = (int8_t)*p++;
+    f->chord = (int8_t)*p++;
+    get16( p );
+    f->pitch = getFloat( p );
+    f->pitchClarity = fromHalf( get16( p ) );
+    f->voiced = *p++;
+    p++;
+    f->momentary = getFloat( p );
+    f->shortTerm = getFloat( p );
+    f->rms = getFloat( p );
+    f->peak = getFloat( p );
+    f->truePeak = getFloat( p );
+    f->centroid = getFloat( p );
+    f->spread = getFloat( p );
+    f->rolloff = getFloat( p );
+    f->flatness = getFloat( p );
+    f->flux = getFloat( p );
+    return true;
+}
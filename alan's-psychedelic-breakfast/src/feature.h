@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - feature.h
+// desc: feature frames: what the analysis of one block boils down to
+//       (level, band energies, onsets, beat phase, a decimated spectrum
+//       and waveform), plus a compact little-endian wire format that fits
+//       in one UDP datagram, so render nodes can draw without the audio
+//-----------------------------------------------------------------------------
+#ifndef __APB_FEATURE_H__
+#define __APB_FEATURE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// log-spaced band energies
+#define FEATURE_BANDS 8
+// decimated magnitude spectrum (mean of each group of bins)
+#define FEATURE_SPECTRUM 128
+// decimated waveform (every n-th sample of the block, unwindowed)
+#define FEATURE_WAVEFORM 256
+// constant-Q magnitudes, one per semitone from C1 (7 octaves; see cqt.h)
+#define FEATURE_SEMITONES 84
+// pitch class energies, C first (see harmony.h)
+#define FEATURE_CHROMA 12
+
+// wire format: "APBF", version, then the fields below in order; floats are
+// IEEE little-endian, the spectrum, semitones, chroma and pitch clarity are
+// half floats, the waveform int16
+#define FEATURE_MAGIC 0x46425041
+#define FEATURE_VERSION 6
+#define FEATURE_WIRE_SIZE (96 + 4 * FEATURE_BANDS + 2 * FEATURE_SPECTRUM + 2 * FEATURE_WAVEFORM + \
+                           2 * FEATURE_SEMITONES + 2 * FEATURE_CHROMA)
+
+struct FeatureFrame
+{
+    uint32_t seq;                       // per publisher, +1 per frame
+    double time;                        // capture time, wall clock seconds
+    float srate;
+    uint32_t blockFrames;               // analysis block size
+    float level;                        // mean |x| over the block
+    uint8_t onset;                      // 1 if an onset was detected
+    uint8_t onsetBands;                 // bit i: band i jumped
+    float beatPhase;                    // [0, 1) into the beat, -1 = no tempo yet
+    float tempo;                        // bpm, 0 = no tempo yet
+    float bands[FEATURE_BANDS];         // mean magnitude per band
+    float spectrum[FEATURE_SPECTRUM];
+    float waveform[FEATURE_WAVEFORM];   // [-1, 1]
+    float semitones[FEATURE_SEMITONES]; // full scale sine = 1; set by the analysis stage
+    float chroma[FEATURE_CHROMA];       // [0, 1], smoothed; also set by the analysis stage
+    int8_t key;                         // see harmony.h; -1 = none
+    int8_t chord;
+    float pitch;                        // hz, monophonic f0 (see pitch.h); 0 = none
+    float pitchClarity;                 // [0, 1]
+    uint8_t voiced;                     // 1 if the pitch is worth following
+    float momentary;                    // LUFS over 400 ms (see loudness.h)
+    float shortTerm;                    // LUFS over 3 s
+    float rms;                          // linear, with attack/release
+    float peak;                         // linear, held with a decay
+    float truePeak;                     // same, between samples included
+    float centroid;                     // hz (see spectral.h)
+    float spread;                       // hz
+    float rolloff;                      // hz
+    float flatness;                     // [0, 1], 1 = noise
+    float flux;
+};
+
+// running state for onsets and tempo, one per analysis stream
+struct FeatureTracker
+{
+    long bins;
+    double srate;
+    long bandEdges[FEATURE_BANDS + 1];
+    float prevBands[FEATURE_BANDS];
+    float fluxMean;                     // adaptive onset threshold
+    float fluxDev;
+    double lastOnset;                   // stream seconds, < 0 = none yet
+    double lastBeat;
+    double beatPeriod;                  // seconds, 0 = unknown
+    uint32_t seq;
+};
+
+// set up for magnitude spectra of this many bins at this rate
+void feature_init( FeatureTracker * t, long bins, double srate );
+// one block: raw samples (before windowing) and its magnitude spectrum;
+// streamTime is the block's position in the audio, in seconds, and drives
+// onset/tempo timing. out->time is left for the caller to stamp. no
+// allocation
+void feature_compute( FeatureTracker * t, const float * block, long frames,
+                       const float * mag, double streamTime, FeatureFrame * out );
+
+// wire format; pack writes exactly FEATURE_WIRE_SIZE bytes
+void feature_pack( const FeatureFrame * f, unsigned char * out );
+// false if it isn't a frame of our version
+bool feature_unpack( const unsigned char * in, size_t size, FeatureFrame * f );
+
+
+#endif
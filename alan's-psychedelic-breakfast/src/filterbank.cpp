@@ -0,0 +1,143 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - filterbank.cpp
+// desc: band layout; the per-hop work is dsp_filterbank()
+//-----------------------------------------------------------------------------
+#include "filterbank.h"
+#include "dsp.h"
+#include <math.h>
+#include <string.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: toScale() / fromScale()
+// desc: hz to the warped axis and back. mel after O'Shaughnessy, Bark
+//       after Traunmueller
+//-----------------------------------------------------------------------------
+static double toScale( FilterScale scale, double hz )
+{
+    switch( scale )
+    {
+        case FILTER_MEL: return 2595.0 * log10( 1.0 + hz / 700.0 );
+        case FILTER_BARK: return 26.81 * hz / (1960.0 + hz) - 0.53;
+        default: return log( hz );
+    }
+}
+
+static double fromScale( FilterScale scale, double v )
+{
+    switch( scale )
+    {
+        case FILTER_MEL: return 700.0 * (pow( 10.0, v / 2595.0 ) - 1.0);
+        case FILTER_BARK: return 1960.0 * (v + 0.53) / (26.28 - v);
+        default: return exp( v );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: filterbank_size()
+// desc: a bin sits under at most two overlapping triangles, and a band
+//       narrower than a bin still takes one
+//-----------------------------------------------------------------------------
+size_t filterbank_size( long bands, long bins )
+{
+    return 2 * arena_size( sizeof(long) * bands ) +
+        arena_size( sizeof(float) * (2 * bins + bands) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: filterbank_init()
+// desc: band b rises from edge b to its center at edge b + 1 and falls to
+//       edge b + 2, with bands + 2 edges evenly spaced on the scale
+//-----------------------------------------------------------------------------
+void filterbank_init( FilterBank * fb, Arena * arena, FilterScale scale, long bands,
+                      long bins, double srate, double fmin, double fmax )
+{
+    memset( fb, 0, sizeof(*fb) );
+    fb->scale = scale;
+    fb->bands = bands;
+    fb->bins = bins;
+    fb->first = arena_array<long>( arena, bands );
+    fb->count = arena_array<long>( arena, bands );
+    fb->weights = arena_array<float>( arena, 2 * bins + bands );
+
+    double binHz = srate / 2 / bins;
+    if( fmax > srate / 2 ) fmax = srate / 2;
+    if( fmin < binHz / 2 ) fmin = binHz / 2;
+    double lo = toScale( scale, fmin ), hi = toScale( scale, fmax );
+
+    float * w = fb->weights;
+    for( long b = 0; b < bands; b++ )
+    {
+        double left = fromScale( scale, lo + (hi - lo) * b / (bands + 1) ) / binHz;
+        double center = fromScale( scale, lo + (hi - lo) * (b + 1) / (bands + 1) ) / binHz;
+        double right = fromScale( scale, lo + (hi - lo) * (b + 2) / (bands + 1) ) / binHz;
+
+        // bins strictly inside the triangle
+        long first = (long)floor( left ) + 1, last = (long)ceil( right ) - 1;
+        if( first < 0 ) first = 0;
+        if( last > bins - 1 ) last = bins - 1;
+        double sum = 0;
+        for( long k = first; k <= last; k++ )
+        {
+            w[k - first] = k <= center ? (k - left) / (center - left) : (right - k) / (right - center);
+            sum += w[k - first];
+        }
+
+        fb->first[b] = first;
+        fb->count[b] = last - first + 1;
+        if( sum <= 0 )
+        {
+            // narrower than a bin: the nearest one, whole
+            long k = (long)(center + 0.5);
+            fb->first[b] = k < bins ? k : bins - 1;
+            fb->count[b] = 1;
+            w[0] = 1;
+        }
+        else
+            for( long k = 0; k < fb->count[b]; k++ )
+                w[k] /= sum;
+        w += fb->count[b];
+    }
+    fb->nWeights = w - fb->weights;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: filterbank_apply()
+// desc: see header
+//-----------------------------------------------------------------------------
+void filterbank_apply( const FilterBank * fb, const float * mag, float * out )
+{
+    dsp_filterbank( mag, fb->weights, fb->first, fb->count, fb->bands, out );
+}
+
+bool filterbank_parse_scale( const char * name, FilterScale * scale )
+{
+    for( int s = FILTER_MEL; s <= FILTER_LOG; s++ )
+        if( !strcmp( name, filterbank_scale_name( (FilterScale)s ) ) )
+        {
+            *scale = (FilterScale)s;
+            return true;
+        }
+    return false;
+}
+
+const char * filterbank_scale_name( FilterScale scale )
+{
+    switch( scale )
+    {
+        case FILTER_MEL: return "mel";
+        case FILTER_BARK: return "bark";
+        default: return "log";
+    }
+}
@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - filterbank.h
+// desc: perceptual filterbank over magnitude spectra: triangular bands
+//       evenly spaced on the mel, Bark or log frequency scale, stored as
+//       one sparse run of weights per band and applied to the power
+//       spectrum (one dsp_filterbank() call per hop). a few dozen bands
+//       stand in for hundreds of linear bins, with the bass spread out
+//       and the treble folded together
+//-----------------------------------------------------------------------------
+#ifndef __APB_FILTERBANK_H__
+#define __APB_FILTERBANK_H__
+
+#include "arena.h"
+
+enum FilterScale
+{
+    FILTER_MEL = 0,
+    FILTER_BARK,
+    FILTER_LOG
+};
+
+struct FilterBank
+{
+    FilterScale scale;
+    long bands;
+    long bins;
+    long * first;           // first bin of each band
+    long * count;           // bins in each band
+    float * weights;        // band after band, count[b] each
+    long nWeights;
+};
+
+// arena bytes filterbank_init() carves for this many bands over bins
+size_t filterbank_size( long bands, long bins );
+// lay out bands from fmin to fmax (hz) over magnitude spectra of bins
+// bins at srate. each band's weights sum to 1, so a band's value is the
+// weighted mean power under it; bands narrower than a bin take the
+// nearest bin whole
+void filterbank_init( FilterBank * fb, Arena * arena, FilterScale scale, long bands,
+                      long bins, double srate, double fmin, double fmax );
+// out[b] = band b's power, from a magnitude spectrum. no allocation
+void filterbank_apply( const FilterBank * fb, const float * mag, float * out );
+// "mel", "bark" or "log"
+bool filterbank_parse_scale( const char * name, FilterScale * scale );
+const char * filterbank_scale_name( FilterScale scale );
+
+
+#endif
@@ -0,0 +1,151 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - golden.cpp
+// desc: captured-frame I/O and perceptual image comparison
+//-----------------------------------------------------------------------------
+#include "golden.h"
+#include <stdio.h>
+#include <math.h>
+#include <iostream>
+using namespace std;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: golden_write_ppm()
+// desc: binary PPM, top row first
+//-----------------------------------------------------------------------------
+bool golden_write_ppm( const char * path, long w, long h, const unsigned char * rgb )
+{
+    FILE * fd = fopen( path, "wb" );
+    if( !fd )
+    {
+        cerr << "golden: can't write " << path << endl;
+        return false;
+    }
+    fprintf( fd, "P6\n%ld %ld\n255\n", w, h );
+    bool ok = fwrite( rgb, 3, w * h, fd ) == (size_t)(w * h);
+    fclose( fd );
+    return ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: golden_read_ppm()
+// desc: binary PPM with maxval 255 only (what golden_write_ppm produces)
+//-----------------------------------------------------------------------------
+bool golden_read_ppm( const char * path, long & w, long & h, vector<unsigned char> & rgb )
+{
+    FILE * fd = fopen( path, "rb" );
+    if( !fd )
+        return false;
+    int maxval = 0;
+    bool ok = fscanf( fd, "P6 %ld %ld %d", &w, &h, &maxval ) == 3 &&
+              maxval == 255 && w > 0 && h > 0 && fgetc( fd ) != EOF;
+    if( ok )
+    {
+        rgb.resize( w * h * 3 );
+        ok = fread( &rgb[0], 3, w * h, fd ) == (size_t)(w * h);
+    }
+    fclose( fd );
+    if( !ok )
+        cerr << "golden: " << path << " is not a usable P6 image" << endl;
+    return ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: golden_compare()
+// desc: differences are weighted by roughly how visible they are: luma at
+//       full weight, the two chroma axes at half
+//-----------------------------------------------------------------------------
+void golden_compare( const unsigned char * expected, long ew, long eh,
+                     const unsigned char * actual, long aw, long ah,
+                     float pixelTol, float sectionTol, GoldenReport & report )
+{
+    report.sizeMismatch = ew != aw || eh != ah;
+    report.pass = !report.sizeMismatch;
+    report.worstBadFraction = report.sizeMismatch ? 1 : 0;
+    for( int r = 0; r < GOLDEN_GRID; r++ )
+        for( int c = 0; c < GOLDEN_GRID; c++ )
+        {
+            report.sections[r][c].badFraction = report.sizeMismatch ? 1 : 0;
+            report.sections[r][c].meanDiff = report.sizeMismatch ? 1 : 0;
+        }
+    if( report.sizeMismatch )
+        return;
+
+    for( int r = 0; r < GOLDEN_GRID; r++ )
+    {
+        long y0 = eh * r / GOLDEN_GRID, y1 = eh * (r + 1) / GOLDEN_GRID;
+        for( int c = 0; c < GOLDEN_GRID; c++ )
+        {
+            long x0 = ew * c / GOLDEN_GRID, x1 = ew * (c + 1) / GOLDEN_GRID;
+            double sum = 0;
+            long bad = 0, count = (y1 - y0) * (x1 - x0);
+            for( long y = y0; y < y1; y++ )
+            {
+                const unsigned char * e = expected + (y * ew + x0) * 3;
+                const unsigned char * a = actual + (y * ew + x0) * 3;
+                for( long x = x0; x < x1; x++, e += 3, a += 3 )
+                {
+                    float dr = (a[0] - e[0]) / 255.0f;
+                    float dg = (a[1] - e[1]) / 255.0f;
+                    float db = (a[2] - e[2]) / 255.0f;
+                    float dy = 0.299f * dr + 0.587f * dg + 0.114f * db;
+                    float du = 0.5f * (db - dy);
+                    float dv = 0.5f * (dr - dy);
+                    float d = sqrtf( dy * dy + du * du + dv * dv );
+                    sum += d;
+                    if( d > pixelTol )
+                        bad++;
+                }
+            }
+            GoldenSection & s = report.sections[r][c];
+            s.meanDiff = count ? (float)(sum / count) : 0;
+            s.badFraction = count ? (float)bad / count : 0;
+            if( s.badFraction > report.worstBadFraction )
+                report.worstBadFraction = s.badFraction;
+            if( s.badFraction > sectionTol )
+                report.pass = false;
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: golden_print()
+// desc: one line per frame, plus the section grid when it failed
+//-----------------------------------------------------------------------------
+void golden_print( const char * name, const GoldenReport & report, float sectionTol )
+{
+    if( report.sizeMismatch )
+    {
+        cerr << "golden: " << name << ": FAIL (image size differs)" << endl;
+        return;
+    }
+
+    fprintf( stderr, "golden: %s: %s (worst section %.2f%% off)\n", name,
+             report.pass ? "ok" : "FAIL", report.worstBadFraction * 100 );
+    if( report.pass )
+        return;
+
+    // grid rows top to bottom: percent of bad pixels / mean difference
+    for( int r = 0; r < GOLDEN_GRID; r++ )
+    {
+        fprintf( stderr, "    " );
+        for( int c = 0; c < GOLDEN_GRID; c++ )
+        {
+            const GoldenSection & s = report.sections[r][c];
+            fprintf( stderr, " %c%6.2f%%/%.3f", s.badFraction > sectionTol ? '*' : ' ',
+                     s.badFraction * 100, s.meanDiff );
+        }
+        fprintf( stderr, "\n" );
+    }
+}
@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - golden.h
+// desc: captured-frame I/O (binary PPM) and perceptual image comparison,
+//       used to check that renderer changes don't alter the visuals
+//-----------------------------------------------------------------------------
+#ifndef __APB_GOLDEN_H__
+#define __APB_GOLDEN_H__
+
+#include <vector>
+
+
+// sections per side; the image is compared as a GOLDEN_GRID x GOLDEN_GRID grid
+#define GOLDEN_GRID 4
+
+struct GoldenSection
+{
+    // fraction of pixels whose difference exceeds the pixel tolerance
+    float badFraction;
+    // mean perceptual difference over the section, 0..1
+    float meanDiff;
+};
+
+struct GoldenReport
+{
+    bool sizeMismatch;
+    bool pass;
+    float worstBadFraction;
+    GoldenSection sections[GOLDEN_GRID][GOLDEN_GRID];
+};
+
+// write / read tightly packed top-down RGB as binary PPM (P6)
+bool golden_write_ppm( const char * path, long w, long h, const unsigned char * rgb );
+bool golden_read_ppm( const char * path, long & w, long & h, std::vector<unsigned char> & rgb );
+
+// compare two RGB images. a pixel is "bad" when its luma-weighted difference
+// exceeds pixelTol (0..1); a section fails when more than sectionTol of its
+// pixels are bad. the report passes when no section fails
+void golden_compare( const unsigned char * expected, long ew, long eh,
+                     const unsigned char * actual, long aw, long ah,
+                     float pixelTol, float sectionTol, GoldenReport & report );
+
+// print the per-section table for a report
+void golden_print( const char * name, const GoldenReport & report, float sectionTol );
+
+
+#endif
@@ -0,0 +1,180 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - harmony.cpp
+// desc: chroma, key and chord tracking
+//-----------------------------------------------------------------------------
+#include "harmony.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// smoothing time constants, seconds
+#define CHORD_TAU 0.3
+#define KEY_TAU 4.0
+// below this much semitone magnitude (rms over all bins times sqrt(bins))
+// there's nothing to name
+#define SILENCE 0.01f
+// a chord needs this cosine to its triad...
+#define CHORD_MIN_SCORE 0.6f
+// ...and has to beat the current one by this much to replace it
+#define CHORD_HYSTERESIS 0.05f
+
+// Krumhansl & Kessler's probe tone ratings, tonic first
+static const float MAJOR_PROFILE[HARMONY_CLASSES] =
+    { 6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f };
+static const float MINOR_PROFILE[HARMONY_CLASSES] =
+    { 6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f };
+
+static const char * NAMES[HARMONY_CLASSES] =
+    { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: harmony_init()
+// desc: rotated, normalized key profiles, so the key is a dot product
+//-----------------------------------------------------------------------------
+void harmony_init( HarmonyTracker * h )
+{
+    memset( h, 0, sizeof(*h) );
+    h->hop = -1;
+    h->key = h->chord = HARMONY_NONE;
+
+    for( int k = 0; k < 24; k++ )
+    {
+        const float * profile = k < HARMONY_MINOR ? MAJOR_PROFILE : MINOR_PROFILE;
+        int tonic = k % HARMONY_CLASSES;
+        float mean = 0, norm = 0;
+        for( int i = 0; i < HARMONY_CLASSES; i++ )
+            mean += profile[i] / HARMONY_CLASSES;
+        for( int i = 0; i < HARMONY_CLASSES; i++ )
+        {
+            float v = profile[(i - tonic + HARMONY_CLASSES) % HARMONY_CLASSES] - mean;
+            h->profiles[k][i] = v;
+            norm += v * v;
+        }
+        for( int i = 0; i < HARMONY_CLASSES; i++ )
+            h->profiles[k][i] /= sqrtf( norm );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: triadScore()
+// desc: cosine between chroma and the triad's 0/1 template
+//-----------------------------------------------------------------------------
+static float triadScore( const float * chroma, float norm, int chord )
+{
+    int root = chord % HARMONY_CLASSES;
+    int third = chord < HARMONY_MINOR ? 4 : 3;
+    float sum = chroma[root] + chroma[(root + third) % HARMONY_CLASSES] +
+        chroma[(root + 7) % HARMONY_CLASSES];
+    return sum / (norm * sqrtf( 3.0f ));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: harmony_process()
+// desc: fold, smooth, then pick; silence lets the chroma fade and names
+//       nothing, but keeps the key until the long chroma has faded too.
+//       the smoothing rates follow the hop, so the time constants hold
+//       whatever it is
+//-----------------------------------------------------------------------------
+void harmony_process( HarmonyTracker * h, const float * semitones, long count, double hopSeconds )
+{
+    if( hopSeconds != h->hop )
+    {
+        h->hop = hopSeconds;
+        h->shortRate = (float)(1 - exp( -hopSeconds / CHORD_TAU ));
+        h->longRate = (float)(1 - exp( -hopSeconds / KEY_TAU ));
+    }
+
+    float fold[HARMONY_CLASSES] = { 0 };
+    float total = 0;
+    // energy, so a semitone's neighbours (half its magnitude, through
+    // the constant-Q kernels' overlap) count for a quarter
+    for( long i = 0; i < count; i++ )
+    {
+        float e = semitones[i] * semitones[i];
+        fold[i % HARMONY_CLASSES] += e;
+        total += e;
+    }
+    float peak = 0;
+    for( int i = 0; i < HARMONY_CLASSES; i++ )
+        peak = fmaxf( peak, fold[i] );
+    bool silent = total < SILENCE * SILENCE;
+
+    float norm = 0, longMean = 0;
+    for( int i = 0; i < HARMONY_CLASSES; i++ )
+    {
+        float c = silent ? 0 : fold[i] / peak;
+        h->chroma[i] += h->shortRate * (c - h->chroma[i]);
+        h->longChroma[i] += h->longRate * (c - h->longChroma[i]);
+        norm += h->chroma[i] * h->chroma[i];
+        longMean += h->longChroma[i] / HARMONY_CLASSES;
+    }
+    norm = sqrtf( norm );
+
+    // key: correlation of the long chroma with each profile
+    float longNorm = 0;
+    for( int i = 0; i < HARMONY_CLASSES; i++ )
+        longNorm += (h->longChroma[i] - longMean) * (h->longChroma[i] - longMean);
+    longNorm = sqrtf( longNorm );
+    h->key = HARMONY_NONE;
+    h->keyScore = 0;
+    if( longNorm > SILENCE )
+        for( int k = 0; k < 24; k++ )
+        {
+            float r = 0;
+            for( int i = 0; i < HARMONY_CLASSES; i++ )
+                r += h->profiles[k][i] * (h->longChroma[i] - longMean);
+            r /= longNorm;
+            if( h->key == HARMONY_NONE || r > h->keyScore )
+            {
+                h->key = k;
+                h->keyScore = r;
+            }
+        }
+
+    // chord: best triad, sticky
+    int best = HARMONY_NONE;
+    float bestScore = 0;
+    if( !silent && norm > SILENCE )
+        for( int c = 0; c < 24; c++ )
+        {
+            float s = triadScore( h->chroma, norm, c );
+            if( s > bestScore )
+            {
+                best = c;
+                bestScore = s;
+            }
+        }
+    float current = h->chord != HARMONY_NONE && norm > SILENCE ? triadScore( h->chroma, norm, h->chord ) : 0;
+    if( bestScore < CHORD_MIN_SCORE )
+    {
+        h->chord = HARMONY_NONE;
+        h->chordScore = 0;
+    }
+    else if( h->chord == HARMONY_NONE || current < CHORD_MIN_SCORE ||
+             bestScore > current + CHORD_HYSTERESIS )
+    {
+        h->chord = best;
+        h->chordScore = bestScore;
+    }
+    else
+        h->chordScore = current;
+}
+
+const char * harmony_name( int keyOrChord, char * buf, long size )
+{
+    if( keyOrChord == HARMONY_NONE )
+        snprintf( buf, size, "-" );
+    else
+        snprintf( buf, size, "%s %s", NAMES[keyOrChord % HARMONY_CLASSES],
+                  keyOrChord < HARMONY_MINOR ? "major" : "minor" );
+    return buf;
+}
@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - harmony.h
+// desc: chroma and a running key/chord guess, from constant-Q semitone
+//       magnitudes (see cqt.h). semitones fold into 12 pitch classes,
+//       smoothed over a short window for chords and a long one for the
+//       key; the key is the best of 24 Krumhansl-Kessler profiles, the
+//       chord the best of 24 major/minor triads, with some hysteresis.
+//       a hop costs a few hundred multiply-adds (see the budget in analysis.h)
+//-----------------------------------------------------------------------------
+#ifndef __APB_HARMONY_H__
+#define __APB_HARMONY_H__
+
+// pitch classes, C first
+#define HARMONY_CLASSES 12
+// keys and chords: 0-11 major on C..B, 12-23 minor on C..B
+#define HARMONY_MAJOR 0
+#define HARMONY_MINOR 12
+#define HARMONY_NONE -1
+
+struct HarmonyTracker
+{
+    double hop;                                 // seconds the rates are for
+    float shortRate;                            // smoothing per hop
+    float longRate;
+    float chroma[HARMONY_CLASSES];              // short term, max 1
+    float longChroma[HARMONY_CLASSES];
+    float profiles[24][HARMONY_CLASSES];        // key profiles, zero mean, unit norm
+    int key;
+    float keyScore;                             // correlation, [-1, 1]
+    int chord;
+    float chordScore;                           // cosine to the triad, [0, 1]
+};
+
+void harmony_init( HarmonyTracker * h );
+// one hop of hopSeconds (the audio it adds; offline that's the frame
+// step, not the block): count semitone magnitudes, the first one a C.
+// no allocation
+void harmony_process( HarmonyTracker * h, const float * semitones, long count, double hopSeconds );
+// "A minor", "C# major" or "-"
+const char * harmony_name( int keyOrChord, char * buf, long size );
+
+
+#endif
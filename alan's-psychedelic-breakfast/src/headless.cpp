@@ -0,0 +1,272 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - headless.cpp
+// desc: the handful of GLUT calls the visualizer makes, over offscreen
+//       EGL pbuffers (Mesa's surfaceless platform), so golden renders
+//       (make golden) need no display or X server. windows are fixed
+//       size, there is no input, and bitmap text is not drawn
+//-----------------------------------------------------------------------------
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glut.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using namespace std;
+
+
+#define HEADLESS_MAX_WINDOWS 16
+
+// one pbuffer and context per window, and its callbacks
+struct HeadlessWindow
+{
+    EGLSurface surface;
+    EGLContext context;
+    int width;
+    int height;
+    void (*display)( void );
+    void (*reshape)( int, int );
+    bool reshaped;      // reshape has been called with the size
+    bool redisplay;     // display is due
+};
+
+static EGLDisplay g_display = EGL_NO_DISPLAY;
+static EGLConfig g_config;
+static HeadlessWindow g_windows[HEADLESS_MAX_WINDOWS];
+static int g_numWindows = 0;
+static int g_current = -1;
+static int g_initWidth = 300;
+static int g_initHeight = 300;
+static void (*g_idle)( void ) = NULL;
+
+// GLUT_BITMAP_8_BY_13 is this symbol's address
+void * glutBitmap8By13 = NULL;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fail()
+// desc: nothing renders without a context, so give up
+//-----------------------------------------------------------------------------
+static void fail( const char * what )
+{
+    cerr << "headless: " << what << " (EGL error 0x" << hex << eglGetError()
+         << dec << ")" << endl;
+    exit( 2 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: makeCurrent()
+// desc: bind window i's context
+//-----------------------------------------------------------------------------
+static void makeCurrent( int i )
+{
+    g_current = i;
+    HeadlessWindow * w = &g_windows[i];
+    if( !eglMakeCurrent( g_display, w->surface, w->surface, w->context ) )
+        fail( "can't make the window current" );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: glutInit()
+// desc: open the surfaceless display and pick an RGB + depth config
+//-----------------------------------------------------------------------------
+void glutInit( int * argc, char ** argv )
+{
+    (void)argc;
+    (void)argv;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+    if( !getPlatformDisplay )
+        fail( "no eglGetPlatformDisplayEXT" );
+    g_display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+    if( g_display == EGL_NO_DISPLAY || !eglInitialize( g_display, NULL, NULL ) )
+        fail( "can't open the surfaceless display" );
+
+    const EGLint attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLint count = 0;
+    if( !eglChooseConfig( g_display, attribs, &g_config, 1, &count ) || count < 1 )
+        fail( "no RGB pbuffer config" );
+    if( !eglBindAPI( EGL_OPENGL_API ) )
+        fail( "no desktop OpenGL" );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: window setup
+// desc: the display mode is always RGB + depth; position is meaningless
+//-----------------------------------------------------------------------------
+void glutInitDisplayMode( unsigned int mode )
+{
+    (void)mode;
+}
+
+void glutInitWindowSize( int width, int height )
+{
+    g_initWidth = width;
+    g_initHeight = height;
+}
+
+void glutInitWindowPosition( int x, int y )
+{
+    (void)x;
+    (void)y;
+}
+
+int glutCreateWindow( const char * title )
+{
+    (void)title;
+    if( g_numWindows == HEADLESS_MAX_WINDOWS )
+        fail( "too many windows" );
+
+    HeadlessWindow * w = &g_windows[g_numWindows];
+    memset( w, 0, sizeof(HeadlessWindow) );
+    const EGLint attribs[] = { EGL_WIDTH, g_initWidth, EGL_HEIGHT, g_initHeight, EGL_NONE };
+    w->surface = eglCreatePbufferSurface( g_display, g_config, attribs );
+    if( w->surface == EGL_NO_SURFACE )
+        fail( "can't create a pbuffer" );
+    w->context = eglCreateContext( g_display, g_config, EGL_NO_CONTEXT, NULL );
+    if( w->context == EGL_NO_CONTEXT )
+        fail( "can't create a context" );
+    w->width = g_initWidth;
+    w->height = g_initHeight;
+
+    makeCurrent( g_numWindows++ );
+    return g_current + 1;
+}
+
+int glutGetWindow( void )
+{
+    return g_current + 1;
+}
+
+// a pbuffer keeps the size it was made with
+void glutFullScreen( void )
+{
+}
+
+void glutReshapeWindow( int width, int height )
+{
+    (void)width;
+    (void)height;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: callbacks
+// desc: display and reshape per window; no input ever arrives
+//-----------------------------------------------------------------------------
+void glutDisplayFunc( void (*callback)( void ) )
+{
+    g_windows[g_current].display = callback;
+}
+
+void glutReshapeFunc( void (*callback)( int, int ) )
+{
+    g_windows[g_current].reshape = callback;
+}
+
+void glutKeyboardFunc( void (*callback)( unsigned char, int, int ) )
+{
+    (void)callback;
+}
+
+void glutMouseFunc( void (*callback)( int, int, int, int ) )
+{
+    (void)callback;
+}
+
+void glutIdleFunc( void (*callback)( void ) )
+{
+    g_idle = callback;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: drawing
+// desc: a pbuffer has one buffer, so a swap only has to finish the frame
+//-----------------------------------------------------------------------------
+void glutPostRedisplay( void )
+{
+    g_windows[g_current].redisplay = true;
+}
+
+void glutPostWindowRedisplay( int window )
+{
+    g_windows[window - 1].redisplay = true;
+}
+
+void glutSwapBuffers( void )
+{
+    glFinish();
+}
+
+void glutBitmapCharacter( void * font, int character )
+{
+    (void)font;
+    (void)character;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: glutMainLoop()
+// desc: reshape each new window once, then idle and redraw what was
+//       posted, for as long as the program runs (offline renders exit
+//       when the file ends)
+//-----------------------------------------------------------------------------
+void glutMainLoop( void )
+{
+    while( true )
+    {
+        for( int i = 0; i < g_numWindows; i++ )
+        {
+            HeadlessWindow * w = &g_windows[i];
+            if( w->reshaped )
+                continue;
+            w->reshaped = true;
+            w->redisplay = true;
+            if( w->reshape )
+            {
+                makeCurrent( i );
+                w->reshape( w->width, w->height );
+            }
+        }
+
+        if( g_idle )
+        {
+            makeCurrent( 0 );
+            g_idle();
+        }
+
+        for( int i = 0; i < g_numWindows; i++ )
+        {
+            HeadlessWindow * w = &g_windows[i];
+            if( !w->redisplay || !w->display )
+                continue;
+            w->redisplay = false;
+            makeCurrent( i );
+            w->display();
+        }
+    }
+}
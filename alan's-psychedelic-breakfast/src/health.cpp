@@ -0,0 +1,170 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - health.cpp
+// desc: capture health counters and histograms
+//-----------------------------------------------------------------------------
+#include "health.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// written by the audio thread only, read by anyone; relaxed atomics are
+// enough since each field stands on its own
+static unsigned long g_callbacks;
+static unsigned long g_overflows;
+static unsigned long g_underflows;
+static unsigned long g_duration[HEALTH_BUCKETS];
+static unsigned long g_jitter[HEALTH_BUCKETS];
+static unsigned long g_durationMaxNs;
+static unsigned long g_jitterMaxNs;
+static double g_period;
+// audio thread private
+static double g_start = -1;
+static double g_lastStart = -1;
+
+#define LOAD(x) __atomic_load_n( &(x), __ATOMIC_RELAXED )
+#define STORE(x, v) __atomic_store_n( &(x), (v), __ATOMIC_RELAXED )
+#define BUMP(x) STORE( x, LOAD( x ) + 1 )
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: health_init()
+// desc: reset; call with the stream stopped
+//-----------------------------------------------------------------------------
+void health_init( double period )
+{
+    STORE( g_callbacks, 0UL );
+    STORE( g_overflows, 0UL );
+    STORE( g_underflows, 0UL );
+    for( int i = 0; i < HEALTH_BUCKETS; i++ )
+    {
+        STORE( g_duration[i], 0UL );
+        STORE( g_jitter[i], 0UL );
+    }
+    STORE( g_durationMaxNs, 0UL );
+    STORE( g_jitterMaxNs, 0UL );
+    g_period = period;
+    g_start = g_lastStart = -1;
+}
+
+double health_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: health_bucket() / record()
+// desc: one sample into a histogram and its max
+//-----------------------------------------------------------------------------
+int health_bucket( double seconds )
+{
+    unsigned long us = seconds > 0 ? (unsigned long)(seconds * 1e6) : 0;
+    int bucket = us < 2 ? 0 : (int)(sizeof(long) * 8 - 1) - __builtin_clzl( us );
+    return bucket < HEALTH_BUCKETS ? bucket : HEALTH_BUCKETS - 1;
+}
+
+static void record( unsigned long * hist, unsigned long * maxNs, double seconds )
+{
+    unsigned long ns = seconds > 0 ? (unsigned long)(seconds * 1e9) : 0;
+    BUMP( hist[health_bucket( seconds )] );
+    if( ns > LOAD( *maxNs ) ) STORE( *maxNs, ns );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: health_callback_begin() / health_callback_end()
+// desc: audio thread; no locks, no allocation
+//-----------------------------------------------------------------------------
+void health_callback_begin( bool overflow, bool underflow )
+{
+    g_start = health_now();
+    if( g_lastStart >= 0 )
+    {
+        double off = g_start - g_lastStart - g_period;
+        record( g_jitter, &g_jitterMaxNs, off < 0 ? -off : off );
+    }
+    g_lastStart = g_start;
+
+    if( overflow ) BUMP( g_overflows );
+    if( underflow ) BUMP( g_underflows );
+}
+
+void health_callback_end()
+{
+    if( g_start < 0 ) return;
+    record( g_duration, &g_durationMaxNs, health_now() - g_start );
+    BUMP( g_callbacks );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: health_snapshot()
+// desc: copy out
+//-----------------------------------------------------------------------------
+void health_snapshot( HealthStats * out )
+{
+    out->callbacks = LOAD( g_callbacks );
+    out->overflows = LOAD( g_overflows );
+    out->underflows = LOAD( g_underflows );
+    for( int i = 0; i < HEALTH_BUCKETS; i++ )
+    {
+        out->duration[i] = LOAD( g_duration[i] );
+        out->jitter[i] = LOAD( g_jitter[i] );
+    }
+    out->durationMax = LOAD( g_durationMaxNs ) * 1e-9;
+    out->jitterMax = LOAD( g_jitterMaxNs ) * 1e-9;
+    out->period = g_period;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: health_percentile()
+// desc: coarse (a power of two wide), but enough to spot trouble
+//-----------------------------------------------------------------------------
+double health_percentile( const unsigned long * hist, double p )
+{
+    unsigned long total = 0;
+    for( int i = 0; i < HEALTH_BUCKETS; i++ )
+        total += hist[i];
+    if( total == 0 ) return 0;
+
+    unsigned long want = (unsigned long)(p * total + 0.5), seen = 0;
+    for( int i = 0; i < HEALTH_BUCKETS; i++ )
+    {
+        seen += hist[i];
+        if( seen >= want && seen > 0 )
+            return (2UL << i) * 1e-6;
+    }
+    return (2UL << (HEALTH_BUCKETS - 1)) * 1e-6;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: health_format()
+// desc: "blocks 1234, xruns 2 in / 0 out, callback p99 <0.5ms max 0.7ms,
+//       jitter p99 <2.0ms max 3.1ms (period 11.6ms)"
+//-----------------------------------------------------------------------------
+void health_format( const HealthStats * s, char * buf, size_t size )
+{
+    snprintf( buf, size,
+              "blocks %lu, xruns %lu in / %lu out, callback p99 <%.1fms max %.1fms, "
+              "jitter p99 <%.1fms max %.1fms (period %.1fms)",
+              s->callbacks, s->overflows, s->underflows,
+              health_percentile( s->duration, 0.99 ) * 1000, s->durationMax * 1000,
+              health_percentile( s->jitter, 0.99 ) * 1000, s->jitterMax * 1000,
+              s->period * 1000 );
+}
@@ -0,0 +1,45 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - health.h
+// desc: capture health. the audio callback counts over/underflows and
+//       times itself (execution time, and interval jitter against the
+//       block period) into lock-free counters and log2 histograms; any
+//       other thread can take a snapshot for the overlay or the log
+//-----------------------------------------------------------------------------
+#ifndef __APB_HEALTH_H__
+#define __APB_HEALTH_H__
+
+#include <stddef.h>
+
+// log2 microsecond buckets: [0,2us), [2,4us), [4,8us) ... [2^23us, inf)
+#define HEALTH_BUCKETS 24
+
+struct HealthStats
+{
+    unsigned long callbacks;
+    unsigned long overflows;                // input overflow flags seen
+    unsigned long underflows;               // output underflow flags seen
+    unsigned long duration[HEALTH_BUCKETS]; // callback execution time
+    unsigned long jitter[HEALTH_BUCKETS];   // |interval - period|
+    double durationMax;                     // seconds
+    double jitterMax;                       // seconds
+    double period;                          // expected seconds per block
+};
+
+// start over for a stream with this block period (bufferFrames / srate)
+void health_init( double period );
+// monotonic clock, seconds
+double health_now();
+// audio thread only: bracket the callback body
+void health_callback_begin( bool overflow, bool underflow );
+void health_callback_end();
+// copy the counters (any thread; fields are individually consistent)
+void health_snapshot( HealthStats * out );
+// histogram bucket for a duration (for other histograms of this shape)
+int health_bucket( double seconds );
+// upper edge, in seconds, of the bucket holding the p-th fraction
+double health_percentile( const unsigned long * hist, double p );
+// one-line summary for the log
+void health_format( const HealthStats * stats, char * buf, size_t size );
+
+
+#endif
@@ -0,0 +1,207 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - loudness.cpp
+// desc: loudness metering
+//-----------------------------------------------------------------------------
+#include "loudness.h"
+#include "dsp.h"
+#include <math.h>
+#include <string.h>
+
+// windows, seconds
+#define SLICE 0.01
+#define MOMENTARY 0.4
+#define SHORT_TERM 3.0
+// rms ballistics and peak hold decay, seconds
+#define RMS_ATTACK 0.05
+#define RMS_RELEASE 0.3
+#define PEAK_RELEASE 0.5
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: kWeighting()
+// desc: BS.1770's two stages, a high shelf (+4 dB above ~1.7 kHz) and a
+//       highpass at ~38 Hz, redesigned for any rate from their analog
+//       prototypes (the coefficients in the standard are these at 48 kHz)
+//-----------------------------------------------------------------------------
+static void kWeighting( double srate, Biquad * shelf, Biquad * highpass )
+{
+    memset( shelf, 0, sizeof(*shelf) );
+    memset( highpass, 0, sizeof(*highpass) );
+
+    double k = tan( M_PI * 1681.974450955533 / srate );
+    double q = 0.7071752369554196;
+    double vh = pow( 10.0, 3.999843853973347 / 20 );
+    double vb = pow( vh, 0.4996667741545416 );
+    double a0 = 1 + k / q + k * k;
+    shelf->b0 = (vh + vb * k / q + k * k) / a0;
+    shelf->b1 = 2 * (k * k - vh) / a0;
+    shelf->b2 = (vh - vb * k / q + k * k) / a0;
+    shelf->a1 = 2 * (k * k - 1) / a0;
+    shelf->a2 = (1 - k / q + k * k) / a0;
+
+    k = tan( M_PI * 38.13547087602444 / srate );
+    q = 0.5003270373238773;
+    a0 = 1 + k / q + k * k;
+    highpass->b0 = 1;
+    highpass->b1 = -2;
+    highpass->b2 = 1;
+    highpass->a1 = 2 * (k * k - 1) / a0;
+    highpass->a2 = (1 - k / q + k * k) / a0;
+}
+
+static inline double biquad( Biquad * f, double x )
+{
+    double y = f->b0 * x + f->z1;
+    f->z1 = f->b1 * x - f->a1 * y + f->z2;
+    f->z2 = f->b2 * x - f->a2 * y;
+    return y;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: loudness_size()
+// desc: the slice ring, and the true peak interpolator's input
+//-----------------------------------------------------------------------------
+size_t loudness_size( long blockFrames )
+{
+    return arena_size( sizeof(double) * (long)ceil( SHORT_TERM / SLICE ) ) +
+        arena_size( sizeof(float) * (LOUDNESS_TAPS - 1 + blockFrames) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: loudness_init()
+// desc: the true peak interpolator's phases are hann windowed sincs at
+//       fractional delays between the middle two taps, unity gain at dc
+//-----------------------------------------------------------------------------
+void loudness_init( LoudnessMeter * m, Arena * arena, long blockFrames, double srate )
+{
+    memset( m, 0, sizeof(*m) );
+    kWeighting( srate, &m->shelf, &m->highpass );
+    m->sliceFrames = (long)(srate * SLICE + 0.5);
+    m->numSlices = (long)ceil( SHORT_TERM / SLICE );
+    m->momentarySlices = (long)ceil( MOMENTARY / SLICE );
+    m->slices = arena_array<double>( arena, m->numSlices );
+    m->history = arena_array<float>( arena, LOUDNESS_TAPS - 1 + blockFrames );
+    m->maxFrames = blockFrames;
+
+    for( int p = 1; p < LOUDNESS_OVERSAMPLE; p++ )
+    {
+        double t = LOUDNESS_TAPS / 2 - 1 + p / (double)LOUDNESS_OVERSAMPLE;
+        float sum = 0;
+        for( int k = 0; k < LOUDNESS_TAPS; k++ )
+        {
+            double u = k - t;
+            double w = 0.5 + 0.5 * cos( M_PI * u / (LOUDNESS_TAPS / 2) );
+            m->phase[p - 1][k] = (float)(sin( M_PI * u ) / (M_PI * u) * w);
+            sum += m->phase[p - 1][k];
+        }
+        for( int k = 0; k < LOUDNESS_TAPS; k++ )
+            m->phase[p - 1][k] /= sum;
+    }
+
+    m->attack = (float)(1 - exp( -SLICE / RMS_ATTACK ));
+    m->release = (float)(1 - exp( -SLICE / RMS_RELEASE ));
+    m->peakRelease = (float)exp( -1 / (PEAK_RELEASE * srate) );
+    m->momentary = m->shortTerm = LOUDNESS_FLOOR;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: windowLoudness()
+// desc: LUFS over the newest n finished slices (fewer, early on)
+//-----------------------------------------------------------------------------
+static float windowLoudness( const LoudnessMeter * m, long n )
+{
+    if( n > m->slicesSeen )
+        n = m->slicesSeen;
+    if( n == 0 )
+        return LOUDNESS_FLOOR;
+    double sum = 0;
+    for( long i = 1; i <= n; i++ )
+        sum += m->slices[(m->slicePos - i + m->numSlices) % m->numSlices];
+    double meanSquare = sum / (n * m->sliceFrames);
+    if( meanSquare <= 0 )
+        return LOUDNESS_FLOOR;
+    float lufs = (float)(-0.691 + 10 * log10( meanSquare ));
+    return lufs > LOUDNESS_FLOOR ? lufs : LOUDNESS_FLOOR;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: truePeak()
+// desc: largest |x| of the block, between samples included: each phase of
+//       the interpolator runs over the block in turn, with the previous
+//       block's last taps in front of it. the sample itself lands at
+//       LOUDNESS_TAPS / 2 - 1 in, so the newest few wait for the next call
+//-----------------------------------------------------------------------------
+static float truePeak( LoudnessMeter * m, const float * in, long frames )
+{
+    static const float unit = 1;
+    float * x = m->history;
+    memcpy( x + LOUDNESS_TAPS - 1, in, sizeof(float) * frames );
+    float top = dsp_fir_peak( x + LOUDNESS_TAPS / 2 - 1, &unit, 1, frames );
+    for( int p = 0; p < LOUDNESS_OVERSAMPLE - 1; p++ )
+        top = fmaxf( top, dsp_fir_peak( x, m->phase[p], LOUDNESS_TAPS, frames ) );
+    memmove( x, x + frames, sizeof(float) * (LOUDNESS_TAPS - 1) );
+    return top;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: loudness_process()
+// desc: one pass through the filters: K-weighted energy into slices, and
+//       plain energy into the rms, whose ballistics step once per slice.
+//       the peaks hold with a decay. the windows are summed again once per
+//       call, from the slices
+//-----------------------------------------------------------------------------
+void loudness_process( LoudnessMeter * m, const float * in, long frames )
+{
+    if( frames > m->maxFrames )
+        frames = m->maxFrames;
+    float peak = 0;
+    for( long i = 0; i < frames; i++ )
+    {
+        float x = in[i];
+        double k = biquad( &m->highpass, biquad( &m->shelf, x ) );
+        m->sliceSum += k * k;
+        m->sliceSquares += x * x;
+        float a = fabsf( x );
+        peak = a > peak ? a : peak;
+        if( ++m->sliceFill < m->sliceFrames )
+            continue;
+
+        m->slices[m->slicePos] = m->sliceSum;
+        m->slicePos = (m->slicePos + 1) % m->numSlices;
+        if( m->slicesSeen < m->numSlices )
+            m->slicesSeen++;
+        float sq = (float)(m->sliceSquares / m->sliceFrames);
+        m->meanSquare += (sq > m->meanSquare ? m->attack : m->release) * (sq - m->meanSquare);
+        m->sliceSum = m->sliceSquares = 0;
+        m->sliceFill = 0;
+    }
+
+    float decay = powf( m->peakRelease, (float)frames );
+    m->peak = fmaxf( m->peak * decay, peak );
+    m->truePeak = fmaxf( m->truePeak * decay, truePeak( m, in, frames ) );
+    m->rms = sqrtf( m->meanSquare );
+    m->momentary = windowLoudness( m, m->momentarySlices );
+    m->shortTerm = windowLoudness( m, m->numSlices );
+}
+
+float loudness_amplitude( float lufs )
+{
+    return lufs <= LOUDNESS_FLOOR ? 0 : powf( 10, lufs / 20 );
+}
@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - loudness.h
+// desc: streaming loudness meter, after ITU-R BS.1770 / EBU R 128: a
+//       K-weighting biquad pair feeds 10 ms slices of energy, summed over
+//       the last 400 ms (momentary) and 3 s (short-term) for LUFS; beside
+//       it a 4x oversampled true peak, the sample peak and an rms with
+//       attack/release ballistics (per slice). a hop costs the same however
+//       long the windows are: one pass of the filters, one of the true
+//       peak interpolator per phase (budget: see analysis.h)
+//-----------------------------------------------------------------------------
+#ifndef __APB_LOUDNESS_H__
+#define __APB_LOUDNESS_H__
+
+#include "arena.h"
+
+// the quietest loudness reported, LUFS (R 128's absolute gate)
+#define LOUDNESS_FLOOR -70.0f
+// true peak interpolator: phases (the oversampling) and taps per phase
+#define LOUDNESS_OVERSAMPLE 4
+#define LOUDNESS_TAPS 12
+
+struct Biquad
+{
+    double b0, b1, b2, a1, a2;
+    double z1, z2;                  // transposed direct form II state
+};
+
+struct LoudnessMeter
+{
+    Biquad shelf;                   // K-weighting, stage 1
+    Biquad highpass;                // stage 2
+    long sliceFrames;               // samples per 10 ms slice
+    long sliceFill;                 // samples in the current one
+    double sliceSum;                // its K-weighted energy so far
+    double * slices;                // energy per finished slice, a ring
+    long numSlices;                 // ring size: short-term window
+    long momentarySlices;
+    long slicePos;                  // next slot to write
+    long slicesSeen;                // finished so far, up to numSlices
+    double sliceSquares;            // unweighted energy of the current slice
+    float phase[LOUDNESS_OVERSAMPLE - 1][LOUDNESS_TAPS]; // interpolator, phase 0 is the sample
+    float * history;                // LOUDNESS_TAPS - 1 samples of context, then the block
+    long maxFrames;
+    float attack;                   // per slice ballistics of the rms
+    float release;
+    float peakRelease;              // per sample decay of the held peaks
+    float meanSquare;
+    float momentary;                // LUFS, >= LOUDNESS_FLOOR
+    float shortTerm;
+    float rms;                      // linear, full scale sine = 0.707
+    float peak;                     // held sample peak, linear
+    float truePeak;                 // held true peak, linear
+};
+
+// arena bytes for loudness_init() with this block size (the slices are
+// counted in time, so the rate doesn't matter)
+size_t loudness_size( long blockFrames );
+void loudness_init( LoudnessMeter * m, Arena * arena, long blockFrames, double srate );
+// take in frames (at most blockFrames) new samples and update every
+// reading. no allocation
+void loudness_process( LoudnessMeter * m, const float * in, long frames );
+// LUFS back to a linear amplitude: the rms of a 1 kHz sine that loud
+float loudness_amplitude( float lufs );
+
+
+#endif
@@ -0,0 +1,356 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - netfeed.cpp
+// desc: udp/multicast publisher and subscriber for feature frames
+//-----------------------------------------------------------------------------
+#include "netfeed.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// "/apb/features" padded to 4 bytes, then the ",b" type tag
+#define OSC_HEADER_SIZE 20
+// receive buffer, enough to ride out a few stalled render frames
+#define RCVBUF_BYTES (1 << 20)
+
+// publisher counters are bumped by the analysis thread and read by render
+#define LOAD(x) __atomic_load_n( &(x), __ATOMIC_RELAXED )
+#define STORE(x, v) __atomic_store_n( &(x), (v), __ATOMIC_RELAXED )
+#define BUMP(x) STORE( x, LOAD( x ) + 1 )
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_clock()
+// desc: see header
+//-----------------------------------------------------------------------------
+double netfeed_clock()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_REALTIME, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: parseSpec()
+// desc: "<host>:<port>[@<interface address>]" into addresses
+//-----------------------------------------------------------------------------
+static bool parseSpec( const char * spec, struct sockaddr_in * addr, struct in_addr * iface )
+{
+    char host[256];
+    const char * colon = strrchr( spec, ':' );
+    if( !colon || colon == spec || (size_t)(colon - spec) >= sizeof(host) )
+        return false;
+    memcpy( host, spec, colon - spec );
+    host[colon - spec] = '\0';
+
+    char * end;
+    long port = strtol( colon + 1, &end, 10 );
+    if( end == colon + 1 || port <= 0 || port > 65535 )
+        return false;
+
+    iface->s_addr = htonl( INADDR_ANY );
+    if( *end == '@' )
+    {
+        if( inet_pton( AF_INET, end + 1, iface ) != 1 )
+            return false;
+    }
+    else if( *end )
+        return false;
+
+    struct addrinfo hints, * res;
+    memset( &hints, 0, sizeof(hints) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if( getaddrinfo( host, NULL, &hints, &res ) != 0 )
+        return false;
+    memcpy( addr, res->ai_addr, sizeof(*addr) );
+    freeaddrinfo( res );
+    addr->sin_port = htons( (uint16_t)port );
+    return true;
+}
+
+static bool isMulticast( const struct sockaddr_in * addr )
+{
+    return IN_MULTICAST( ntohl( addr->sin_addr.s_addr ) );
+}
+
+static bool fail( NetFeed * feed, const char * spec, const char * what )
+{
+    fprintf( stderr, "netfeed: %s: %s: %s\n", spec, what, strerror( errno ) );
+    if( feed->fd >= 0 )
+        close( feed->fd );
+    feed->fd = -1;
+    return false;
+}
+
+static void reset( NetFeed * feed )
+{
+    memset( feed, 0, offsetof( NetFeed, packet ) );
+    feed->fd = -1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_publish_open()
+// desc: multicast goes out with ttl 1 (this subnet) and loops back, so
+//       subscribers on the publishing host see it too
+//-----------------------------------------------------------------------------
+bool netfeed_publish_open( NetFeed * feed, const char * spec, bool osc )
+{
+    struct in_addr iface;
+    reset( feed );
+    feed->osc = osc;
+    if( !parseSpec( spec, &feed->addr, &iface ) )
+    {
+        fprintf( stderr, "netfeed: %s: expected <host>:<port>[@<interface address>]\n", spec );
+        return false;
+    }
+
+    feed->fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( feed->fd < 0 )
+        return fail( feed, spec, "socket" );
+
+    if( isMulticast( &feed->addr ) )
+    {
+        unsigned char ttl = 1, loop = 1;
+        setsockopt( feed->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl) );
+        setsockopt( feed->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop) );
+        if( iface.s_addr != htonl( INADDR_ANY ) &&
+            setsockopt( feed->fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface) ) < 0 )
+            return fail( feed, spec, "IP_MULTICAST_IF" );
+    }
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_subscribe_open()
+// desc: bind the port (shared, so several render nodes can run on one
+//       host) and join the group if it is one
+//-----------------------------------------------------------------------------
+bool netfeed_subscribe_open( NetFeed * feed, const char * spec )
+{
+    struct in_addr iface;
+    reset( feed );
+    if( !parseSpec( spec, &feed->addr, &iface ) )
+    {
+        fprintf( stderr, "netfeed: %s: expected <host>:<port>[@<interface address>]\n", spec );
+        return false;
+    }
+
+    feed->fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( feed->fd < 0 )
+        return fail( feed, spec, "socket" );
+
+    int on = 1, rcvbuf = RCVBUF_BYTES;
+    setsockopt( feed->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+#ifdef SO_REUSEPORT
+    setsockopt( feed->fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on) );
+#endif
+    setsockopt( feed->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf) );
+
+    bool multicast = isMulticast( &feed->addr );
+    struct sockaddr_in local = feed->addr;
+    if( multicast )
+        local.sin_addr.s_addr = htonl( INADDR_ANY );
+    if( bind( feed->fd, (struct sockaddr *)&local, sizeof(local) ) < 0 )
+        return fail( feed, spec, "bind" );
+
+    if( multicast )
+    {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = feed->addr.sin_addr;
+        mreq.imr_interface = iface;
+        if( setsockopt( feed->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq) ) < 0 )
+            return fail( feed, spec, "joining the group (no multicast route? try @127.0.0.1)" );
+    }
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_publish()
+// desc: analysis thread; a full socket buffer drops the frame
+//-----------------------------------------------------------------------------
+bool netfeed_publish( NetFeed * feed, const FeatureFrame * frame )
+{
+    unsigned char * p = feed->packet;
+    if( feed->osc )
+    {
+        // address, type tag, then the blob's big-endian size
+        memset( p, 0, OSC_HEADER_SIZE );
+        strcpy( (char *)p, NETFEED_OSC_ADDRESS );
+        strcpy( (char *)p + 16, ",b" );
+        p += OSC_HEADER_SIZE;
+        uint32_t size = htonl( FEATURE_WIRE_SIZE );
+        memcpy( p, &size, 4 );
+        p += 4;
+    }
+    feature_pack( frame, p );
+    // blobs pad to 4 bytes; the frame is already a multiple of 4
+    size_t length = (p - feed->packet) + FEATURE_WIRE_SIZE;
+
+    ssize_t sent = sendto( feed->fd, feed->packet, length, MSG_DONTWAIT,
+                           (struct sockaddr *)&feed->addr, sizeof(feed->addr) );
+    if( sent != (ssize_t)length )
+    {
+        BUMP( feed->stats.sendErrors );
+        return false;
+    }
+    BUMP( feed->stats.sent );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: acceptFrame()
+// desc: sequence bookkeeping for one parsed frame; true if it's news
+//-----------------------------------------------------------------------------
+static bool acceptFrame( NetFeed * feed, const FeatureFrame * f )
+{
+    NetFeedStats * s = &feed->stats;
+    if( feed->haveSeq && f->seq != feed->nextSeq )
+    {
+        int32_t ahead = (int32_t)(f->seq - feed->nextSeq);
+        if( ahead > 0 )
+            s->lost += ahead;
+        else if( f->time > feed->lastTime )
+            // older seq but newer capture: the publisher started over
+            s->restarts++;
+        else
+        {
+            s->stale++;
+            return false;
+        }
+    }
+    feed->haveSeq = true;
+    feed->nextSeq = f->seq + 1;
+    feed->lastTime = f->time;
+    s->received++;
+
+    // across hosts this is only as good as their clock sync
+    double latency = netfeed_clock() - f->time;
+    s->latency[health_bucket( latency )]++;
+    if( latency > s->latencyMax )
+        s->latencyMax = latency;
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_receive()
+// desc: render thread, once per frame
+//-----------------------------------------------------------------------------
+int netfeed_receive( NetFeed * feed, FeatureFrame * frame )
+{
+    int fresh = 0;
+    for( ;; )
+    {
+        ssize_t n = recv( feed->fd, feed->packet, sizeof(feed->packet), MSG_DONTWAIT );
+        if( n < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            // EAGAIN: drained
+            break;
+        }
+
+        const unsigned char * p = feed->packet;
+        size_t length = n;
+        if( length > 0 && p[0] == '/' )
+        {
+            // OSC: our address, one blob
+            uint32_t size;
+            if( length < OSC_HEADER_SIZE + 4 ||
+                memcmp( p, NETFEED_OSC_ADDRESS "\0\0", 16 ) || memcmp( p + 16, ",b\0", 4 ) )
+            {
+                feed->stats.malformed++;
+                continue;
+            }
+            memcpy( &size, p + OSC_HEADER_SIZE, 4 );
+            size = ntohl( size );
+            p += OSC_HEADER_SIZE + 4;
+            length -= OSC_HEADER_SIZE + 4;
+            if( size < length )
+                length = size;
+        }
+
+        // decode aside; only news replaces the caller's frame
+        FeatureFrame f;
+        if( !feature_unpack( p, length, &f ) )
+        {
+            feed->stats.malformed++;
+            continue;
+        }
+        if( acceptFrame( feed, &f ) )
+        {
+            *frame = f;
+            fresh++;
+        }
+    }
+    return fresh;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_stats() / netfeed_format()
+// desc: copy out, summarize
+//-----------------------------------------------------------------------------
+void netfeed_stats( NetFeed * feed, NetFeedStats * out )
+{
+    *out = feed->stats;
+    out->sent = LOAD( feed->stats.sent );
+    out->sendErrors = LOAD( feed->stats.sendErrors );
+}
+
+void netfeed_format( const NetFeedStats * s, bool subscriber, char * buf, size_t size )
+{
+    if( !subscriber )
+    {
+        snprintf( buf, size, "sent %lu frames, %lu send errors", s->sent, s->sendErrors );
+        return;
+    }
+    unsigned long expected = s->received + s->lost;
+    snprintf( buf, size,
+              "rx %lu, lost %lu (%.1f%%), stale %lu, latency p50 <%.1fms p99 <%.1fms max %.1fms",
+              s->received, s->lost, expected ? 100.0 * s->lost / expected : 0.0, s->stale,
+              health_percentile( s->latency, 0.5 ) * 1000,
+              health_percentile( s->latency, 0.99 ) * 1000, s->latencyMax * 1000 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: netfeed_close()
+// desc: leaves the group too
+//-----------------------------------------------------------------------------
+void netfeed_close( NetFeed * feed )
+{
+    if( feed->fd >= 0 )
+        close( feed->fd );
+    feed->fd = -1;
+}
@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - netfeed.h
+// desc: feature frames over UDP. a publisher sends one datagram per frame
+//       to a multicast group (or a unicast address), raw or wrapped as an
+//       OSC message; subscribers drain their socket once per render frame,
+//       keep the newest frame and count what was lost, late and how long
+//       frames took from capture to receipt
+//-----------------------------------------------------------------------------
+#ifndef __APB_NETFEED_H__
+#define __APB_NETFEED_H__
+
+#include "feature.h"
+#include "health.h"
+#include <netinet/in.h>
+
+// OSC address for wrapped frames; the argument is one blob
+#define NETFEED_OSC_ADDRESS "/apb/features"
+// largest datagram we build or accept
+#define NETFEED_MAX_PACKET 2048
+
+struct NetFeedStats
+{
+    unsigned long sent;                         // publisher
+    unsigned long sendErrors;
+    unsigned long received;                     // subscriber: frames taken
+    unsigned long lost;                         // gaps in seq
+    unsigned long stale;                        // late or duplicate, dropped
+    unsigned long malformed;
+    unsigned long restarts;                     // publisher started over
+    unsigned long latency[HEALTH_BUCKETS];      // capture to receipt
+    double latencyMax;                          // seconds
+};
+
+struct NetFeed
+{
+    int fd;
+    struct sockaddr_in addr;
+    bool osc;
+    bool haveSeq;
+    uint32_t nextSeq;
+    double lastTime;
+    NetFeedStats stats;
+    unsigned char packet[NETFEED_MAX_PACKET];   // scratch, so no allocation
+};
+
+// addresses are "<host>:<port>[@<interface address>]", e.g.
+// 239.255.42.99:9000 or 239.255.42.99:9000@127.0.0.1 (multicast over
+// loopback) or 127.0.0.1:9000 (plain unicast). false (and a message on
+// stderr) if the socket can't be set up
+bool netfeed_publish_open( NetFeed * feed, const char * spec, bool osc );
+bool netfeed_subscribe_open( NetFeed * feed, const char * spec );
+// one frame, one datagram; never blocks
+bool netfeed_publish( NetFeed * feed, const FeatureFrame * frame );
+// drain the socket without blocking; returns how many new frames arrived,
+// the newest of them in *frame (untouched if none)
+int netfeed_receive( NetFeed * feed, FeatureFrame * frame );
+// copy the counters (publisher counters are safe from any thread)
+void netfeed_stats( NetFeed * feed, NetFeedStats * out );
+// one-line summary for the log or overlay
+void netfeed_format( const NetFeedStats * stats, bool subscriber, char * buf, size_t size );
+void netfeed_close( NetFeed * feed );
+// wall clock seconds; frames are stamped with it, so nodes need synced clocks
+double netfeed_clock();
+
+
+#endif
@@ -0,0 +1,240 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - pitch.cpp
+// desc: pitch tracking (after McLeod & Wyvill, "A smarter way to find
+//       pitch")
+//-----------------------------------------------------------------------------
+#include "pitch.h"
+#include "dsp.h"
+#include <math.h>
+#include <string.h>
+
+// the decimated rate stays at or above this
+#define MIN_RATE 8000.0
+// decimation lowpass cutoff, as a fraction of the decimated nyquist, and
+// its length in taps per unit of decimation
+#define DECIMATION_CUTOFF 0.6
+#define TAPS_PER_FACTOR 16
+// the first key maximum within this fraction of the highest one wins
+#define PEAK_THRESHOLD 0.9f
+// voiced needs this clarity, and this rms over the window
+#define VOICED_CLARITY 0.8f
+#define SILENCE 0.005f
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: factorFor()
+// desc: the largest power of 2 that keeps the rate above MIN_RATE
+//-----------------------------------------------------------------------------
+static int factorFor( double srate )
+{
+    int factor = 1;
+    while( srate / (2 * factor) >= MIN_RATE )
+        factor *= 2;
+    return factor;
+}
+
+size_t pitch_size( long blockFrames, double srate )
+{
+    int factor = factorFor( srate );
+    int taps = TAPS_PER_FACTOR * factor + 1;
+    return arena_size( sizeof(float) * taps ) + arena_size( sizeof(float) * 2 * taps ) +
+        arena_size( sizeof(float) * PITCH_FFT ) +
+        arena_size( sizeof(float) * (blockFrames / factor + 1) ) +
+        arena_size( sizeof(float) * PITCH_FFT ) +
+        arena_size( sizeof(float) * (PITCH_FFT / 3 + 2) ) +
+        arena_size( sizeof(float) * (PITCH_FFT + 1) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: pitch_init()
+// desc: the lowpass is a hann windowed sinc, unity gain at dc
+//-----------------------------------------------------------------------------
+void pitch_init( PitchTracker * p, Arena * arena, long blockFrames, double srate )
+{
+    memset( p, 0, sizeof(*p) );
+    p->factor = factorFor( srate );
+    p->rate = srate / p->factor;
+    p->minLag = (long)floor( p->rate / PITCH_FMAX );
+    p->maxLag = (long)ceil( p->rate / PITCH_FMIN );
+    // at least two of the longest periods in the window
+    if( p->maxLag > PITCH_FFT / 3 ) p->maxLag = PITCH_FFT / 3;
+    if( p->minLag < 2 ) p->minLag = 2;
+    p->window = PITCH_FFT - p->maxLag - 1;
+
+    p->taps = TAPS_PER_FACTOR * p->factor + 1;
+    p->fir = arena_array<float>( arena, p->taps );
+    p->delay = arena_array<float>( arena, 2 * p->taps );
+    p->history = arena_array<float>( arena, p->window );
+    p->scratch = arena_array<float>( arena, blockFrames / p->factor + 1 );
+    p->fftBuf = arena_array<float>( arena, PITCH_FFT );
+    p->nsdf = arena_array<float>( arena, p->maxLag + 2 );
+    p->energy = arena_array<float>( arena, p->window + 1 );
+
+    const int mid = p->taps / 2;
+    double fc = DECIMATION_CUTOFF * 0.5 / p->factor;
+    float sum = 0;
+    for( int i = 0; i < p->taps; i++ )
+    {
+        double x = 2 * M_PI * fc * (i - mid);
+        double w = 0.5 - 0.5 * cos( 2 * M_PI * (i + 1) / (p->taps + 1) );
+        p->fir[i] = (float)((i == mid ? 1.0 : sin( x ) / x) * w);
+        sum += p->fir[i];
+    }
+    for( int i = 0; i < p->taps; i++ )
+        p->fir[i] /= sum;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: decimate()
+// desc: lowpass and keep every factor-th sample, carrying state across
+//       hops; returns how many came out
+//-----------------------------------------------------------------------------
+static long decimate( PitchTracker * p, const float * in, long n )
+{
+    long m = 0;
+    for( long i = 0; i < n; i++ )
+    {
+        p->delay[p->delayPos] = p->delay[p->delayPos + p->taps] = in[i];
+        p->delayPos = (p->delayPos + 1) % p->taps;
+        if( p->phase > 0 )
+        {
+            p->phase--;
+            continue;
+        }
+        p->phase = p->factor - 1;
+        const float * d = p->delay + p->delayPos;
+        float acc = 0;
+        for( int k = 0; k < p->taps; k++ )
+            acc += p->fir[k] * d[k];
+        p->scratch[m++] = acc;
+    }
+    return m;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: correlate()
+// desc: fftBuf[t] = r(t), the window's autocorrelation at lag t (for
+//       t <= maxLag + 1, where the zero padding keeps it from wrapping):
+//       power spectrum, transformed back. rfft keeps dc and nyquist in the
+//       first two slots, both real. the inverse leaves a constant gain;
+//       r(0) is the window's energy, which sets it right
+//-----------------------------------------------------------------------------
+static void correlate( PitchTracker * p, float energy )
+{
+    float * x = p->fftBuf;
+    memcpy( x, p->history, sizeof(float) * p->window );
+    memset( x + p->window, 0, sizeof(float) * (PITCH_FFT - p->window) );
+    dsp_rfft( x, PITCH_FFT / 2, FFT_FORWARD );
+    x[0] *= x[0];
+    x[1] *= x[1];
+    for( long k = 2; k < PITCH_FFT; k += 2 )
+    {
+        x[k] = x[k] * x[k] + x[k + 1] * x[k + 1];
+        x[k + 1] = 0;
+    }
+    dsp_rfft( x, PITCH_FFT / 2, FFT_INVERSE );
+    float gain = x[0] > 0 ? energy / x[0] : 0;
+    for( long t = 0; t <= p->maxLag + 1; t++ )
+        x[t] *= gain;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: pitch_process()
+// desc: nsdf(t) = 2 r(t) / m(t), m(t) being the energy of the two
+//       overlapping parts (from running sums). the candidates are the
+//       highest points of each positive lobe after the first zero
+//       crossing; the earliest one close to the best is the period, which
+//       keeps octave errors down. a parabola through it refines the lag
+//-----------------------------------------------------------------------------
+void pitch_process( PitchTracker * p, const float * block, long frames )
+{
+    long n = decimate( p, block, frames );
+    long w = p->window;
+    if( n >= w )
+        memcpy( p->history, p->scratch + n - w, sizeof(float) * w );
+    else
+    {
+        memmove( p->history, p->history + n, sizeof(float) * (w - n) );
+        memcpy( p->history + w - n, p->scratch, sizeof(float) * n );
+    }
+
+    const float * x = p->history;
+    float * c = p->energy;
+    c[0] = 0;
+    for( long j = 0; j < w; j++ )
+        c[j + 1] = c[j] + x[j] * x[j];
+    float total = c[w];
+
+    p->f0 = 0;
+    p->clarity = 0;
+    p->voiced = false;
+    if( total <= 0 )
+        return;
+    correlate( p, total );
+    const float * r = p->fftBuf;
+
+    float * nsdf = p->nsdf;
+    long count = p->maxLag + 2;
+    for( long t = 0; t < count; t++ )
+    {
+        float m = (total - c[t]) + c[w - t];
+        nsdf[t] = m > 0 ? 2 * r[t] / m : 0;
+    }
+
+    // key maxima, one per positive lobe past lag 0's, and in range: the
+    // first pass finds the highest, the second the earliest close to it
+    float highest = 0;
+    long best = -1;
+    for( int pass = 0; pass < 2 && best < 0; pass++ )
+    {
+        long i = 1;
+        while( i < count - 1 && nsdf[i] > 0 )
+            i++;
+        while( i < count - 1 )
+        {
+            while( i < count - 1 && nsdf[i] <= 0 )
+                i++;
+            long top = -1;
+            for( ; i < count - 1 && nsdf[i] > 0; i++ )
+                if( i >= p->minLag && (top < 0 || nsdf[i] > nsdf[top]) )
+                    top = i;
+            if( top < 0 )
+                continue;
+            if( pass == 0 )
+                highest = fmaxf( highest, nsdf[top] );
+            else if( nsdf[top] >= PEAK_THRESHOLD * highest )
+            {
+                best = top;
+                break;
+            }
+        }
+        if( highest <= 0 )
+            break;
+    }
+    if( best < 0 )
+        return;
+
+    float a = nsdf[best - 1], b = nsdf[best], d = nsdf[best + 1];
+    float denom = a - 2 * b + d;
+    float shift = denom < 0 ? 0.5f * (a - d) / denom : 0;
+    float lag = best + shift;
+    float peak = b - 0.25f * (a - d) * shift;
+    p->f0 = (float)(p->rate / lag);
+    p->clarity = fminf( fmaxf( peak, 0 ), 1 );
+    p->voiced = p->clarity >= VOICED_CLARITY &&
+        sqrtf( total / w ) >= SILENCE;
+}
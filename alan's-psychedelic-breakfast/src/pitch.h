@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - pitch.h
+// desc: monophonic fundamental frequency, by McLeod's normalized square
+//       difference function (the "MPM"; YIN's difference function is the
+//       same sums, inverted). the autocorrelation under it comes from one
+//       forward and one inverse rfft of the zero padded window, O(n log n),
+//       and the window runs on the input decimated to around 11 kHz, so a
+//       fixed size fft spans ~65 ms (2.5 periods of a bass's low E). every
+//       hop costs the same: the decimation of one block, two PITCH_FFT
+//       point ffts and one scan of the lag range (budget: see analysis.h)
+//-----------------------------------------------------------------------------
+#ifndef __APB_PITCH_H__
+#define __APB_PITCH_H__
+
+#include "arena.h"
+
+// fft size; the window is this less the longest lag, so the
+// autocorrelation doesn't wrap
+#define PITCH_FFT 1024
+// the lag range, in hz
+#define PITCH_FMIN 40.0
+#define PITCH_FMAX 1500.0
+
+struct PitchTracker
+{
+    int factor;                     // decimation
+    double rate;                    // srate / factor
+    long minLag;
+    long maxLag;
+    long window;                    // samples analyzed, at the decimated rate
+    int taps;                       // of the decimation lowpass
+    float * fir;
+    float * delay;                  // decimator input, 2 * taps (written twice)
+    int delayPos;
+    int phase;                      // input samples until the decimator keeps one
+    float * history;                // last window decimated samples
+    float * scratch;                // decimator output, one block's worth
+    float * fftBuf;                 // PITCH_FFT
+    float * nsdf;                   // maxLag + 2
+    float * energy;                 // running sums of squares, window + 1
+    float f0;                       // hz of the best candidate, 0 = none
+    float clarity;                  // its normalized correlation, [0, 1]
+    bool voiced;                    // clear and loud enough to trust
+};
+
+// arena bytes for pitch_init() with these settings
+size_t pitch_size( long blockFrames, double srate );
+// hops of at most blockFrames at srate
+void pitch_init( PitchTracker * p, Arena * arena, long blockFrames, double srate );
+// append one hop and re-estimate f0, clarity and voiced. no allocation
+void pitch_process( PitchTracker * p, const float * block, long frames );
+
+
+#endif
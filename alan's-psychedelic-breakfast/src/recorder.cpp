@@ -0,0 +1,353 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - recorder.cpp
+// desc: session recorder and its writer thread
+//-----------------------------------------------------------------------------
+#include "recorder.h"
+#include "threads.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// O_DIRECT transfer unit: offsets, lengths and the staging buffer
+#define RECORD_ALIGN 4096
+// writer staging, and how full it gets before a write
+#define BATCH_BYTES (4 << 20)
+#define FLUSH_BYTES (1 << 20)
+// a quiet stream still reaches the disk this often, seconds
+#define FLUSH_INTERVAL 0.5
+// queue depth, seconds of blocks (features come at the same rate)
+#define QUEUE_SECONDS 2.0
+#define FRAME_SLOTS 256
+// how long the writer naps with every queue empty
+#define POLL_NS 2000000
+
+static inline unsigned long pad8( unsigned long bytes )
+{
+    return (bytes + 7) & ~7UL;
+}
+
+static unsigned long pow2AtLeast( double n )
+{
+    unsigned long count = 16;
+    while( count < n )
+        count *= 2;
+    return count;
+}
+
+static double monotonic()
+{
+    struct timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: reserve() / publish()
+// desc: producer side of a queue: a free slot to fill, or NULL (and one
+//       more drop) if the writer hasn't freed any; then hand it over
+//-----------------------------------------------------------------------------
+static unsigned char * reserve( RecordQueue * q, uint32_t type, uint32_t bytes, double time )
+{
+    unsigned long head = __atomic_load_n( &q->head, __ATOMIC_RELAXED );
+    unsigned long tail = __atomic_load_n( &q->tail, __ATOMIC_ACQUIRE );
+    if( head - tail >= q->count )
+    {
+        __atomic_fetch_add( &q->dropped, 1, __ATOMIC_RELAXED );
+        return NULL;
+    }
+    unsigned char * slot = q->slots + (head & (q->count - 1)) * q->slotBytes;
+    RecordHeader * h = (RecordHeader *)slot;
+    h->type = type;
+    h->bytes = bytes;
+    h->time = time;
+    return slot + sizeof(RecordHeader);
+}
+
+static void publish( RecordQueue * q )
+{
+    unsigned long head = __atomic_load_n( &q->head, __ATOMIC_RELAXED );
+    __atomic_store_n( &q->head, head + 1, __ATOMIC_RELEASE );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: flush()
+// desc: write out the staged records. O_DIRECT takes whole aligned blocks,
+//       so the tail waits for more; the final flush pads it to a block
+//       and trims the padding off the file again. a failed write loses
+//       its records (counted) rather than backing up the queues
+//-----------------------------------------------------------------------------
+static void flush( Recorder * r, bool final )
+{
+    unsigned long n = r->batchFill, logical = r->batchFill;
+    if( r->direct )
+    {
+        if( final )
+        {
+            n = (n + RECORD_ALIGN - 1) & ~(unsigned long)(RECORD_ALIGN - 1);
+            memset( r->batch + r->batchFill, 0, n - r->batchFill );
+        }
+        else
+            n = logical = n & ~(unsigned long)(RECORD_ALIGN - 1);
+    }
+    if( !n )
+        return;
+
+    unsigned long done = 0;
+    while( done < n )
+    {
+        ssize_t w = pwrite( r->fd, r->batch + done, n - done, (off_t)(r->diskBytes + done) );
+        if( w < 0 && errno == EINTR )
+            continue;
+        if( w <= 0 )
+        {
+            __atomic_fetch_add( &r->stats.writeErrors, 1, __ATOMIC_RELAXED );
+            break;
+        }
+        done += w;
+    }
+
+    r->diskBytes += logical;
+    r->batchFill -= logical;
+    memmove( r->batch, r->batch + logical, r->batchFill );
+    if( final && r->direct && ftruncate( r->fd, (off_t)r->diskBytes ) < 0 )
+        __atomic_fetch_add( &r->stats.writeErrors, 1, __ATOMIC_RELAXED );
+    __atomic_store_n( &r->stats.bytes, r->diskBytes, __ATOMIC_RELAXED );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: drain()
+// desc: move every waiting record into the batch, flushing whenever it
+//       would overflow; returns how many moved
+//-----------------------------------------------------------------------------
+static unsigned long drain( Recorder * r )
+{
+    unsigned long moved = 0;
+    for( int s = 0; s < RECORD_STREAMS; s++ )
+    {
+        RecordQueue * q = &r->queues[s];
+        unsigned long tail = __atomic_load_n( &q->tail, __ATOMIC_RELAXED );
+        unsigned long head = __atomic_load_n( &q->head, __ATOMIC_ACQUIRE );
+        for( ; tail != head; tail++ )
+        {
+            const unsigned char * slot = q->slots + (tail & (q->count - 1)) * q->slotBytes;
+            unsigned long bytes = sizeof(RecordHeader) + pad8( ((const RecordHeader *)slot)->bytes );
+            if( r->batchFill + bytes > BATCH_BYTES - RECORD_ALIGN )
+                flush( r, false );
+            memcpy( r->batch + r->batchFill, slot, bytes );
+            r->batchFill += bytes;
+            __atomic_store_n( &q->tail, tail + 1, __ATOMIC_RELEASE );
+            __atomic_fetch_add( &r->stats.records[s], 1, __ATOMIC_RELAXED );
+            moved++;
+        }
+    }
+    return moved;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: writerThread()
+// desc: drain, write in batches; once stopped and drained, close off with
+//       the drop counts
+//-----------------------------------------------------------------------------
+static void * writerThread( void * arg )
+{
+    Recorder * r = (Recorder *)arg;
+    threads_apply( THREAD_RECORDER );
+    struct timespec nap = { 0, POLL_NS };
+    double lastFlush = monotonic();
+
+    while( true )
+    {
+        bool running = __atomic_load_n( &r->running, __ATOMIC_ACQUIRE );
+        unsigned long moved = drain( r );
+        double now = monotonic();
+        if( r->batchFill >= FLUSH_BYTES || (r->batchFill && now - lastFlush >= FLUSH_INTERVAL) )
+        {
+            flush( r, false );
+            lastFlush = now;
+        }
+        if( !moved )
+        {
+            if( !running )
+                break;
+            nanosleep( &nap, NULL );
+        }
+    }
+
+    RecordHeader h = { RECORD_DROPS, 8 * RECORD_STREAMS, 0 };
+    uint64_t drops[RECORD_STREAMS];
+    for( int s = 0; s < RECORD_STREAMS; s++ )
+        drops[s] = __atomic_load_n( &r->queues[s].dropped, __ATOMIC_RELAXED );
+    memcpy( r->batch + r->batchFill, &h, sizeof(h) );
+    memcpy( r->batch + r->batchFill + sizeof(h), drops, sizeof(drops) );
+    r->batchFill += sizeof(h) + sizeof(drops);
+    flush( r, true );
+    return NULL;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: recorder_open()
+// desc: queues from the recorder's arena, sized by the block rate; the
+//       file header goes out with the first batch
+//-----------------------------------------------------------------------------
+bool recorder_open( Recorder * r, const char * path, long blockFrames, double srate,
+                    bool direct )
+{
+    memset( r, 0, sizeof(*r) );
+    r->blockFrames = blockFrames;
+    unsigned long blocks = pow2AtLeast( QUEUE_SECONDS * srate / blockFrames );
+    unsigned long payload[RECORD_STREAMS] = { sizeof(float) * (unsigned long)blockFrames,
+                                              FEATURE_WIRE_SIZE, sizeof(RecordFrame) };
+    unsigned long count[RECORD_STREAMS] = { blocks, blocks, FRAME_SLOTS };
+    size_t bytes = 0;
+    for( int s = 0; s < RECORD_STREAMS; s++ )
+        bytes += arena_size( count[s] * (sizeof(RecordHeader) + pad8( payload[s] )) );
+    arena_reserve( &r->arena, bytes );
+    for( int s = 0; s < RECORD_STREAMS; s++ )
+    {
+        RecordQueue * q = &r->queues[s];
+        q->count = count[s];
+        q->slotBytes = sizeof(RecordHeader) + pad8( payload[s] );
+        q->slots = (unsigned char *)arena_alloc( &r->arena, q->count * q->slotBytes );
+    }
+
+    r->fd = -1;
+    if( direct )
+    {
+        r->fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644 );
+        r->direct = r->fd >= 0;
+        if( !r->direct )
+            fprintf( stderr, "recorder: %s: no O_DIRECT here (%s), buffered instead\n",
+                     path, strerror( errno ) );
+    }
+    if( r->fd < 0 )
+        r->fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( r->fd < 0 || posix_memalign( (void **)&r->batch, RECORD_ALIGN, BATCH_BYTES ) )
+    {
+        fprintf( stderr, "recorder: %s: %s\n", path, strerror( errno ) );
+        if( r->fd >= 0 )
+            close( r->fd );
+        arena_free( &r->arena );
+        return false;
+    }
+
+    RecordFileHeader fh = { RECORD_MAGIC, RECORD_VERSION, FEATURE_VERSION,
+                            (uint32_t)blockFrames, srate };
+    memcpy( r->batch, &fh, sizeof(fh) );
+    r->batchFill = sizeof(fh);
+    r->running = 1;
+    if( pthread_create( &r->thread, NULL, writerThread, r ) )
+    {
+        fprintf( stderr, "recorder: can't start the writer thread\n" );
+        close( r->fd );
+        free( r->batch );
+        arena_free( &r->arena );
+        return false;
+    }
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: recorder_audio() / recorder_feature() / recorder_frame()
+// desc: producers; a full queue drops the record
+//-----------------------------------------------------------------------------
+void recorder_audio( Recorder * r, const float * block, long frames, double captured )
+{
+    if( frames > r->blockFrames )
+        frames = r->blockFrames;
+    unsigned char * p = reserve( &r->queues[RECORD_AUDIO], RECORD_AUDIO,
+                                 sizeof(float) * frames, captured );
+    if( !p )
+        return;
+    memcpy( p, block, sizeof(float) * frames );
+    publish( &r->queues[RECORD_AUDIO] );
+}
+
+void recorder_feature( Recorder * r, const FeatureFrame * frame )
+{
+    unsigned char * p = reserve( &r->queues[RECORD_FEATURE], RECORD_FEATURE,
+                                 FEATURE_WIRE_SIZE, frame->time );
+    if( !p )
+        return;
+    feature_pack( frame, p );
+    publish( &r->queues[RECORD_FEATURE] );
+}
+
+void recorder_frame( Recorder * r, long number, double dt, double streamTime, double now )
+{
+    unsigned char * p = reserve( &r->queues[RECORD_FRAME], RECORD_FRAME,
+                                 sizeof(RecordFrame), now );
+    if( !p )
+        return;
+    RecordFrame f = { number, dt, streamTime };
+    memcpy( p, &f, sizeof(f) );
+    publish( &r->queues[RECORD_FRAME] );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: recorder_stats() / recorder_format()
+// desc: what the writer got through and what the producers dropped
+//-----------------------------------------------------------------------------
+void recorder_stats( Recorder * r, RecorderStats * out )
+{
+    for( int s = 0; s < RECORD_STREAMS; s++ )
+    {
+        out->records[s] = __atomic_load_n( &r->stats.records[s], __ATOMIC_RELAXED );
+        out->dropped[s] = __atomic_load_n( &r->queues[s].dropped, __ATOMIC_RELAXED );
+    }
+    out->bytes = __atomic_load_n( &r->stats.bytes, __ATOMIC_RELAXED );
+    out->writeErrors = __atomic_load_n( &r->stats.writeErrors, __ATOMIC_RELAXED );
+}
+
+void recorder_format( Recorder * r, char * buf, unsigned long size )
+{
+    RecorderStats s;
+    recorder_stats( r, &s );
+    snprintf( buf, size, "%.1f MB%s, dropped %lu blocks / %lu features / %lu frames, %lu errors",
+              s.bytes / 1048576.0, r->direct ? " (direct)" : "", s.dropped[RECORD_AUDIO],
+              s.dropped[RECORD_FEATURE], s.dropped[RECORD_FRAME], s.writeErrors );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: recorder_close()
+// desc: the queues stay allocated: a producer still running (the analysis
+//       thread, at exit) keeps writing into them harmlessly
+//-----------------------------------------------------------------------------
+void recorder_close( Recorder * r )
+{
+    if( !__atomic_load_n( &r->running, __ATOMIC_ACQUIRE ) )
+        return;
+    __atomic_store_n( &r->running, 0, __ATOMIC_RELEASE );
+    pthread_join( r->thread, NULL );
+    close( r->fd );
+    r->fd = -1;
+    free( r->batch );
+    r->batch = NULL;
+}
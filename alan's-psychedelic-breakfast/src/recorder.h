@@ -0,0 +1,110 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - recorder.h
+// desc: session recorder, for replaying a show afterwards: raw sample
+//       blocks from the capture path, feature frames and render frame
+//       timestamps, each from its own producer thread through its own
+//       bounded single-producer queue of fixed slots, to a writer thread
+//       that batches them into large aligned writes (O_DIRECT if asked).
+//       producers copy into a slot or, if the writer has fallen behind,
+//       count the record as dropped; they never wait on the disk
+//-----------------------------------------------------------------------------
+#ifndef __APB_RECORDER_H__
+#define __APB_RECORDER_H__
+
+#include "arena.h"
+#include "feature.h"
+#include <pthread.h>
+#include <stdint.h>
+
+// record types, in the file and as stream indices
+enum RecordType
+{
+    RECORD_AUDIO,                   // float32 samples; time = capture, wall clock
+    RECORD_FEATURE,                 // a wire format frame; time = its capture time
+    RECORD_FRAME,                   // a RecordFrame; time = when it was rendered
+    RECORD_STREAMS,
+    RECORD_DROPS = RECORD_STREAMS   // last record: a uint64 per stream
+};
+
+// file: a RecordFileHeader, then records (a RecordHeader and its payload,
+// padded to 8 bytes), in host byte order; feature frames keep their wire
+// format
+#define RECORD_MAGIC 0x52425041     // "APBR"
+#define RECORD_VERSION 1
+
+struct RecordFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t featureVersion;
+    uint32_t blockFrames;
+    double srate;
+};
+
+struct RecordHeader
+{
+    uint32_t type;
+    uint32_t bytes;                 // payload, before padding
+    double time;
+};
+
+struct RecordFrame
+{
+    int64_t number;
+    double dt;                      // its time step
+    double streamTime;              // audio position, seconds (offline; else 0)
+};
+
+// one producer's queue: count (a power of two) slots of slotBytes
+struct RecordQueue
+{
+    unsigned char * slots;
+    unsigned long count;
+    unsigned long slotBytes;
+    unsigned long head;             // slots written (producer, atomic)
+    unsigned long tail;             // slots taken (writer, atomic)
+    unsigned long dropped;          // records that didn't fit (producer, atomic)
+};
+
+struct RecorderStats
+{
+    unsigned long records[RECORD_STREAMS];  // written to the file
+    unsigned long dropped[RECORD_STREAMS];
+    unsigned long long bytes;
+    unsigned long writeErrors;
+};
+
+struct Recorder
+{
+    Arena arena;
+    RecordQueue queues[RECORD_STREAMS];
+    long blockFrames;
+    int fd;
+    bool direct;                    // O_DIRECT: whole aligned blocks only
+    unsigned char * batch;          // staging for the writer, aligned
+    unsigned long batchFill;
+    unsigned long long diskBytes;   // file offset of batch[0]
+    RecorderStats stats;            // writer's counts (atomic)
+    pthread_t thread;
+    int running;                    // atomic
+};
+
+// open path (truncating it) for blocks of up to blockFrames at srate and
+// start the writer; direct asks for O_DIRECT, falling back to buffered
+// writes where the filesystem won't. false, with a message, on failure
+bool recorder_open( Recorder * r, const char * path, long blockFrames, double srate,
+                    bool direct );
+// producers, one thread each; no allocation, no locks, no waiting
+void recorder_audio( Recorder * r, const float * block, long frames, double captured );
+void recorder_feature( Recorder * r, const FeatureFrame * frame );
+void recorder_frame( Recorder * r, long number, double dt, double streamTime, double now );
+// counts so far (any thread)
+void recorder_stats( Recorder * r, RecorderStats * out );
+// one-line summary for the log or overlay
+void recorder_format( Recorder * r, char * buf, unsigned long size );
+// stop the writer once the queues are drained, append the drop counts
+// and close the file
+void recorder_close( Recorder * r );
+
+
+#endif
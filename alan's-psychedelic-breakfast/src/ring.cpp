@@ -0,0 +1,88 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - ring.cpp
+// desc: spsc sample ring
+//-----------------------------------------------------------------------------
+#include "ring.h"
+#include <string.h>
+
+// each index has one writer; acquire/release order the sample copies
+#define LOAD(x) __atomic_load_n( &(x), __ATOMIC_ACQUIRE )
+#define STORE(x, v) __atomic_store_n( &(x), (v), __ATOMIC_RELEASE )
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ring_init()
+// desc: call before either side runs
+//-----------------------------------------------------------------------------
+void ring_init( SampleRing * ring, float * storage, unsigned long size )
+{
+    ring->data = storage;
+    ring->size = size;
+    ring->head = ring->tail = ring->dropped = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ring_write()
+// desc: producer side
+//-----------------------------------------------------------------------------
+unsigned long ring_write( SampleRing * ring, const float * in, unsigned long n )
+{
+    unsigned long head = ring->head, tail = LOAD( ring->tail );
+    unsigned long space = ring->size - (head - tail);
+    if( n > space )
+    {
+        STORE( ring->dropped, ring->dropped + (n - space) );
+        n = space;
+    }
+
+    // at most two runs: up to the end of storage, then from the start
+    unsigned long at = head & (ring->size - 1);
+    unsigned long first = n < ring->size - at ? n : ring->size - at;
+    memcpy( ring->data + at, in, first * sizeof(float) );
+    memcpy( ring->data, in + first, (n - first) * sizeof(float) );
+
+    STORE( ring->head, head + n );
+    return n;
+}
+
+unsigned long ring_space( SampleRing * ring )
+{
+    return ring->size - (ring->head - LOAD( ring->tail ));
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ring_available() / ring_read()
+// desc: consumer side
+//-----------------------------------------------------------------------------
+unsigned long ring_available( SampleRing * ring )
+{
+    return LOAD( ring->head ) - ring->tail;
+}
+
+bool ring_read( SampleRing * ring, float * out, unsigned long n )
+{
+    unsigned long tail = ring->tail;
+    if( LOAD( ring->head ) - tail < n )
+        return false;
+
+    unsigned long at = tail & (ring->size - 1);
+    unsigned long first = n < ring->size - at ? n : ring->size - at;
+    memcpy( out, ring->data + at, first * sizeof(float) );
+    memcpy( out + first, ring->data, (n - first) * sizeof(float) );
+
+    STORE( ring->tail, tail + n );
+    return true;
+}
+
+unsigned long ring_dropped( SampleRing * ring )
+{
+    return LOAD( ring->dropped );
+}
@@ -0,0 +1,33 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - ring.h
+// desc: single-producer single-consumer sample ring. the audio callback
+//       writes, the analysis thread reads; no locks and no allocation, and
+//       a full ring drops the new samples (counted) rather than blocking
+//-----------------------------------------------------------------------------
+#ifndef __APB_RING_H__
+#define __APB_RING_H__
+
+struct SampleRing
+{
+    float * data;
+    unsigned long size;         // a power of two
+    unsigned long head;         // total written (producer, atomic)
+    unsigned long tail;         // total read (consumer, atomic)
+    unsigned long dropped;      // samples that didn't fit (producer, atomic)
+};
+
+// use storage (size samples, a power of two) and start empty
+void ring_init( SampleRing * ring, float * storage, unsigned long size );
+// producer: append up to n samples; returns how many fit
+unsigned long ring_write( SampleRing * ring, const float * in, unsigned long n );
+// producer: room for this many more, for producers that would rather wait
+unsigned long ring_space( SampleRing * ring );
+// consumer: samples waiting
+unsigned long ring_available( SampleRing * ring );
+// consumer: take exactly n samples if that many are waiting; false if not
+bool ring_read( SampleRing * ring, float * out, unsigned long n );
+// samples dropped so far (any thread)
+unsigned long ring_dropped( SampleRing * ring );
+
+
+#endif
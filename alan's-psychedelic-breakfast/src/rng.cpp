@@ -0,0 +1,123 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - rng.cpp
+// desc: xoshiro128** (Blackman & Vigna), seeded through splitmix64
+//-----------------------------------------------------------------------------
+#include "rng.h"
+
+
+// per-stream generator state
+static uint32_t g_rngState[RNG_NUM_STREAMS][4];
+static uint64_t g_rngSeed = 0;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: splitmix64()
+// desc: expands a seed into well-mixed state words
+//-----------------------------------------------------------------------------
+static uint64_t splitmix64( uint64_t & x )
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rotl( uint32_t x, int k )
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+static inline uint32_t next( uint32_t * s )
+{
+    uint32_t result = rotl( s[1] * 5, 7 ) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl( s[3], 11 );
+
+    return result;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rng_seed()
+// desc: each stream gets its own splitmix sequence, keyed by stream index
+//-----------------------------------------------------------------------------
+void rng_seed( uint64_t seed )
+{
+    g_rngSeed = seed;
+    for( int i = 0; i < RNG_NUM_STREAMS; i++ )
+    {
+        uint64_t x = seed ^ ((uint64_t)(i + 1) * 0xd1342543de82ef95ULL);
+        uint64_t a = splitmix64( x );
+        uint64_t b = splitmix64( x );
+        g_rngState[i][0] = (uint32_t)a;
+        g_rngState[i][1] = (uint32_t)(a >> 32);
+        g_rngState[i][2] = (uint32_t)b;
+        g_rngState[i][3] = (uint32_t)(b >> 32);
+    }
+}
+
+uint64_t rng_get_seed()
+{
+    return g_rngSeed;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rng_next() / rng_int() / rng_float()
+// desc: single draws
+//-----------------------------------------------------------------------------
+uint32_t rng_next( int stream )
+{
+    return next( g_rngState[stream] );
+}
+
+int rng_int( int stream, int n )
+{
+    // multiply-shift range reduction: no division, bias < n / 2^32
+    return (int)(((uint64_t)next( g_rngState[stream] ) * (uint32_t)n) >> 32);
+}
+
+float rng_float( int stream )
+{
+    // top 24 bits -> exactly representable floats in [0, 1)
+    return (next( g_rngState[stream] ) >> 8) * (1.0f / 16777216.0f);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rng_fill() / rng_fill_int()
+// desc: batch draws; the state stays in registers across the loop
+//-----------------------------------------------------------------------------
+void rng_fill( int stream, uint32_t * out, long count )
+{
+    uint32_t s[4] = { g_rngState[stream][0], g_rngState[stream][1],
+                      g_rngState[stream][2], g_rngState[stream][3] };
+    for( long i = 0; i < count; i++ )
+        out[i] = next( s );
+    for( int k = 0; k < 4; k++ )
+        g_rngState[stream][k] = s[k];
+}
+
+void rng_fill_int( int stream, int * out, long count, int n )
+{
+    uint32_t s[4] = { g_rngState[stream][0], g_rngState[stream][1],
+                      g_rngState[stream][2], g_rngState[stream][3] };
+    for( long i = 0; i < count; i++ )
+        out[i] = (int)(((uint64_t)next( s ) * (uint32_t)n) >> 32);
+    for( int k = 0; k < 4; k++ )
+        g_rngState[stream][k] = s[k];
+}
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - rng.h
+// desc: seedable xoshiro128** generator with one stream per subsystem, so a
+//       given seed (and audio) always produces the same frames
+//-----------------------------------------------------------------------------
+#ifndef __APB_RNG_H__
+#define __APB_RNG_H__
+
+#include <stdint.h>
+
+
+// independent streams; drawing from one never perturbs the others
+enum RngStream
+{
+    RNG_CENTRAL_COLOR = 0,
+    RNG_LINE_COLOR,
+    RNG_RAVE_COLOR,
+    RNG_SPECTRUM,
+    RNG_PULSE_COLOR,
+    RNG_NUM_STREAMS
+};
+
+// (re)seed every stream from one 64-bit seed
+void rng_seed( uint64_t seed );
+// the seed last passed to rng_seed()
+uint64_t rng_get_seed();
+
+// next raw 32-bit value
+uint32_t rng_next( int stream );
+// uniform integer in [0, n), n > 0 (stands in for rand() % n)
+int rng_int( int stream, int n );
+// uniform float in [0, 1)
+float rng_float( int stream );
+
+// batch versions of the above
+void rng_fill( int stream, uint32_t * out, long count );
+void rng_fill_int( int stream, int * out, long count, int n );
+
+
+#endif
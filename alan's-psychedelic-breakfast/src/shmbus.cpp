@@ -0,0 +1,283 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - shmbus.cpp
+// desc: shared memory seqlock ring of feature frames and raw blocks
+//-----------------------------------------------------------------------------
+#include "shmbus.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SHMBUS_MAGIC 0x53425041     // "APBS"
+#define SHMBUS_VERSION 1
+// a reader gives up on a read after this many races with the writer
+#define MAX_RETRIES 4
+
+// layout in the segment: the header, then SHMBUS_SLOTS slots. both sides
+// are the same build on the same machine, but readers check slotBytes
+struct ShmBusHeader
+{
+    uint32_t magic;                 // written last by the writer
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slotBytes;
+    uint32_t blockFrames;
+    uint32_t pad;
+    double srate;
+    uint64_t published;             // slots written so far (atomic)
+    char align[64 - 40];
+};
+
+struct ShmBusSlot
+{
+    uint64_t seq;                   // 2i+1 while slot i is written, 2i+2 after
+    uint32_t frames;
+    uint32_t pad;
+    FeatureFrame frame;
+    float block[SHMBUS_MAX_BLOCK];
+};
+
+static ShmBusSlot * slotAt( ShmBusHeader * h, uint64_t i )
+{
+    return (ShmBusSlot *)(h + 1) + i % SHMBUS_SLOTS;
+}
+
+static size_t segmentSize()
+{
+    return sizeof(ShmBusHeader) + SHMBUS_SLOTS * sizeof(ShmBusSlot);
+}
+
+static void reset( ShmBus * bus )
+{
+    memset( bus, 0, sizeof(*bus) );
+    bus->fd = -1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: shmbus_create()
+// desc: reuses a segment a previous writer left behind, so readers that
+//       kept it mapped carry on; the header is invalid while we set it up
+//-----------------------------------------------------------------------------
+bool shmbus_create( ShmBus * bus, const char * name, long blockFrames, double srate )
+{
+    reset( bus );
+    bus->size = segmentSize();
+    snprintf( bus->name, sizeof(bus->name), "%s", name );
+    if( blockFrames > SHMBUS_MAX_BLOCK )
+    {
+        fprintf( stderr, "shmbus: %s: blocks of %ld frames, at most %d fit\n",
+                 name, blockFrames, SHMBUS_MAX_BLOCK );
+        return false;
+    }
+
+    bus->fd = shm_open( name, O_CREAT | O_RDWR, 0644 );
+    bus->writer = bus->fd >= 0;
+    if( bus->fd < 0 || ftruncate( bus->fd, bus->size ) < 0 )
+    {
+        fprintf( stderr, "shmbus: %s: %s\n", name, strerror( errno ) );
+        shmbus_close( bus );
+        return false;
+    }
+    void * p = mmap( NULL, bus->size, PROT_READ | PROT_WRITE, MAP_SHARED, bus->fd, 0 );
+    if( p == MAP_FAILED )
+    {
+        fprintf( stderr, "shmbus: %s: mmap: %s\n", name, strerror( errno ) );
+        shmbus_close( bus );
+        return false;
+    }
+    bus->header = (ShmBusHeader *)p;
+
+    ShmBusHeader * h = bus->header;
+    __atomic_store_n( &h->magic, 0, __ATOMIC_RELEASE );
+    for( int i = 0; i < SHMBUS_SLOTS; i++ )
+        __atomic_store_n( &slotAt( h, i )->seq, 0, __ATOMIC_RELAXED );
+    h->version = SHMBUS_VERSION;
+    h->slots = SHMBUS_SLOTS;
+    h->slotBytes = sizeof(ShmBusSlot);
+    h->blockFrames = (uint32_t)blockFrames;
+    h->srate = srate;
+    __atomic_store_n( &h->published, 0, __ATOMIC_RELAXED );
+    __atomic_store_n( &h->magic, SHMBUS_MAGIC, __ATOMIC_RELEASE );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: shmbus_write()
+// desc: seqlock write: odd while the slot is inconsistent
+//-----------------------------------------------------------------------------
+void shmbus_write( ShmBus * bus, const FeatureFrame * frame, const float * block, long frames )
+{
+    ShmBusHeader * h = bus->header;
+    uint64_t i = h->published;
+    ShmBusSlot * s = slotAt( h, i );
+    if( frames > SHMBUS_MAX_BLOCK )
+        frames = SHMBUS_MAX_BLOCK;
+
+    __atomic_store_n( &s->seq, 2 * i + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    s->frames = (uint32_t)frames;
+    s->frame = *frame;
+    memcpy( s->block, block, sizeof(float) * frames );
+    __atomic_store_n( &s->seq, 2 * i + 2, __ATOMIC_RELEASE );
+    __atomic_store_n( &h->published, i + 1, __ATOMIC_RELEASE );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: shmbus_attach()
+// desc: read-only mapping: a reader can't disturb the writer or others
+//-----------------------------------------------------------------------------
+bool shmbus_attach( ShmBus * bus, const char * name, bool quiet )
+{
+    reset( bus );
+    bus->size = segmentSize();
+    snprintf( bus->name, sizeof(bus->name), "%s", name );
+
+    const char * why = NULL;
+    struct stat st;
+    bus->fd = shm_open( name, O_RDONLY, 0 );
+    if( bus->fd < 0 || fstat( bus->fd, &st ) < 0 )
+        why = strerror( errno );
+    else if( (size_t)st.st_size < bus->size )
+        why = "segment too small (different build?)";
+    else
+    {
+        void * p = mmap( NULL, bus->size, PROT_READ, MAP_SHARED, bus->fd, 0 );
+        if( p == MAP_FAILED )
+            why = strerror( errno );
+        else
+        {
+            bus->header = (ShmBusHeader *)p;
+            ShmBusHeader * h = bus->header;
+            if( __atomic_load_n( &h->magic, __ATOMIC_ACQUIRE ) != SHMBUS_MAGIC )
+                why = "no writer has set it up";
+            else if( h->version != SHMBUS_VERSION || h->slots != SHMBUS_SLOTS ||
+                     h->slotBytes != sizeof(ShmBusSlot) )
+                why = "layout mismatch (different build?)";
+        }
+    }
+
+    if( why )
+    {
+        if( !quiet )
+            fprintf( stderr, "shmbus: %s: %s\n", name, why );
+        shmbus_close( bus );
+        return false;
+    }
+    return true;
+}
+
+bool shmbus_reattach( ShmBus * bus )
+{
+    ShmBus old = *bus;
+    shmbus_close( bus );
+    if( !shmbus_attach( bus, old.name, true ) )
+        return false;
+    bus->read = old.read;
+    bus->skipped = old.skipped;
+    bus->retries = old.retries;
+    return true;
+}
+
+long shmbus_block_frames( const ShmBus * bus )
+{
+    return bus->header->blockFrames;
+}
+
+double shmbus_srate( const ShmBus * bus )
+{
+    return bus->header->srate;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: shmbus_read()
+// desc: seqlock read of the newest slot: the copy counts only if the
+//       slot's seq was even and unchanged across it
+//-----------------------------------------------------------------------------
+bool shmbus_read( ShmBus * bus, FeatureFrame * frame, float * block, long maxFrames, long * frames )
+{
+    ShmBusHeader * h = bus->header;
+    for( int attempt = 0; attempt < MAX_RETRIES; attempt++ )
+    {
+        uint64_t published = __atomic_load_n( &h->published, __ATOMIC_ACQUIRE );
+        // the writer started over
+        if( published < bus->last )
+            bus->last = 0;
+        if( published == bus->last )
+            return false;
+
+        uint64_t i = published - 1;
+        ShmBusSlot * s = slotAt( h, i );
+        uint64_t seq = __atomic_load_n( &s->seq, __ATOMIC_ACQUIRE );
+        if( seq == 2 * i + 2 )
+        {
+            long n = s->frames;
+            if( n > maxFrames ) n = maxFrames;
+            *frame = s->frame;
+            memcpy( block, s->block, sizeof(float) * n );
+            __atomic_thread_fence( __ATOMIC_ACQUIRE );
+            if( __atomic_load_n( &s->seq, __ATOMIC_RELAXED ) == seq )
+            {
+                *frames = n;
+                if( bus->last )
+                    bus->skipped += i - bus->last;
+                bus->last = published;
+                bus->read++;
+                return true;
+            }
+        }
+        // lapped mid-copy; the next newest is already there
+        bus->retries++;
+    }
+    return false;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: shmbus_format()
+// desc: "read 1234, skipped 56, retried 0"
+//-----------------------------------------------------------------------------
+void shmbus_format( const ShmBus * bus, char * buf, size_t size )
+{
+    if( bus->writer )
+        snprintf( buf, size, "%s: wrote %llu frames", bus->name,
+                  (unsigned long long)__atomic_load_n( &bus->header->published, __ATOMIC_RELAXED ) );
+    else
+        snprintf( buf, size, "%s: read %lu, skipped %lu, retried %lu",
+                  bus->name, bus->read, bus->skipped, bus->retries );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: shmbus_close()
+// desc: readers still attached keep their mapping until they close too
+//-----------------------------------------------------------------------------
+void shmbus_close( ShmBus * bus )
+{
+    if( bus->header )
+        munmap( bus->header, bus->size );
+    if( bus->fd >= 0 )
+        close( bus->fd );
+    if( bus->writer && bus->name[0] )
+        shm_unlink( bus->name );
+    bus->header = NULL;
+    bus->fd = -1;
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - shmbus.h
+// desc: feature bus for renderer processes on the same machine. the
+//       analysis stage writes each feature frame, with the raw block it
+//       came from, into a POSIX shared memory ring of seqlocked slots.
+//       readers map it read-only and take the newest slot, retrying if it
+//       was rewritten under them, so any number of readers cost the
+//       writer nothing and can never hold it up
+//-----------------------------------------------------------------------------
+#ifndef __APB_SHMBUS_H__
+#define __APB_SHMBUS_H__
+
+#include "feature.h"
+
+// slots in the ring; a reader more than this many frames behind skips ahead
+#define SHMBUS_SLOTS 16
+// largest raw block a slot holds
+#define SHMBUS_MAX_BLOCK 8192
+
+struct ShmBusHeader;
+
+struct ShmBus
+{
+    int fd;
+    ShmBusHeader * header;
+    size_t size;
+    bool writer;
+    char name[64];
+    // reader: slots taken, newer slots written meanwhile (skipped), reads
+    // that raced the writer and were retried, and the last one taken
+    unsigned long read;
+    unsigned long skipped;
+    unsigned long retries;
+    uint64_t last;
+};
+
+// writer: create (or take over) the segment name ("/apb", say) for blocks
+// of up to blockFrames at srate; false, with a message, if it can't
+bool shmbus_create( ShmBus * bus, const char * name, long blockFrames, double srate );
+// writer: publish one frame and its raw block. no allocation, no locks
+void shmbus_write( ShmBus * bus, const FeatureFrame * frame, const float * block, long frames );
+// reader: map an existing segment; false if it isn't there (yet), with a
+// message unless quiet
+bool shmbus_attach( ShmBus * bus, const char * name, bool quiet );
+// reader: map the name again, keeping the counters (a restarted writer
+// may have left the old segment behind)
+bool shmbus_reattach( ShmBus * bus );
+// reader: block size and rate the writer announced
+long shmbus_block_frames( const ShmBus * bus );
+double shmbus_srate( const ShmBus * bus );
+// reader: copy the newest slot if it's new since the last call; block
+// gets up to maxFrames samples and *frames how many the writer put there.
+// returns false if there's nothing new, or if it kept racing the writer
+// (frame and block may then hold a torn copy)
+bool shmbus_read( ShmBus * bus, FeatureFrame * frame, float * block, long maxFrames, long * frames );
+// one-line summary for the log or overlay
+void shmbus_format( const ShmBus * bus, char * buf, size_t size );
+// unmap; the writer also removes the name
+void shmbus_close( ShmBus * bus );
+
+
+#endif
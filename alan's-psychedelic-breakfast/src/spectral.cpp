@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - spectral.cpp
+// desc: spectral descriptors from dsp_spectral_pack()'s sums
+//-----------------------------------------------------------------------------
+#include "spectral.h"
+#include "dsp.h"
+#include <math.h>
+#include <string.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: spectral_size()
+// desc: magnitudes, decibels and the previous magnitudes
+//-----------------------------------------------------------------------------
+size_t spectral_size( long bins )
+{
+    return 3 * arena_size( sizeof(float) * bins );
+}
+
+void spectral_init( SpectralPack * s, Arena * arena, long bins, double srate )
+{
+    memset( s, 0, sizeof(*s) );
+    s->bins = bins;
+    s->binHz = srate / 2 / bins;
+    s->mag = arena_array<float>( arena, bins );
+    s->db = arena_array<float>( arena, bins );
+    s->prev = arena_array<float>( arena, bins );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: spectral_process()
+// desc: moments of the magnitudes for centroid and spread; flatness is
+//       the geometric mean of the power (from the mean of the decibels)
+//       over its arithmetic mean
+//-----------------------------------------------------------------------------
+void spectral_process( SpectralPack * s, const complex * fft )
+{
+    float sums[DSP_SUMS];
+    dsp_spectral_pack( fft, s->prev, s->bins, s->mag, s->db, sums );
+    memcpy( s->prev, s->mag, sizeof(float) * s->bins );
+    s->flux = sqrtf( sums[DSP_SUM_FLUX] );
+
+    float power = sums[DSP_SUM_POWER];
+    if( power <= s->bins * DSP_MAG_FLOOR * DSP_MAG_FLOOR || sums[DSP_SUM_MAG] <= 0 )
+    {
+        s->centroid = s->spread = s->rolloff = s->flatness = 0;
+        return;
+    }
+    double mean = sums[DSP_SUM_MOMENT1] / sums[DSP_SUM_MAG];
+    double var = sums[DSP_SUM_MOMENT2] / sums[DSP_SUM_MAG] - mean * mean;
+    s->centroid = (float)(mean * s->binHz);
+    s->spread = (float)(sqrt( var > 0 ? var : 0 ) * s->binHz);
+    double geometric = pow( 10.0, sums[DSP_SUM_DB] / s->bins / 10 );
+    double flatness = geometric / (power / s->bins);
+    s->flatness = (float)(flatness < 1 ? flatness : 1);
+
+    float target = SPECTRAL_ROLLOFF * power, below = 0;
+    long k = 0;
+    for( ; k < s->bins - 1; k++ )
+    {
+        below += s->mag[k] * s->mag[k];
+        if( below >= target )
+            break;
+    }
+    s->rolloff = (float)(k * s->binHz);
+}
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - spectral.h
+// desc: spectral descriptors: centroid, spread, rolloff, flatness and flux,
+//       with the magnitudes and decibels they come from. one fused pass
+//       (dsp_spectral_pack()) takes the fft to magnitudes and sums; only
+//       the rolloff, which needs the total first, walks the power again
+//-----------------------------------------------------------------------------
+#ifndef __APB_SPECTRAL_H__
+#define __APB_SPECTRAL_H__
+
+#include "arena.h"
+#include "chuck_fft.h"
+
+// the rolloff is where this fraction of the power lies below
+#define SPECTRAL_ROLLOFF 0.85f
+
+struct SpectralPack
+{
+    long bins;
+    double binHz;
+    float * mag;                    // bins magnitudes, newest spectrum
+    float * db;                     // the same, 20 log10
+    float * prev;                   // the spectrum before, for the flux
+    float centroid;                 // hz, magnitude weighted
+    float spread;                   // hz, standard deviation about the centroid
+    float rolloff;                  // hz
+    float flatness;                 // geometric over arithmetic mean power, [0, 1]
+    float flux;                     // l2 norm of the magnitudes' rise
+};
+
+// arena bytes for spectral_init()
+size_t spectral_size( long bins );
+// spectra of bins bins (an rfft of 2 * bins samples at srate)
+void spectral_init( SpectralPack * s, Arena * arena, long bins, double srate );
+// one new spectrum, as rfft left it; descriptors are 0 for silence. no
+// allocation
+void spectral_process( SpectralPack * s, const complex * fft );
+
+
+#endif
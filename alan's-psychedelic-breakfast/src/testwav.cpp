@@ -0,0 +1,172 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - testwav.cpp
+// desc: writes the golden-image test signals (make golden): short mono
+//       16-bit WAVs synthesized from nothing but their formulas, so every
+//       checkout renders the same audio
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+#define TEST_SRATE 44100
+#define TEST_SECONDS 4
+#define TEST_FRAMES (TEST_SRATE * TEST_SECONDS)
+#define TEST_PI 3.14159265358979323846
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: put16() / put32()
+// desc: little-endian header fields
+//-----------------------------------------------------------------------------
+static void put16( FILE * f, uint16_t v )
+{
+    fputc( v & 0xff, f );
+    fputc( v >> 8, f );
+}
+
+static void put32( FILE * f, uint32_t v )
+{
+    put16( f, v & 0xffff );
+    put16( f, v >> 16 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: writeWav()
+// desc: samples (-1..1) as a mono 16-bit PCM WAV; false on failure
+//-----------------------------------------------------------------------------
+static bool writeWav( const string & path, const vector<double> & samples )
+{
+    FILE * f = fopen( path.c_str(), "wb" );
+    if( !f )
+    {
+        perror( path.c_str() );
+        return false;
+    }
+
+    const uint32_t dataBytes = samples.size() * 2;
+    fwrite( "RIFF", 1, 4, f );
+    put32( f, 36 + dataBytes );
+    fwrite( "WAVEfmt ", 1, 8, f );
+    put32( f, 16 );
+    put16( f, 1 );
+    put16( f, 1 );
+    put32( f, TEST_SRATE );
+    put32( f, TEST_SRATE * 2 );
+    put16( f, 2 );
+    put16( f, 16 );
+    fwrite( "data", 1, 4, f );
+    put32( f, dataBytes );
+
+    for( size_t i = 0; i < samples.size(); i++ )
+    {
+        double s = samples[i];
+        if( s > 1 ) s = 1;
+        if( s < -1 ) s = -1;
+        put16( f, (uint16_t)(int16_t)lrint( s * 32767 ) );
+    }
+
+    bool ok = !ferror( f );
+    if( fclose( f ) != 0 )
+        ok = false;
+    if( !ok )
+        fprintf( stderr, "%s: write failed\n", path.c_str() );
+    return ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: chords()
+// desc: 120 bpm: a kick on every beat under C major and A minor triads,
+//       a bar each, so the pulses, tempo and harmony all have something
+//-----------------------------------------------------------------------------
+static void chords( vector<double> & out )
+{
+    static const double TRIADS[2][3] = {
+        { 261.63, 329.63, 392.00 },     // C E G
+        { 220.00, 261.63, 329.63 }      // A C E
+    };
+    const long beat = TEST_SRATE / 2;
+
+    out.assign( TEST_FRAMES, 0 );
+    for( long i = 0; i < TEST_FRAMES; i++ )
+    {
+        double t = (double)i / TEST_SRATE;
+        const double * triad = TRIADS[(i / (beat * 4)) % 2];
+        double v = 0;
+        for( int n = 0; n < 3; n++ )
+            v += 0.12 * sin( 2 * TEST_PI * triad[n] * t );
+
+        // kick: a 55 Hz thump falling away over ~100 ms
+        double k = (double)(i % beat) / TEST_SRATE;
+        v += 0.5 * exp( -k * 30 ) * sin( 2 * TEST_PI * 55 * k );
+        out[i] = v;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: sweep()
+// desc: a log sine sweep, 40 Hz to 8 kHz, with a noise burst every quarter
+//       second, so every band lights up in turn
+//-----------------------------------------------------------------------------
+static void sweep( vector<double> & out )
+{
+    const double f0 = 40, f1 = 8000;
+    const double rate = log( f1 / f0 ) / TEST_SECONDS;
+    const long tick = TEST_SRATE / 4;
+    // fixed LCG, not rng.h: the test audio mustn't move with the visuals' streams
+    uint32_t seed = 12345;
+
+    out.assign( TEST_FRAMES, 0 );
+    for( long i = 0; i < TEST_FRAMES; i++ )
+    {
+        double t = (double)i / TEST_SRATE;
+        double v = 0.4 * sin( 2 * TEST_PI * f0 * (exp( rate * t ) - 1) / rate );
+
+        seed = seed * 1664525u + 1013904223u;
+        double noise = (double)(seed >> 8) / (1 << 24) * 2 - 1;
+        double k = (double)(i % tick) / TEST_SRATE;
+        v += 0.3 * exp( -k * 60 ) * noise;
+        out[i] = v;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: main()
+// desc: testwav <dir> - writes <dir>/chords.wav and <dir>/sweep.wav
+//-----------------------------------------------------------------------------
+int main( int argc, char ** argv )
+{
+    if( argc != 2 )
+    {
+        fprintf( stderr, "usage: testwav <dir>\n" );
+        return 2;
+    }
+
+    string dir = argv[1];
+    vector<double> samples;
+    chords( samples );
+    if( !writeWav( dir + "/chords.wav", samples ) )
+        return 1;
+    sweep( samples );
+    if( !writeWav( dir + "/sweep.wav", samples ) )
+        return 1;
+    return 0;
+}
@@ -0,0 +1,227 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - threads.cpp
+// desc: per-role cpu pinning, realtime priority and ftz/daz
+//-----------------------------------------------------------------------------
+#include "threads.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+// mxcsr flush-to-zero (bit 15) and denormals-are-zero (bit 6)
+#define MXCSR_FTZ_DAZ 0x8040
+// aarch64 fpcr flush-to-zero (covers inputs too)
+#define FPCR_FZ (1UL << 24)
+
+// what happened when a role was applied
+struct ThreadState
+{
+    int applied;            // set once threads_apply() is done (atomic)
+    char placed[128];       // effective placement, read back
+    char refused[160];      // requests the system turned down
+};
+
+static ThreadConfig g_config[THREAD_NUM_ROLES] = {
+    { -1, 0, true },
+    { -1, 0, true },
+    { -1, 0, true },
+    { -1, 0, true }
+};
+static ThreadState g_state[THREAD_NUM_ROLES];
+static const char * g_roleNames[THREAD_NUM_ROLES] = { "audio", "analysis", "render", "recorder" };
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: threads_config() / threads_parse()
+// desc: requested settings
+//-----------------------------------------------------------------------------
+ThreadConfig * threads_config( ThreadRole role )
+{
+    return &g_config[role];
+}
+
+bool threads_parse( ThreadRole role, const char * spec )
+{
+    ThreadConfig c = g_config[role];
+    const char * p = spec;
+    char * end;
+
+    if( *p == '-' )
+    {
+        c.cpu = -1;
+        p++;
+    }
+    else
+    {
+        long cpu = strtol( p, &end, 10 );
+        if( end == p || cpu < 0 || cpu >= 1024 ) return false;
+        c.cpu = (int)cpu;
+        p = end;
+    }
+
+    if( *p == ':' )
+    {
+        long prio = strtol( ++p, &end, 10 );
+        if( end == p || prio < 0 ) return false;
+        c.priority = (int)prio;
+        p = end;
+    }
+
+    if( *p ) return false;
+    g_config[role] = c;
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: threads_set_ftz()
+// desc: denormals in, zeros out; only affects the calling thread
+//-----------------------------------------------------------------------------
+void threads_set_ftz( bool on )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int csr = _mm_getcsr();
+    _mm_setcsr( on ? csr | MXCSR_FTZ_DAZ : csr & ~MXCSR_FTZ_DAZ );
+#elif defined(__aarch64__)
+    unsigned long fpcr;
+    __asm__ __volatile__( "mrs %0, fpcr" : "=r"(fpcr) );
+    fpcr = on ? fpcr | FPCR_FZ : fpcr & ~FPCR_FZ;
+    __asm__ __volatile__( "msr fpcr, %0" : : "r"(fpcr) );
+#else
+    (void)on;
+#endif
+}
+
+static const char * ftzState()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int csr = _mm_getcsr() & MXCSR_FTZ_DAZ;
+    return csr == MXCSR_FTZ_DAZ ? "on" : csr ? "partial" : "off";
+#elif defined(__aarch64__)
+    unsigned long fpcr;
+    __asm__ __volatile__( "mrs %0, fpcr" : "=r"(fpcr) );
+    return (fpcr & FPCR_FZ) ? "on" : "off";
+#else
+    return "unsupported";
+#endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: threads_apply()
+// desc: called by the thread itself; records refusals instead of failing,
+//       since realtime priority usually needs rtprio limits or root
+//-----------------------------------------------------------------------------
+static void refuse( ThreadState * s, const char * fmt, ... )
+{
+    size_t len = strlen( s->refused );
+    if( len + 2 >= sizeof(s->refused) ) return;
+    if( len ) { strcpy( s->refused + len, "; " ); len += 2; }
+
+    va_list args;
+    va_start( args, fmt );
+    vsnprintf( s->refused + len, sizeof(s->refused) - len, fmt, args );
+    va_end( args );
+}
+
+void threads_apply( ThreadRole role )
+{
+    const ThreadConfig & c = g_config[role];
+    ThreadState * s = &g_state[role];
+    s->refused[0] = '\0';
+
+    if( c.cpu >= 0 )
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        CPU_SET( c.cpu, &set );
+        int err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+        if( err ) refuse( s, "cpu %d: %s", c.cpu, strerror( err ) );
+#else
+        refuse( s, "cpu %d: pinning not supported here", c.cpu );
+#endif
+    }
+
+    if( c.priority > 0 )
+    {
+        // clamp like RtAudio does for RTAUDIO_SCHEDULE_REALTIME
+        struct sched_param param;
+        int lo = sched_get_priority_min( SCHED_RR );
+        int hi = sched_get_priority_max( SCHED_RR );
+        param.sched_priority = c.priority < lo ? lo : c.priority > hi ? hi : c.priority;
+        int err = pthread_setschedparam( pthread_self(), SCHED_RR, &param );
+        if( err ) refuse( s, "SCHED_RR %d: %s", param.sched_priority, strerror( err ) );
+    }
+
+    threads_set_ftz( c.ftz );
+
+    // read back what we actually got
+    char cpus[64] = "any";
+#if defined(__linux__)
+    cpu_set_t set;
+    long online = sysconf( _SC_NPROCESSORS_ONLN );
+    if( pthread_getaffinity_np( pthread_self(), sizeof(set), &set ) == 0 &&
+        CPU_COUNT( &set ) < online )
+    {
+        size_t len = 0;
+        cpus[0] = '\0';
+        for( int i = 0; i < CPU_SETSIZE && len + 8 < sizeof(cpus); i++ )
+            if( CPU_ISSET( i, &set ) )
+                len += snprintf( cpus + len, sizeof(cpus) - len, len ? ",%d" : "%d", i );
+    }
+#endif
+    int policy = SCHED_OTHER;
+    struct sched_param param;
+    param.sched_priority = 0;
+    pthread_getschedparam( pthread_self(), &policy, &param );
+    const char * policyName = policy == SCHED_RR ? "SCHED_RR" :
+        policy == SCHED_FIFO ? "SCHED_FIFO" : "normal";
+
+    snprintf( s->placed, sizeof(s->placed), "cpu %s, %s priority %d, ftz/daz %s",
+              cpus, policyName, param.sched_priority, ftzState() );
+
+    __atomic_store_n( &s->applied, 1, __ATOMIC_RELEASE );
+}
+
+bool threads_applied( ThreadRole role )
+{
+    return __atomic_load_n( &g_state[role].applied, __ATOMIC_ACQUIRE ) != 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: threads_report()
+// desc: one line per role
+//-----------------------------------------------------------------------------
+void threads_report()
+{
+    fprintf( stderr, "threads:\n" );
+    for( int i = 0; i < THREAD_NUM_ROLES; i++ )
+    {
+        const ThreadState * s = &g_state[i];
+        if( !threads_applied( (ThreadRole)i ) )
+        {
+            fprintf( stderr, "  %-9s not running\n", g_roleNames[i] );
+            continue;
+        }
+        fprintf( stderr, "  %-9s %s", g_roleNames[i], s->placed );
+        if( s->refused[0] )
+            fprintf( stderr, " (refused: %s)", s->refused );
+        fprintf( stderr, "\n" );
+    }
+}
@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - threads.h
+// desc: thread topology. each pipeline thread (audio callback, analysis,
+//       render, session recorder) can be pinned to a core, given a
+//       realtime priority and run with flush-to-zero/denormals-are-zero.
+//       a thread applies its own role's settings, and the report shows
+//       what actually took
+//-----------------------------------------------------------------------------
+#ifndef __APB_THREADS_H__
+#define __APB_THREADS_H__
+
+enum ThreadRole
+{
+    THREAD_AUDIO,
+    THREAD_ANALYSIS,
+    THREAD_RENDER,
+    THREAD_RECORDER,
+    THREAD_NUM_ROLES
+};
+
+struct ThreadConfig
+{
+    int cpu;            // core to pin to, -1 = leave it to the scheduler
+    int priority;       // SCHED_RR priority, 0 = normal scheduling
+    bool ftz;           // flush denormals to zero (default on)
+};
+
+// requested settings for a role; edit before the thread applies them
+ThreadConfig * threads_config( ThreadRole role );
+// parse "cpu[:priority]" ("-" for no pinning) into a role's config;
+// returns false if malformed
+bool threads_parse( ThreadRole role, const char * spec );
+// apply a role's config to the calling thread and record what took effect
+void threads_apply( ThreadRole role );
+// has threads_apply() run for this role yet (safe from any thread)
+bool threads_applied( ThreadRole role );
+// set flush-to-zero/denormals-are-zero for the calling thread
+void threads_set_ftz( bool on );
+// print the effective placement of every role to stderr
+void threads_report();
+
+
+#endif
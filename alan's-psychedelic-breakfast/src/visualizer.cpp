@@ -9,11 +9,29 @@
 
 #include "RtAudio.h"
 #include "chuck_fft.h"
+#include "rng.h"
+#include "wavfile.h"
+#include "golden.h"
+#include "dsp.h"
+#include "arena.h"
+#include "threads.h"
+#include "health.h"
+#include "analysis.h"
+#include "featcache.h"
+#include "recorder.h"
+#include "decoder.h"
+#include "filterbank.h"
+#include "harmony.h"
+#include "loudness.h"
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <iostream>
 #include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
 using namespace std;
 
 #ifdef __MACOSX_CORE__
@@ -26,6 +44,14 @@ using namespace std;
 #include <GL/glut.h>
 #endif
 
+// apple's gl headers provide these, others don't
+#ifndef TRUE
+#define TRUE GL_TRUE
+#endif
+#ifndef FALSE
+#define FALSE GL_FALSE
+#endif
+
 
 
 
@@ -39,6 +65,27 @@ void displayFunc();
 void reshapeFunc( GLsizei width, GLsizei height );
 void keyboardFunc( unsigned char, int, int );
 void mouseFunc( int button, int state, int x, int y );
+void parseArgs( int argc, char ** argv );
+void allocBuffers( long bufferFrames );
+void advanceClock();
+void offlineOpenCache( long bufferFrames );
+void offlineReadBlock();
+void offlineCaptureFrame();
+void offlineFinish();
+void feedReadBlock();
+void busReadBlock();
+float latestLoudness();
+void healthTick();
+void recordClose();
+void playlistAdd( const char * path );
+void playFinish();
+struct View;
+View defaultView();
+bool parseView( const char * spec, View * view );
+View * currentView();
+void updateFrame();
+void drawView( const View & view );
+void drawOverlay( const View & view );
 
 // our datetype
 #define SAMPLE float
@@ -50,35 +97,73 @@ void mouseFunc( int button, int state, int x, int y );
 #define MY_CHANNELS 1
 // for convenience
 #define MY_PIE 3.14159265358979
+// frame rate the per-frame animation constants were tuned at
+#define REF_FPS 60.0
+// longest step we integrate in one go (e.g. after a stall)
+#define MAX_STEP 0.25
+// render-only: seconds to hold the last feature frame, then fade per ref frame
+#define FEED_HOLD 0.25
+#define FEED_FADE 0.9
+// render-only from the bus: seconds without a new block before re-attaching
+#define BUS_REATTACH 1.0
+// mean |x| over rms, for a sine (2 sqrt(2) / pi)
+#define MEAN_ABS_PER_RMS 0.9003163
 
-// width and height
-long g_width = 1024;
-long g_height = 720;
-long g_last_width = g_width;
-long g_last_height = g_height;
 // global buffer
 SAMPLE * g_buffer = NULL;
 long g_bufferSize;
 // fft buffer
 SAMPLE * g_fftBuf = NULL;
-// freq domain buffer history
+// magnitude spectrum of the current block
+SAMPLE * g_mag = NULL;
+// magnitude spectrum history
 const long MAX_STATES = 61;
-complex *g_FDBufHistory[MAX_STATES];
+SAMPLE *g_FDBufHistory[MAX_STATES];
 long g_nHistoryStates;
 // window
 SAMPLE * g_window = NULL;
 long g_windowSize;
+// geometry that doesn't depend on the viewport, built once per frame by
+// updateFrame() and drawn by every window straight from these (x, y pairs)
+GLfloat * g_circleVerts = NULL;     // 360 points
+GLfloat * g_waveVerts = NULL;       // g_bufferSize points
+GLfloat * g_horizonVerts = NULL;    // g_bufferSize points
+GLfloat * g_specVerts = NULL;       // MAX_STATES strips of g_specPoints
+long g_specPoints;
+// spectrum waterfall over perceptual bands rather than raw bins (see
+// filterbank.h); 0 = raw bins
+long g_specBands = 0;
+FilterScale g_specScale = FILTER_MEL;
+FilterBank g_filterBank;
+// every buffer above lives here; see allocBuffers()
+Arena g_dspArena;
 
 // global variables
-GLboolean g_fullscreen = FALSE;
-GLboolean g_toggleRave = FALSE;
-GLboolean g_toggleBassPulses = TRUE;
-GLboolean g_toggleMidPulses = TRUE;
 GLboolean g_toggleTreblePulses = TRUE;
 GLboolean g_flash = FALSE;
-GLboolean g_toggleTDWaveform = TRUE;
-GLboolean g_toggleFDWaveform = TRUE;
-GLboolean g_allowAutoRave = FALSE;
+
+// an output window: its size, where it goes and which layers it shows.
+// every window draws the same frame (see updateFrame())
+struct View {
+    int window;                 // glut window id
+    long width;
+    long height;
+    long lastWidth;             // to go back to from fullscreen
+    long lastHeight;
+    int x;
+    int y;
+    GLboolean fullscreen;
+    GLboolean toggleRave;
+    GLboolean toggleBassPulses;
+    GLboolean toggleMidPulses;
+    GLboolean toggleTDWaveform;
+    GLboolean toggleFDWaveform;
+    GLboolean allowAutoRave;
+    GLboolean showOverlay;      // profiler overlay
+};
+const int MAX_VIEWS = 8;
+View g_views[MAX_VIEWS];
+int g_numViews = 0;
 
 
 struct Colorf {
@@ -106,22 +191,94 @@ float g_zRotWaves = 0.5;    // slower
 float g_zRotWaves2 = 0.5;    // faster
 // rotation params for time domain waveform circle
 float g_zRotWavesC = 0.5;
-int g_flashFrame = 0;
+float g_flashFrame = 0;
 int g_flashFR = 6;
 // bass pulse governing params
 const int MAX_BASS_PULSES = 40;
 SoundPulse g_bassPulses[MAX_BASS_PULSES];
 // bass pulse stagger params
-int g_bassPulseCounter = 0;
+float g_bassPulseCounter = 0;
 const int BASS_PULSE_STAGGER = 200;
 int g_bassPulseIndex = 0;
 // mid pulse governing params
 const int MAX_MID_PULSES = 50;
 SoundPulse g_midPulses[MAX_MID_PULSES];
 // mid pulse stagger params
-int g_midPulseCounter = 0;
+float g_midPulseCounter = 0;
 const int MID_PULSE_STAGGER = 400;
 int g_midPulseIndex = 0;
+// animation clock
+double g_fixedStep = 0;         // seconds per frame, 0 = follow wall clock
+double g_dt = 1.0 / REF_FPS;    // seconds since last frame
+float g_frameScale = 1;         // g_dt in units of reference frames
+double g_lastTime = -1;
+GLboolean g_seedGiven = FALSE;
+// ALSA capture straight out of the mmap ring (--alsa-mmap); off until
+// it has been run on more devices
+GLboolean g_alsaMmap = FALSE;
+// offline rendering from a file (--wav)
+const char * g_wavPath = NULL;
+WavFile g_wav;
+double g_srate = MY_SRATE;
+double g_offlinePos = 0;        // read position in sample frames
+long g_offlineIndex = 0;        // blocks read so far
+// analysis cache (--analysis-cache): replayed if there's one for this
+// audio, written as we go if not
+const char * g_cacheDir = NULL;
+FeatCache g_cache;
+GLboolean g_cacheReplay = FALSE;
+FeatureFrame g_cacheFrame;
+// session recording (--record)
+const char * g_recordPath = NULL;
+GLboolean g_recordDirect = FALSE;
+Recorder g_recorder;
+GLboolean g_recording = FALSE;
+// playlist playback (--play): files decoded ahead on their own thread
+// and handed on like capture blocks, paced or as fast as analysis goes
+vector<string> g_playlist;
+vector<const char *> g_playPaths;
+double g_decodeAhead = 2;           // seconds
+GLboolean g_freeRun = FALSE;
+Decoder g_decoder;
+GLboolean g_playing = FALSE;
+// raw PCM on a pipe (--pcm), played through the same decoder
+const char * g_pcmPath = NULL;
+PcmFormat g_pcmFormat = PCM_S16LE;
+double g_pcmRate = 0;
+int g_pcmChannels = 0;
+long g_frameNumber = 0;
+// golden-image capture/compare
+vector<long> g_captureFrames;
+const char * g_goldenDir = NULL;
+GLboolean g_goldenUpdate = FALSE;
+float g_goldenPixelTol = 0.1;
+float g_goldenSectionTol = 0.01;
+int g_goldenChecked = 0;
+int g_goldenFailed = 0;
+// capture health (see health.h): profiler overlay and periodic log
+double g_healthLogInterval = 10;    // seconds, 0 = no log
+double g_healthLastLog = -1;
+// render frame timing on the wall clock, for the same overlay and log
+double g_frameWallLast = -1;
+double g_frameWallAvg = 0;          // smoothed frame interval
+double g_frameWallMax = 0;          // worst frame since the last log line
+// feature frames over the network (see netfeed.h): a capturing node can
+// publish them, a render-only node draws from them instead of a device
+const char * g_publishSpec = NULL;
+const char * g_subscribeSpec = NULL;
+GLboolean g_publishOsc = FALSE;
+NetFeed g_feed;
+FeatureFrame g_feedFrame;           // newest frame received
+double g_feedLastRx = -1;           // when it arrived (monotonic)
+// the same frames, with their raw blocks, for renderer processes on this
+// machine (see shmbus.h): one process writes, any number attach
+const char * g_busName = NULL;
+const char * g_attachName = NULL;
+ShmBus g_bus;
+double g_busLastTry = -1;
+// callback -> analysis thread, when publishing live
+SampleRing g_captureRing;
+GLboolean g_analyzeLive = FALSE;
 
 
 //-----------------------------------------------------------------------------
@@ -131,33 +288,84 @@ int g_midPulseIndex = 0;
 int callme( void * outputBuffer, void * inputBuffer, unsigned int numFrames,
             double streamTime, RtAudioStreamStatus status, void * data )
 {
+    (void)streamTime;
+    (void)data;
+    // first block on this thread: pin it, raise it, set ftz/daz
+    if( !threads_applied( THREAD_AUDIO ) )
+        threads_apply( THREAD_AUDIO );
+    // count xruns and time this callback
+    health_callback_begin( (status & RTAUDIO_INPUT_OVERFLOW) != 0,
+                           (status & RTAUDIO_OUTPUT_UNDERFLOW) != 0 );
+
+    ALLOC_CHECK_BEGIN();
     // cast!
     SAMPLE * input = (SAMPLE *)inputBuffer;
     SAMPLE * output = (SAMPLE *)outputBuffer;
     
     // fill
-    for( int i = 0; i < numFrames; i++ )
+    for( unsigned int i = 0; i < numFrames; i++ )
     {
         // assume mono
         g_buffer[i] = input[i];
         // zero output
         output[i] = 0;
     }
+    // hand the block to the analysis thread, and the recorder
+    if( g_analyzeLive )
+        ring_write( &g_captureRing, input, numFrames );
+    if( g_recording )
+        recorder_audio( &g_recorder, input, numFrames, netfeed_clock() );
     
+    ALLOC_CHECK_END();
+    health_callback_end();
     return 0;
 }
 
 
 
 
+//-----------------------------------------------------------------------------
+// name: playBlock()
+// desc: decoder callback, on the decoder's thread: the playlist's blocks
+//       take the capture path. free-running, a block that won't fit in
+//       the capture ring is turned down, to be offered again, so the
+//       analysis sets the pace and nothing is dropped
+//-----------------------------------------------------------------------------
+bool playBlock( const float * block, long frames, double streamTime, void * data )
+{
+    (void)streamTime;
+    (void)data;
+    if( g_freeRun && g_analyzeLive && ring_space( &g_captureRing ) < (unsigned long)frames )
+        return false;
+    if( !g_freeRun )
+        health_callback_begin( false, false );
+
+    ALLOC_CHECK_BEGIN();
+    memcpy( g_buffer, block, sizeof(SAMPLE) * frames );
+    if( g_analyzeLive )
+        ring_write( &g_captureRing, block, frames );
+    if( g_recording )
+        recorder_audio( &g_recorder, block, frames, netfeed_clock() );
+    ALLOC_CHECK_END();
+
+    if( !g_freeRun )
+        health_callback_end();
+    return true;
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // name: main()
 // desc: entry point
 //-----------------------------------------------------------------------------
 int main( int argc, char ** argv )
 {
-    // seed RNG
-    srand(time(NULL));
+    // seed RNG (--seed overrides)
+    rng_seed( time(NULL) );
+    // pick analysis kernels for this cpu
+    dsp_init();
     // instantiate RtAudio object
     RtAudio audio;
     // variables
@@ -165,16 +373,88 @@ int main( int argc, char ** argv )
     // frame size
     unsigned int bufferFrames = 1024;
     
+    // initialize GLUT
+    glutInit( &argc, argv );
+    // our own options
+    parseArgs( argc, argv );
+    // capturing from the input device (not a file, another node or process)
+    bool live = !g_wavPath && !g_subscribeSpec && !g_attachName && g_playlist.empty() && !g_pcmPath;
+    // running the analysis stage wherever the audio is: its frames drive
+    // the motion here, and get published if asked
+    bool analyze = !g_subscribeSpec && !g_attachName;
+
+    if( g_subscribeSpec )
+    {
+        // render-only: frames come from a publisher
+        if( !netfeed_subscribe_open( &g_feed, g_subscribeSpec ) )
+            exit( 1 );
+        cerr << "render-only, subscribed to " << g_subscribeSpec << endl;
+    }
+    else if( g_attachName )
+    {
+        // render-only: blocks come from a local capture process, at its
+        // block size and rate
+        if( !shmbus_attach( &g_bus, g_attachName, false ) )
+            exit( 1 );
+        bufferFrames = shmbus_block_frames( &g_bus );
+        g_srate = shmbus_srate( &g_bus );
+        cerr << "render-only, attached to " << g_attachName << endl;
+    }
+    else if( g_wavPath )
+    {
+        // offline: the file sets the rate, and time advances per frame
+        if( !wav_open( &g_wav, g_wavPath ) )
+            exit( 1 );
+        g_srate = g_wav.srate;
+        if( g_fixedStep <= 0 )
+            g_fixedStep = 1.0 / REF_FPS;
+        // golden runs must be reproducible
+        if( g_goldenDir && !g_seedGiven )
+            rng_seed( 1 );
+    }
+    else if( !g_playlist.empty() )
+    {
+        // playback: the first track sets the rate; no device needed
+        for( size_t i = 0; i < g_playlist.size(); i++ )
+            g_playPaths.push_back( g_playlist[i].c_str() );
+        if( !decoder_open( &g_decoder, &g_playPaths[0], g_playPaths.size(), bufferFrames,
+                           g_decodeAhead, !g_freeRun ) )
+            exit( 1 );
+        g_srate = g_decoder.srate;
+        g_playing = TRUE;
+        cerr << "playing " << g_playPaths.size() << " track(s)"
+             << (g_freeRun ? ", free-running" : "") << endl;
+    }
+    else if( g_pcmPath )
+    {
+        // a pipe: the rate is whatever the writer says it sends
+        if( !decoder_open_pipe( &g_decoder, g_pcmPath, g_pcmFormat, g_pcmRate, g_pcmChannels,
+                                bufferFrames, g_decodeAhead, !g_freeRun ) )
+            exit( 1 );
+        g_srate = g_pcmRate;
+        g_playing = TRUE;
+        cerr << "reading raw PCM from " << (strcmp( g_pcmPath, "-" ) ? g_pcmPath : "stdin")
+             << (g_freeRun ? ", free-running" : "") << endl;
+    }
     // check for audio devices
-    if( audio.getDeviceCount() < 1 )
+    else if( audio.getDeviceCount() < 1 )
     {
         // nopes
         cout << "no audio devices found!" << endl;
         exit( 1 );
     }
     
-    // initialize GLUT
-    glutInit( &argc, argv );
+    if( g_publishSpec )
+    {
+        if( !netfeed_publish_open( &g_feed, g_publishSpec, g_publishOsc ) )
+            exit( 1 );
+        cerr << "publishing feature frames to " << g_publishSpec
+             << (g_publishOsc ? " (osc)" : "") << endl;
+    }
+    
+    // report the seed so a run can be reproduced
+    cerr << "random seed: " << rng_get_seed() << endl;
+    cerr << "dsp kernels: " << dsp_isa() << endl;
     // init gfx
     initGfx();
     
@@ -192,11 +472,20 @@ int main( int argc, char ** argv )
     
     // create stream options
     RtAudio::StreamOptions options;
+    if( g_alsaMmap )
+        options.flags |= RTAUDIO_ALSA_MMAP;
+    // let RtAudio create the callback thread realtime where it can
+    if( threads_config( THREAD_AUDIO )->priority > 0 )
+    {
+        options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+        options.priority = threads_config( THREAD_AUDIO )->priority;
+    }
     
     // go for it
     try {
         // open a stream
-        audio.openStream( &oParams, &iParams, MY_FORMAT, MY_SRATE, &bufferFrames, &callme, (void *)&bufferBytes, &options );
+        if( live )
+            audio.openStream( &oParams, &iParams, MY_FORMAT, MY_SRATE, &bufferFrames, &callme, (void *)&bufferBytes, &options );
     }
     catch( RtError& e )
     {
@@ -207,18 +496,28 @@ int main( int argc, char ** argv )
     
     // compute
     bufferBytes = bufferFrames * MY_CHANNELS * sizeof(SAMPLE);
-    // allocate global buffer
-    g_bufferSize = bufferFrames;
-    g_buffer = new SAMPLE[g_bufferSize];
-    g_fftBuf = new SAMPLE[g_bufferSize];
-    memset( g_buffer, 0, sizeof(SAMPLE) * g_bufferSize );
-    memset( g_fftBuf, 0, sizeof(SAMPLE) * g_bufferSize );
-    
-    // allocate buffer to hold window
-    g_windowSize = bufferFrames;
-    g_window = new SAMPLE[g_windowSize];
-    // generate the window
-    hanning( g_window, g_windowSize );
+    // jitter is measured against one block period
+    health_init( bufferFrames / g_srate );
+    // allocate DSP buffers for the negotiated size
+    allocBuffers( bufferFrames );
+    // the analysis stage works on the same blocks
+    if( g_busName && !shmbus_create( &g_bus, g_busName, bufferFrames, g_srate ) )
+        exit( 1 );
+    // the recorder, before anything that feeds it starts; glut never
+    // returns, so quitting goes through exit() and the file is closed there
+    if( g_recordPath )
+    {
+        if( !recorder_open( &g_recorder, g_recordPath, bufferFrames, g_srate, g_recordDirect ) )
+            exit( 1 );
+        g_recording = TRUE;
+        atexit( recordClose );
+        cerr << "recording the session to " << g_recordPath << endl;
+    }
+    if( analyze )
+        analysis_init( bufferFrames, g_srate, g_publishSpec ? &g_feed : NULL,
+                       g_busName ? &g_bus : NULL, g_recording ? &g_recorder : NULL );
+    if( g_cacheDir )
+        offlineOpenCache( bufferFrames );
     
     // init bass pulses
     for (int i = 0; i < MAX_BASS_PULSES; i++) {
@@ -241,27 +540,34 @@ int main( int argc, char ** argv )
         g_midPulses[i].transZ = 0;
     }
 
-    // array of complex buffers to store history
-    const long COMP_BUF_SIZE = g_bufferSize / 2;
-    // g_FDBufHistory = new complex[MAX_STATES][COMP_BUF_SIZE];
-    for (int i = 0; i < MAX_STATES; i++) {
-        g_FDBufHistory[i] = new complex[COMP_BUF_SIZE];
-        memset(g_FDBufHistory[i], 0, sizeof(complex) * (COMP_BUF_SIZE));
-    }
-
     // print help
     help();
     
     // go for it
     try {
-        // start stream
-        audio.startStream();
+        // start analysis, then the stream that feeds it
+        g_analyzeLive = (live || g_playing) && analyze;
+        if( g_analyzeLive )
+            analysis_start( &g_captureRing );
+        if( live )
+            audio.startStream();
+        if( g_playing )
+            decoder_start( &g_decoder, playBlock, NULL );
+        
+        // place this (render) thread only now, so the audio thread
+        // doesn't inherit its pinning; then say where everything runs
+        threads_apply( THREAD_RENDER );
+        for( int i = 0; i < 50 && (live || g_playing) && (!threads_applied( THREAD_AUDIO ) ||
+             (g_analyzeLive && !threads_applied( THREAD_ANALYSIS ))); i++ )
+            this_thread::sleep_for( chrono::milliseconds( 10 ) );
+        threads_report();
         
         // let GLUT handle the current thread from here
         glutMainLoop();
         
         // stop the stream.
-        audio.stopStream();
+        if( live )
+            audio.stopStream();
     }
     catch( RtError& e )
     {
@@ -274,6 +580,13 @@ cleanup:
     // close if open
     if( audio.isStreamOpen() )
         audio.closeStream();
+    // stop analysis, close the feed, release DSP buffers
+    analysis_free();
+    if( g_publishSpec || g_subscribeSpec )
+        netfeed_close( &g_feed );
+    if( g_busName || g_attachName )
+        shmbus_close( &g_bus );
+    arena_free( &g_dspArena );
     
     // done
     return 0;
@@ -282,6 +595,70 @@ cleanup:
 
 
 
+//-----------------------------------------------------------------------------
+// name: allocBuffers()
+// desc: carve all DSP buffers for a block size out of g_dspArena. call it
+//       again (with the stream stopped) after a restart or device change;
+//       the arena is reused and only grows if the new size needs more
+//-----------------------------------------------------------------------------
+void allocBuffers( long bufferFrames )
+{
+    const long MAG_BUF_SIZE = bufferFrames / 2;
+
+    // room for 16 blocks between the callback and the analysis thread
+    unsigned long ringSize = 1;
+    while( ringSize < 16 * (unsigned long)bufferFrames )
+        ringSize <<= 1;
+
+    // spectrum strips are drawn over whole hundreds of bins, or the bands
+    if( g_specBands > MAG_BUF_SIZE )
+        g_specBands = MAG_BUF_SIZE;
+    g_specPoints = g_specBands ? g_specBands : (MAG_BUF_SIZE / 100) * 100;
+
+    // everything below, with alignment padding
+    size_t bytes = 3 * arena_size( sizeof(SAMPLE) * bufferFrames ) +
+        (MAX_STATES + 1) * arena_size( sizeof(SAMPLE) * MAG_BUF_SIZE ) +
+        arena_size( sizeof(SAMPLE) * ringSize ) +
+        arena_size( sizeof(GLfloat) * 2 * 360 ) +
+        2 * arena_size( sizeof(GLfloat) * 2 * bufferFrames ) +
+        arena_size( sizeof(GLfloat) * 2 * MAX_STATES * g_specPoints ) +
+        (g_specBands ? filterbank_size( g_specBands, MAG_BUF_SIZE ) : 0);
+    arena_reserve( &g_dspArena, bytes );
+
+    // global buffer
+    g_bufferSize = bufferFrames;
+    g_buffer = arena_array<SAMPLE>( &g_dspArena, g_bufferSize );
+    g_fftBuf = arena_array<SAMPLE>( &g_dspArena, g_bufferSize );
+    g_mag = arena_array<SAMPLE>( &g_dspArena, MAG_BUF_SIZE );
+
+    // window
+    g_windowSize = bufferFrames;
+    g_window = arena_array<SAMPLE>( &g_dspArena, g_windowSize );
+    hanning( g_window, g_windowSize );
+
+    // magnitude buffers to store history
+    for (int i = 0; i < MAX_STATES; i++)
+        g_FDBufHistory[i] = arena_array<SAMPLE>( &g_dspArena, MAG_BUF_SIZE );
+    g_nHistoryStates = 0;
+
+    // capture ring
+    ring_init( &g_captureRing, arena_array<SAMPLE>( &g_dspArena, ringSize ), ringSize );
+
+    // geometry, built once per frame and drawn by every window
+    g_circleVerts = arena_array<GLfloat>( &g_dspArena, 2 * 360 );
+    g_waveVerts = arena_array<GLfloat>( &g_dspArena, 2 * bufferFrames );
+    g_horizonVerts = arena_array<GLfloat>( &g_dspArena, 2 * bufferFrames );
+    g_specVerts = arena_array<GLfloat>( &g_dspArena, 2 * MAX_STATES * g_specPoints );
+
+    // perceptual bands for the waterfall, from 30 Hz up
+    if( g_specBands )
+        filterbank_init( &g_filterBank, &g_dspArena, g_specScale, g_specBands,
+                         MAG_BUF_SIZE, g_srate, 30, g_srate / 2 );
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // Name: reshapeFunc( )
 // Desc: called when window size changes
@@ -290,33 +667,55 @@ void initGfx()
 {
     // double buffer, use rgb color, enable depth buffer
     glutInitDisplayMode( GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH );
-    // initialize the window size
-    glutInitWindowSize( g_width, g_height );
-    // set the window postion
-    glutInitWindowPosition( 100, 100 );
-    // create the window
-    glutCreateWindow("Alan's Psychedelic Breakfast");
-    
+
+    // one window per view, each with its own context
+    for( int i = 0; i < g_numViews; i++ )
+    {
+        View & v = g_views[i];
+        // initialize the window size
+        glutInitWindowSize( v.width, v.height );
+        // set the window postion
+        glutInitWindowPosition( v.x, v.y );
+        // create the window
+        char title[64];
+        if( i == 0 )
+            snprintf( title, sizeof(title), "Alan's Psychedelic Breakfast" );
+        else
+            snprintf( title, sizeof(title), "Alan's Psychedelic Breakfast (%d)", i + 1 );
+        v.window = glutCreateWindow( title );
+
+        // set the display function - called when redrawing
+        glutDisplayFunc( displayFunc );
+        // set the reshape function - called when client area changes
+        glutReshapeFunc( reshapeFunc );
+        // set the keyboard function - called on keyboard events
+        glutKeyboardFunc( keyboardFunc );
+        // set the mouse function - called on mouse stuff
+        glutMouseFunc( mouseFunc );
+
+        // set clear color
+        glClearColor( 0, 0, 0, 1 );
+        // enable color material
+        glEnable( GL_COLOR_MATERIAL );
+        // enable depth test
+        glEnable( GL_DEPTH_TEST );
+        // enable blending
+        glEnable(GL_BLEND);
+        glEnable(GL_LINE_SMOOTH);
+        // geometry is drawn from arrays shared by all windows
+        glEnableClientState( GL_VERTEX_ARRAY );
+
+        // fullscreen on whichever display the window was placed on
+        if( v.fullscreen )
+        {
+            v.lastWidth = v.width;
+            v.lastHeight = v.height;
+            glutFullScreen();
+        }
+    }
+
     // set the idle function - called when idleFunc
     glutIdleFunc( idleFunc );
-    // set the display function - called when redrawing
-    glutDisplayFunc( displayFunc );
-    // set the reshape function - called when client area changes
-    glutReshapeFunc( reshapeFunc );
-    // set the keyboard function - called on keyboard events
-    glutKeyboardFunc( keyboardFunc );
-    // set the mouse function - called on mouse stuff
-    glutMouseFunc( mouseFunc );
-    
-    // set clear color
-    glClearColor( 0, 0, 0, 1 );
-    // enable color material
-    glEnable( GL_COLOR_MATERIAL );
-    // enable depth test
-    glEnable( GL_DEPTH_TEST );
-    // enable blending
-    glEnable(GL_BLEND);
-    glEnable(GL_LINE_SMOOTH);
 }
 
 
@@ -329,7 +728,8 @@ void initGfx()
 void reshapeFunc( GLsizei w, GLsizei h )
 {
     // save the new window size
-    g_width = w; g_height = h;
+    View * v = currentView();
+    v->width = w; v->height = h;
     // map the view port to the client area
     glViewport( 0, 0, w, h );
     // set the matrix mode to project
@@ -349,6 +749,93 @@ void reshapeFunc( GLsizei w, GLsizei h )
 
 
 
+//-----------------------------------------------------------------------------
+// Name: defaultView( )
+// Desc: the window we get without --window
+//-----------------------------------------------------------------------------
+View defaultView()
+{
+    View v;
+    v.window = 0;
+    v.width = v.lastWidth = 1024;
+    v.height = v.lastHeight = 720;
+    v.x = v.y = 100;
+    v.fullscreen = FALSE;
+    v.toggleRave = FALSE;
+    v.toggleBassPulses = TRUE;
+    v.toggleMidPulses = TRUE;
+    v.toggleTDWaveform = TRUE;
+    v.toggleFDWaveform = TRUE;
+    v.allowAutoRave = FALSE;
+    v.showOverlay = FALSE;
+    return v;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: parseView( )
+// Desc: <w>x<h>[+<x>+<y>][:<option>...], e.g. 1920x1080+1920+0:fs:no-td
+//       for a fullscreen window without the time domain layer on the
+//       display right of the main one; false if it doesn't parse
+//-----------------------------------------------------------------------------
+bool parseView( const char * spec, View * v )
+{
+    *v = defaultView();
+    int n = 0;
+    if( sscanf( spec, "%ldx%ld%n", &v->width, &v->height, &n ) < 2 ||
+        v->width <= 0 || v->height <= 0 )
+        return false;
+    spec += n;
+    if( *spec == '+' )
+    {
+        n = 0;
+        if( sscanf( spec, "+%d+%d%n", &v->x, &v->y, &n ) < 2 )
+            return false;
+        spec += n;
+    }
+    v->lastWidth = v->width;
+    v->lastHeight = v->height;
+
+    while( *spec == ':' )
+    {
+        spec++;
+        size_t len = strcspn( spec, ":" );
+        string opt( spec, len );
+        spec += len;
+        if( opt == "fs" ) v->fullscreen = TRUE;
+        else if( opt == "no-td" ) v->toggleTDWaveform = FALSE;
+        else if( opt == "no-fd" ) v->toggleFDWaveform = FALSE;
+        else if( opt == "no-bass" ) v->toggleBassPulses = FALSE;
+        else if( opt == "no-mid" ) v->toggleMidPulses = FALSE;
+        else if( opt == "rave" ) v->toggleRave = TRUE;
+        else if( opt == "auto-rave" ) v->allowAutoRave = TRUE;
+        else if( opt == "overlay" ) v->showOverlay = TRUE;
+        else return false;
+    }
+    return *spec == '\0';
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: currentView( )
+// Desc: the view of the window glut is calling us for
+//-----------------------------------------------------------------------------
+View * currentView()
+{
+    int window = glutGetWindow();
+    for( int i = 0; i < g_numViews; i++ )
+        if( g_views[i].window == window )
+            return &g_views[i];
+    return &g_views[0];
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // Name: help( )
 // Desc: print usage
@@ -369,18 +856,325 @@ void help()
     cerr << "'m' - toggle mid pulses" << endl;
     cerr << "'<space bar>' - toggle rave (flashing background) mode" << endl;
     cerr << "'r' - toggle auto-rave mode" << endl;
+    cerr << "'p' - toggle profiler overlay (xruns, callback timing, fps)" << endl;
+    cerr << "----------------------------------------------------" << endl;
+    cerr << "--fixed-step <fps> - advance animation by 1/fps per frame" << endl;
+    cerr << "--seed <n> - seed the random colors for a reproducible run" << endl;
+    cerr << "--wav <file> - render from a WAV file instead of the input device" << endl;
+    cerr << "--play <file|list.m3u> - play WAV/AIFF files (repeat, or a playlist:" << endl;
+    cerr << "    one path a line) back to back instead of the input device" << endl;
+    cerr << "--pcm <s16le|f32le>:<rate>:<channels>[:<path>] - read raw PCM from" << endl;
+    cerr << "    stdin (or a fifo) instead, e.g. ffmpeg -i x -f s16le -ac 2 -ar 44100 -" << endl;
+    cerr << "--free-run - with --play or --pcm, go as fast as the analysis keeps up" << endl;
+    cerr << "    (or, for a live stream, as fast as it comes) instead of real time" << endl;
+    cerr << "--decode-ahead <secs> - with --play or --pcm, how far to read ahead" << endl;
+    cerr << "    (default 2)" << endl;
+    cerr << "--analysis-cache <dir> - keep --wav renders' analysis in <dir>, keyed" << endl;
+    cerr << "    by the audio and settings; renders after the first replay it" << endl;
+    cerr << "--capture <n,n,...> --golden <dir> - compare those frames against" << endl;
+    cerr << "    <dir>/<wav name>-<n>.ppm (--golden-update writes them instead;" << endl;
+    cerr << "    --pixel-tol, --section-tol set the tolerances)" << endl;
+    cerr << "--audio-thread, --analysis-thread, --render-thread, --recorder-thread" << endl;
+    cerr << "    <cpu>[:<prio>]" << endl;
+    cerr << "    - pin a thread to a core and/or give it realtime priority" << endl;
+    cerr << "--no-ftz - keep denormals (ftz/daz is on for all threads by default)" << endl;
+    cerr << "--alsa-mmap - capture from ALSA through its mmap ring (experimental)" << endl;
+    cerr << "--health-log <secs> - capture health log interval (default 10, 0 = off)" << endl;
+    cerr << "--publish <host>:<port>[@<if>] - send feature frames (multicast or" << endl;
+    cerr << "    unicast; @<if> picks the interface, e.g. @127.0.0.1), --osc to" << endl;
+    cerr << "    wrap them as OSC " NETFEED_OSC_ADDRESS " blobs" << endl;
+    cerr << "--subscribe <host>:<port>[@<if>] - render-only: draw another node's" << endl;
+    cerr << "    feature frames, no audio device" << endl;
+    cerr << "--bus <name> - also write frames and raw blocks to shared memory" << endl;
+    cerr << "    (e.g. /apb) for renderer processes on this machine" << endl;
+    cerr << "--attach <name> - render-only: draw from a --bus process's blocks" << endl;
+    cerr << "--record <file>[:direct] - record the session (audio blocks, feature" << endl;
+    cerr << "    frames, frame times) for replaying later; :direct bypasses the" << endl;
+    cerr << "    page cache" << endl;
+    cerr << "--spectrum-bands <n>[:mel|bark|log] - draw the spectrum over n" << endl;
+    cerr << "    perceptual bands (e.g. 96:mel) instead of the raw fft bins" << endl;
+    cerr << "--window <w>x<h>[+<x>+<y>][:fs][:no-td][:no-fd][:no-bass][:no-mid]" << endl;
+    cerr << "    [:rave][:auto-rave][:overlay] - open an output window (repeat for" << endl;
+    cerr << "    more; keys act on the focused one, the first is the one captured)" << endl;
     cerr << "----------------------------------------------------" << endl;
 }
 
 
 
 
+//-----------------------------------------------------------------------------
+// Name: parseArgs( )
+// Desc: handle command line options (after GLUT has taken its own)
+//-----------------------------------------------------------------------------
+void parseArgs( int argc, char ** argv )
+{
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        if( arg == "--fixed-step" && i + 1 < argc )
+        {
+            double fps = atof( argv[++i] );
+            if( fps <= 0 )
+            {
+                cerr << "--fixed-step needs a positive frame rate" << endl;
+                exit( 1 );
+            }
+            g_fixedStep = 1.0 / fps;
+        }
+        else if( arg == "--seed" && i + 1 < argc )
+        {
+            rng_seed( strtoull( argv[++i], NULL, 10 ) );
+            g_seedGiven = TRUE;
+        }
+        else if( arg == "--wav" && i + 1 < argc )
+        {
+            g_wavPath = argv[++i];
+        }
+        else if( arg == "--play" && i + 1 < argc )
+        {
+            playlistAdd( argv[++i] );
+        }
+        else if( arg == "--pcm" && i + 1 < argc )
+        {
+            // <format>:<rate>:<channels>[:<path>]
+            char * spec = argv[++i];
+            char * rate = strchr( spec, ':' );
+            char * end = NULL;
+            if( rate )
+            {
+                *rate++ = '\0';
+                g_pcmRate = strtod( rate, &end );
+                if( *end == ':' )
+                    g_pcmChannels = strtol( end + 1, &end, 10 );
+            }
+            if( !rate || !decoder_parse_format( spec, &g_pcmFormat ) || g_pcmRate <= 0 ||
+                g_pcmChannels < 1 || (*end && *end != ':') )
+            {
+                cerr << "--pcm wants <s16le|f32le>:<rate>:<channels>[:<path>]" << endl;
+                exit( 1 );
+            }
+            g_pcmPath = *end ? end + 1 : "-";
+        }
+        else if( arg == "--free-run" )
+        {
+            g_freeRun = TRUE;
+        }
+        else if( arg == "--decode-ahead" && i + 1 < argc )
+        {
+            g_decodeAhead = atof( argv[++i] );
+        }
+        else if( arg == "--record" && i + 1 < argc )
+        {
+            // <file>[:direct]
+            char * spec = argv[++i];
+            char * opt = strrchr( spec, ':' );
+            if( opt && !strcmp( opt, ":direct" ) )
+            {
+                *opt = '\0';
+                g_recordDirect = TRUE;
+            }
+            g_recordPath = spec;
+        }
+        else if( arg == "--analysis-cache" && i + 1 < argc )
+        {
+            g_cacheDir = argv[++i];
+        }
+        else if( arg == "--capture" && i + 1 < argc )
+        {
+            // comma separated frame numbers
+            for( char * p = argv[++i]; *p; )
+            {
+                g_captureFrames.push_back( strtol( p, &p, 10 ) );
+                if( *p == ',' ) p++;
+                else if( *p ) break;
+            }
+        }
+        else if( arg == "--golden" && i + 1 < argc )
+        {
+            g_goldenDir = argv[++i];
+        }
+        else if( arg == "--golden-update" )
+        {
+            g_goldenUpdate = TRUE;
+        }
+        else if( arg == "--pixel-tol" && i + 1 < argc )
+        {
+            g_goldenPixelTol = atof( argv[++i] );
+        }
+        else if( arg == "--section-tol" && i + 1 < argc )
+        {
+            g_goldenSectionTol = atof( argv[++i] );
+        }
+        else if( (arg == "--audio-thread" || arg == "--analysis-thread" ||
+                  arg == "--render-thread" || arg == "--recorder-thread") && i + 1 < argc )
+        {
+            ThreadRole role = arg == "--audio-thread" ? THREAD_AUDIO :
+                arg == "--analysis-thread" ? THREAD_ANALYSIS :
+                arg == "--render-thread" ? THREAD_RENDER : THREAD_RECORDER;
+            if( !threads_parse( role, argv[++i] ) )
+            {
+                cerr << arg << " wants <cpu>[:<priority>], cpu '-' for unpinned" << endl;
+                exit( 1 );
+            }
+        }
+        else if( arg == "--health-log" && i + 1 < argc )
+        {
+            g_healthLogInterval = atof( argv[++i] );
+        }
+        else if( arg == "--publish" && i + 1 < argc )
+        {
+            g_publishSpec = argv[++i];
+        }
+        else if( arg == "--osc" )
+        {
+            g_publishOsc = TRUE;
+        }
+        else if( arg == "--subscribe" && i + 1 < argc )
+        {
+            g_subscribeSpec = argv[++i];
+        }
+        else if( arg == "--bus" && i + 1 < argc )
+        {
+            g_busName = argv[++i];
+        }
+        else if( arg == "--attach" && i + 1 < argc )
+        {
+            g_attachName = argv[++i];
+        }
+        else if( arg == "--spectrum-bands" && i + 1 < argc )
+        {
+            char * scale;
+            g_specBands = strtol( argv[++i], &scale, 10 );
+            if( g_specBands < 1 || (*scale && (*scale != ':' ||
+                !filterbank_parse_scale( scale + 1, &g_specScale ))) )
+            {
+                cerr << "--spectrum-bands wants <n>[:mel|bark|log], not " << argv[i] << endl;
+                exit( 1 );
+            }
+        }
+        else if( arg == "--window" && i + 1 < argc )
+        {
+            if( g_numViews == MAX_VIEWS )
+            {
+                cerr << "at most " << MAX_VIEWS << " windows" << endl;
+                exit( 1 );
+            }
+            if( !parseView( argv[++i], &g_views[g_numViews] ) )
+            {
+                cerr << "--window wants <w>x<h>[+<x>+<y>][:<option>...], not " << argv[i] << endl;
+                exit( 1 );
+            }
+            g_numViews++;
+        }
+        else if( arg == "--no-ftz" )
+        {
+            for( int r = 0; r < THREAD_NUM_ROLES; r++ )
+                threads_config( (ThreadRole)r )->ftz = false;
+        }
+        else if( arg == "--alsa-mmap" )
+        {
+            g_alsaMmap = TRUE;
+        }
+        else
+        {
+            cerr << "unknown option: " << arg << endl;
+            help();
+            exit( 1 );
+        }
+    }
+
+    // no --window: the one window we always had
+    if( !g_numViews )
+        g_views[g_numViews++] = defaultView();
+
+    if( (g_goldenDir || !g_captureFrames.empty()) &&
+        !(g_wavPath && g_goldenDir && !g_captureFrames.empty()) )
+    {
+        cerr << "--golden and --capture go together, with --wav" << endl;
+        exit( 1 );
+    }
+    if( g_cacheDir && !g_wavPath )
+    {
+        cerr << "--analysis-cache only applies to --wav renders" << endl;
+        exit( 1 );
+    }
+    if( !g_playlist.empty() && (g_wavPath || g_subscribeSpec || g_attachName || g_pcmPath) )
+    {
+        cerr << "--play is the audio source; no --wav, --subscribe, --attach or --pcm" << endl;
+        exit( 1 );
+    }
+    if( g_pcmPath && (g_wavPath || g_subscribeSpec || g_attachName) )
+    {
+        cerr << "--pcm is the audio source; no --wav, --subscribe or --attach" << endl;
+        exit( 1 );
+    }
+    if( g_subscribeSpec && (g_wavPath || g_publishSpec) )
+    {
+        cerr << "--subscribe renders someone else's frames; no --wav or --publish" << endl;
+        exit( 1 );
+    }
+    if( g_attachName && (g_wavPath || g_publishSpec || g_subscribeSpec || g_busName) )
+    {
+        cerr << "--attach renders another process's blocks; no --wav, --publish, "
+             << "--subscribe or --bus" << endl;
+        exit( 1 );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: playlistAdd( )
+// Desc: --play: a .m3u/.m3u8 adds its paths (one a line, '#' lines are
+//       comments, relative ones are from the list's directory), anything
+//       else is a track itself
+//-----------------------------------------------------------------------------
+void playlistAdd( const char * path )
+{
+    string name = path;
+    size_t dot = name.rfind( '.' );
+    string ext = dot == string::npos ? "" : name.substr( dot );
+    if( ext != ".m3u" && ext != ".m3u8" )
+    {
+        g_playlist.push_back( name );
+        return;
+    }
+
+    FILE * list = fopen( path, "r" );
+    if( !list )
+    {
+        cerr << "--play: can't open playlist " << path << endl;
+        exit( 1 );
+    }
+    size_t slash = name.find_last_of( '/' );
+    string dir = slash == string::npos ? "" : name.substr( 0, slash + 1 );
+    char line[4096];
+    while( fgets( line, sizeof(line), list ) )
+    {
+        size_t len = strcspn( line, "\r\n" );
+        line[len] = '\0';
+        if( !len || line[0] == '#' )
+            continue;
+        g_playlist.push_back( line[0] == '/' ? string( line ) : dir + line );
+    }
+    fclose( list );
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // Name: keyboardFunc( )
 // Desc: key event
 //-----------------------------------------------------------------------------
 void keyboardFunc( unsigned char key, int x, int y )
 {
+    (void)x;
+    (void)y;
+    // keys act on the window they were typed into
+    View * v = currentView();
+
     switch( key )
     {
         case 'q': // quit
@@ -394,36 +1188,39 @@ void keyboardFunc( unsigned char key, int x, int y )
         case 's': // toggle fullscreen
         {
             // check fullscreen
-            if( !g_fullscreen )
+            if( !v->fullscreen )
             {
-                g_last_width = g_width;
-                g_last_height = g_height;
+                v->lastWidth = v->width;
+                v->lastHeight = v->height;
                 glutFullScreen();
             }
             else
-                glutReshapeWindow( g_last_width, g_last_height );
+                glutReshapeWindow( v->lastWidth, v->lastHeight );
             
             // toggle variable value
-            g_fullscreen = !g_fullscreen;
+            v->fullscreen = !v->fullscreen;
         }
         break;
         case ' ': // toggle rave mode
-            g_toggleRave = !g_toggleRave;
+            v->toggleRave = !v->toggleRave;
         break;
         case '1': // toggle time domain waveform
-            g_toggleTDWaveform = !g_toggleTDWaveform;
+            v->toggleTDWaveform = !v->toggleTDWaveform;
         break;
         case '2': // toggle freq domain waveform
-            g_toggleFDWaveform = !g_toggleFDWaveform;
+            v->toggleFDWaveform = !v->toggleFDWaveform;
         break;
         case 'b': // toggle bass pulses
-            g_toggleBassPulses = !g_toggleBassPulses;
+            v->toggleBassPulses = !v->toggleBassPulses;
         break;
         case 'm': // toggle mid pulses
-            g_toggleMidPulses = !g_toggleMidPulses;
+            v->toggleMidPulses = !v->toggleMidPulses;
         break;
         case 'r': // toggle auto rave
-            g_allowAutoRave = !g_allowAutoRave;
+            v->allowAutoRave = !v->allowAutoRave;
+        break;
+        case 'p': // toggle profiler overlay
+            v->showOverlay = !v->showOverlay;
         break;
     }
     
@@ -440,6 +1237,8 @@ void keyboardFunc( unsigned char key, int x, int y )
 //-----------------------------------------------------------------------------
 void mouseFunc( int button, int state, int x, int y )
 {
+    (void)x;
+    (void)y;
     if( button == GLUT_LEFT_BUTTON )
     {
         // when left mouse button is down
@@ -476,90 +1275,921 @@ void mouseFunc( int button, int state, int x, int y )
 //-----------------------------------------------------------------------------
 void idleFunc( )
 {
-    // render the scene
-    glutPostRedisplay( );
-}
-
-const float DEG2RAD = 3.14159 / 180;
- 
-void drawCircle(float radius) {
-    glBegin(GL_LINE_LOOP);
-    for (int i = 180; i < 361; i++) {
-        float degInRad = i*DEG2RAD;
-        glVertex2f(cos(degInRad) * radius, sin(degInRad) * radius);
-    }
-    glEnd();
+    // render the scene (the first window's redraw brings the others along)
+    glutPostWindowRedisplay( g_views[0].window );
 }
 
-void drawSemiCircle(float radius) {
-    glBegin(GL_LINE_LOOP);
-    for (int i = 0; i < 181; i++) {
-        float degInRad = i*DEG2RAD;
-        glVertex2f(cos(degInRad) * radius, sin(degInRad) * radius);
-    }
-    glEnd();
-}
 
-Colorf g_centralCol;
-int g_centralColTracker = 0;
-Colorf g_secondaryCol;
-int g_secondaryColTracker = 0;
 
-GLboolean g_forceRave = false;
 
 //-----------------------------------------------------------------------------
-// Name: displayFunc( )
-// Desc: callback function invoked to draw the client area
+// Name: advanceClock( )
+// Desc: measure the time step for this frame; all animation state is
+//       integrated over g_dt so the look doesn't depend on the frame rate
 //-----------------------------------------------------------------------------
-void displayFunc( )
+void advanceClock( )
 {
-    // calculate central color
-    if (g_centralColTracker % 6 == 0) {
-        g_centralCol.red = (rand() % 6 / 100.00) + 0.94;
-        g_centralCol.green = (rand() % 5 / 100.00) + 0.45;
-        g_centralCol.blue = (rand() % 5 / 100.00) + 0.01;
-        
-        g_secondaryCol.red = 1.0;
-        g_secondaryCol.green = 1.0;;
-        g_secondaryCol.blue = 1.0;;
-        g_secondaryColTracker++;
+    if( g_fixedStep > 0 )
+        g_dt = g_fixedStep;
+    else
+    {
+        double now = chrono::duration<double>(
+            chrono::steady_clock::now().time_since_epoch() ).count();
+        g_dt = g_lastTime < 0 ? 1.0 / REF_FPS : now - g_lastTime;
+        g_lastTime = now;
+        if( g_dt > MAX_STEP )
+            g_dt = MAX_STEP;
+        else if( g_dt < 0 )
+            g_dt = 0;
     }
-    g_centralColTracker++;
+    g_frameScale = g_dt * REF_FPS;
+}
 
 
-    // calculate average value of TD waveform
-    float avgTDWaveformVal = 0;
-    for (int i = 0; i < g_bufferSize; i++) {
-        avgTDWaveformVal += ::fabs(g_buffer[i]);
-    }
-    avgTDWaveformVal /= g_bufferSize;
 
-    // cerr << "avgTDWaveformVal = " << avgTDWaveformVal << endl;
 
-    g_flashFR = floor(pow(5000 * avgTDWaveformVal, 0.5) * 2);
-    // cerr << g_flashFR << endl;
+//-----------------------------------------------------------------------------
+// Name: offlineReadBlock( )
+// Desc: fill g_buffer from the file, advancing by one frame's worth of audio
+//-----------------------------------------------------------------------------
+void offlineReadBlock( )
+{
+    if( (long)g_offlinePos + g_bufferSize > g_wav.frames )
+        offlineFinish();
+    // float32 mono: the analysis reads the block where it lies in the
+    // file's mapping, and only the renderer (which windows in place)
+    // copies it. anything else converts once, windowed for the analysis
+    // on the way (into g_fftBuf, which is free offline)
+    long pos = (long)g_offlinePos;
+    const float * view = wav_view( &g_wav, pos, g_bufferSize );
+    if( view )
+        memcpy( g_buffer, view, sizeof(SAMPLE) * g_bufferSize );
+    else if( g_cacheReplay )
+        wav_read( &g_wav, pos, g_buffer, g_bufferSize );
+    else
+        wav_read_windowed( &g_wav, pos, g_window, g_buffer, g_fftBuf, g_bufferSize );
+    if( g_recording )
+        recorder_audio( &g_recorder, g_buffer, g_bufferSize, netfeed_clock() );
+    if( g_cacheReplay )
+    {
+        // analyzed before: look it up
+        featcache_read( &g_cache, g_offlineIndex, &g_cacheFrame, g_mag );
+        analysis_replay( &g_cacheFrame, g_mag, g_buffer, netfeed_clock() );
+    }
+    else
+    {
+        // analyze the same block, in step with the render
+        if( view )
+            analysis_block( view, g_offlinePos / g_srate, netfeed_clock() );
+        else
+            analysis_block_windowed( g_buffer, g_fftBuf, g_offlinePos / g_srate, netfeed_clock() );
+        if( g_cache.writer )
+        {
+            analysis_latest( &g_cacheFrame );
+            analysis_latest_spectrum( g_mag, g_bufferSize / 2 );
+            featcache_write( &g_cache, g_offlineIndex, &g_cacheFrame, g_mag );
+        }
+    }
+    g_offlineIndex++;
+    g_offlinePos += g_srate * g_dt;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: offlineOpenCache( )
+// Desc: key the cache on the audio and the analysis settings (the frame
+//       step included: the frames count hops of it), then map the one
+//       there is or start one
+//-----------------------------------------------------------------------------
+void offlineOpenCache( long bufferFrames )
+{
+    FeatCacheKey key;
+    key.content = wav_hash( &g_wav );
+    key.srate = g_srate;
+    key.blockFrames = bufferFrames;
+    key.step = g_srate * g_fixedStep;
+    // as many as offlineReadBlock() will read
+    key.frames = 0;
+    for( double pos = 0; (long)pos + bufferFrames <= g_wav.frames; pos += key.step )
+        key.frames++;
+
+    if( featcache_open( &g_cache, g_cacheDir, &key ) )
+    {
+        g_cacheReplay = TRUE;
+        cerr << "analysis cache: replaying " << g_cache.path << endl;
+    }
+    else if( featcache_create( &g_cache, g_cacheDir, &key ) )
+        cerr << "analysis cache: writing " << g_cache.path << endl;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: feedReadBlock( )
+// Desc: render-only: take the newest feature frame off the network and
+//       rebuild g_buffer and g_mag from it. with nothing new for a while,
+//       the last frame fades out, so a dead feed goes quiet, not frozen
+//-----------------------------------------------------------------------------
+void feedReadBlock( )
+{
+    double now = health_now();
+    if( netfeed_receive( &g_feed, &g_feedFrame ) > 0 )
+    {
+        g_feedLastRx = now;
+        if( g_recording )
+            recorder_feature( &g_recorder, &g_feedFrame );
+    }
+    else if( g_feedLastRx >= 0 && now - g_feedLastRx > FEED_HOLD )
+    {
+        float fade = pow( FEED_FADE, g_frameScale );
+        g_feedFrame.level *= fade;
+        g_feedFrame.momentary += 20 * log10( fade );
+        g_feedFrame.flux *= fade;
+        for( int i = 0; i < FEATURE_SPECTRUM; i++ )
+            g_feedFrame.spectrum[i] *= fade;
+        for( int i = 0; i < FEATURE_WAVEFORM; i++ )
+            g_feedFrame.waveform[i] *= fade;
+    }
+
+    // waveform: linear interpolation up to the block size
+    for( long i = 0; i < g_bufferSize; i++ )
+    {
+        float pos = (float)i * FEATURE_WAVEFORM / g_bufferSize;
+        int j = (int)pos;
+        float next = j + 1 < FEATURE_WAVEFORM ? g_feedFrame.waveform[j + 1] : g_feedFrame.waveform[j];
+        g_buffer[i] = g_feedFrame.waveform[j] + (next - g_feedFrame.waveform[j]) * (pos - j);
+    }
+    // spectrum: each decimated bin held across the bins it stands for
+    long bins = g_windowSize / 2;
+    for( long i = 0; i < bins; i++ )
+        g_mag[i] = g_feedFrame.spectrum[i * FEATURE_SPECTRUM / bins];
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: busReadBlock( )
+// Desc: render-only from the shared memory bus: the newest raw block goes
+//       into g_buffer and everything downstream runs as if it had been
+//       captured here. without new blocks g_buffer just sits, as it does
+//       when the callback falls behind; after a while we re-attach, in
+//       case the writer was restarted
+//-----------------------------------------------------------------------------
+void busReadBlock( )
+{
+    double now = health_now();
+    long frames;
+    if( g_bus.header && shmbus_read( &g_bus, &g_feedFrame, g_buffer, g_bufferSize, &frames ) )
+    {
+        for( long i = frames; i < g_bufferSize; i++ )
+            g_buffer[i] = 0;
+        g_feedLastRx = now;
+        if( g_recording )
+        {
+            recorder_audio( &g_recorder, g_buffer, frames, netfeed_clock() );
+            recorder_feature( &g_recorder, &g_feedFrame );
+        }
+    }
+    else if( now - (g_feedLastRx > g_busLastTry ? g_feedLastRx : g_busLastTry) > BUS_REATTACH )
+    {
+        shmbus_reattach( &g_bus );
+        g_busLastTry = now;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: latestLoudness( )
+// Desc: momentary loudness (LUFS) of the newest feature frame, wherever
+//       frames come from here; the floor until there is one
+//-----------------------------------------------------------------------------
+float latestLoudness( )
+{
+    if( g_subscribeSpec || g_attachName )
+        return g_feedLastRx >= 0 ? g_feedFrame.momentary : LOUDNESS_FLOOR;
+    FeatureFrame f;
+    return analysis_latest( &f ) ? f.momentary : LOUDNESS_FLOOR;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: offlineCaptureFrame( )
+// Desc: read back the finished frame if it's one we were asked to capture,
+//       then store it as a golden image or compare it to the stored one
+//-----------------------------------------------------------------------------
+void offlineCaptureFrame( )
+{
+    bool wanted = false;
+    for( size_t i = 0; i < g_captureFrames.size(); i++ )
+        wanted = wanted || g_captureFrames[i] == g_frameNumber;
+    if( !wanted )
+        return;
+
+    // read back the frame, flipped to top row first
+    long w = g_views[0].width, h = g_views[0].height;
+    vector<unsigned char> rgb( w * h * 3 ), flipped( w * h * 3 );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadBuffer( GL_BACK );
+    glReadPixels( 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, &rgb[0] );
+    for( long y = 0; y < h; y++ )
+        memcpy( &flipped[y * w * 3], &rgb[(h - 1 - y) * w * 3], w * 3 );
+
+    // <dir>/<wav name without directory or extension>-<frame>.ppm
+    string name = g_wavPath;
+    size_t slash = name.find_last_of( "/\\" );
+    if( slash != string::npos ) name = name.substr( slash + 1 );
+    size_t dot = name.rfind( '.' );
+    if( dot != string::npos ) name = name.substr( 0, dot );
+    char frame[32];
+    snprintf( frame, sizeof(frame), "-%ld.ppm", g_frameNumber );
+    name += frame;
+    string path = string( g_goldenDir ) + "/" + name;
+
+    if( g_goldenUpdate )
+    {
+        if( golden_write_ppm( path.c_str(), w, h, &flipped[0] ) )
+            cerr << "golden: wrote " << path << endl;
+        else
+            g_goldenFailed++;
+        return;
+    }
+
+    long gw, gh;
+    vector<unsigned char> expected;
+    g_goldenChecked++;
+    if( !golden_read_ppm( path.c_str(), gw, gh, expected ) )
+    {
+        cerr << "golden: " << name << ": FAIL (no golden image " << path << ")" << endl;
+        g_goldenFailed++;
+        return;
+    }
+    GoldenReport report;
+    golden_compare( &expected[0], gw, gh, &flipped[0], w, h,
+                    g_goldenPixelTol, g_goldenSectionTol, report );
+    golden_print( name.c_str(), report, g_goldenSectionTol );
+    if( !report.pass )
+        g_goldenFailed++;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: offlineFinish( )
+// Desc: end of file; summarize and exit (nonzero if any golden frame failed)
+//-----------------------------------------------------------------------------
+void offlineFinish( )
+{
+    // we leave the frame's no-alloc section for good
+    ALLOC_CHECK_END();
+    wav_close( &g_wav );
+    if( g_cacheDir )
+        featcache_close( &g_cache );
+    if( g_goldenDir )
+    {
+        // frames we never reached count as failures
+        for( size_t i = 0; i < g_captureFrames.size(); i++ )
+            if( g_captureFrames[i] >= g_frameNumber )
+            {
+                cerr << "golden: frame " << g_captureFrames[i] << " is past the end of "
+                     << g_wavPath << endl;
+                g_goldenFailed++;
+            }
+        if( !g_goldenUpdate )
+            cerr << "golden: " << g_goldenChecked - g_goldenFailed << "/"
+                 << g_goldenChecked << " frames match" << endl;
+    }
+    exit( g_goldenFailed ? 1 : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Name: playFinish( )
+// Desc: the playlist has played out, or the pipe closed; say how it went
+//       and exit
+//-----------------------------------------------------------------------------
+void playFinish( )
+{
+    ALLOC_CHECK_END();
+    char line[256];
+    decoder_format( &g_decoder, line, sizeof(line) );
+    cerr << "play: done, " << line << endl;
+    decoder_close( &g_decoder );
+    exit( 0 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: recordClose( )
+// Desc: at exit: let the recorder's writer drain and close the file
+//-----------------------------------------------------------------------------
+void recordClose( )
+{
+    g_recording = FALSE;
+    recorder_close( &g_recorder );
+    char line[128];
+    recorder_format( &g_recorder, line, sizeof(line) );
+    cerr << "record: " << g_recordPath << ", " << line << endl;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: healthTick( )
+// Desc: once per frame: track render frame timing, and every
+//       g_healthLogInterval seconds log the capture health
+//-----------------------------------------------------------------------------
+void healthTick( )
+{
+    double now = health_now();
+    if( g_frameWallLast >= 0 )
+    {
+        double interval = now - g_frameWallLast;
+        g_frameWallAvg = g_frameWallAvg > 0 ? 0.95 * g_frameWallAvg + 0.05 * interval : interval;
+        if( interval > g_frameWallMax )
+            g_frameWallMax = interval;
+    }
+    g_frameWallLast = now;
+
+    if( g_healthLogInterval <= 0 || g_wavPath )
+        return;
+    if( g_healthLastLog < 0 )
+        g_healthLastLog = now;
+    if( now - g_healthLastLog < g_healthLogInterval )
+        return;
+
+    HealthStats stats;
+    char line[256];
+    if( !g_subscribeSpec && !g_attachName )
+    {
+        health_snapshot( &stats );
+        health_format( &stats, line, sizeof(line) );
+        fprintf( stderr, "health: %s, render worst frame %.1fms\n", line, g_frameWallMax * 1000 );
+    }
+    else
+        fprintf( stderr, "health: render-only, render worst frame %.1fms\n", g_frameWallMax * 1000 );
+    if( g_publishSpec || g_subscribeSpec )
+    {
+        NetFeedStats feed;
+        netfeed_stats( &g_feed, &feed );
+        netfeed_format( &feed, g_subscribeSpec != NULL, line, sizeof(line) );
+        fprintf( stderr, "feed: %s", line );
+        if( g_publishSpec )
+            fprintf( stderr, ", capture ring dropped %lu samples", ring_dropped( &g_captureRing ) );
+        fprintf( stderr, "\n" );
+    }
+    if( g_busName || g_attachName )
+    {
+        shmbus_format( &g_bus, line, sizeof(line) );
+        fprintf( stderr, "bus: %s\n", line );
+    }
+    if( g_recording )
+    {
+        recorder_format( &g_recorder, line, sizeof(line) );
+        fprintf( stderr, "record: %s\n", line );
+    }
+    if( g_playing )
+    {
+        decoder_format( &g_decoder, line, sizeof(line) );
+        fprintf( stderr, "play: %s\n", line );
+    }
+    g_healthLastLog = now;
+    g_frameWallMax = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: drawOverlay( )
+// Desc: profiler overlay, top left, in window pixels
+//-----------------------------------------------------------------------------
+void drawOverlay( const View & view )
+{
+    const int NUM_LINES = 12;
+    // wider than the 128-byte status lines nested under a 10-column label
+    char lines[NUM_LINES][160];
+    HealthStats s;
+    health_snapshot( &s );
+
+    bool renderOnly = g_subscribeSpec || g_attachName;
+    if( g_wavPath || renderOnly )
+    {
+        if( g_wavPath )
+            snprintf( lines[0], sizeof(lines[0]), "capture   offline (%s)", g_wavPath );
+        else
+            snprintf( lines[0], sizeof(lines[0]), "capture   none, render-only from %s",
+                      g_subscribeSpec ? g_subscribeSpec : g_attachName );
+        lines[1][0] = lines[2][0] = lines[3][0] = '\0';
+    }
+    else
+    {
+        if( g_playing )
+        {
+            char line[128];
+            decoder_format( &g_decoder, line, sizeof(line) );
+            snprintf( lines[0], sizeof(lines[0]), "play      %s", line );
+        }
+        else
+            snprintf( lines[0], sizeof(lines[0]), "capture   %ld frames @ %.0f Hz (period %.1f ms)",
+                      g_bufferSize, g_srate, s.period * 1000 );
+        snprintf( lines[1], sizeof(lines[1]), "xruns     %lu in / %lu out over %lu blocks",
+                  s.overflows, s.underflows, s.callbacks );
+        snprintf( lines[2], sizeof(lines[2]), "callback  p50 <%.2f ms  p99 <%.2f ms  max %.2f ms",
+                  health_percentile( s.duration, 0.5 ) * 1000,
+                  health_percentile( s.duration, 0.99 ) * 1000, s.durationMax * 1000 );
+        snprintf( lines[3], sizeof(lines[3]), "jitter    p50 <%.2f ms  p99 <%.2f ms  max %.2f ms",
+                  health_percentile( s.jitter, 0.5 ) * 1000,
+                  health_percentile( s.jitter, 0.99 ) * 1000, s.jitterMax * 1000 );
+    }
+    snprintf( lines[4], sizeof(lines[4]), "render    %.1f fps, worst frame %.1f ms",
+              g_frameWallAvg > 0 ? 1.0 / g_frameWallAvg : 0.0, g_frameWallMax * 1000 );
+    // feature frames: the newest one, and how the feed is doing
+    FeatureFrame f;
+    for( int i = 5; i < NUM_LINES; i++ )
+        lines[i][0] = '\0';
+    if( renderOnly ? g_feedLastRx >= 0 : analysis_latest( &f ) )
+    {
+        const FeatureFrame & cur = renderOnly ? g_feedFrame : f;
+        // strongest semitone, if anything rings
+        static const char * NOTES[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+        int top = 0;
+        for( int i = 1; i < FEATURE_SEMITONES; i++ )
+            if( cur.semitones[i] > cur.semitones[top] )
+                top = i;
+        char note[16] = "-";
+        if( cur.semitones[top] > 0.01f )
+            snprintf( note, sizeof(note), "%s%d", NOTES[top % 12], top / 12 + 1 );
+        snprintf( lines[5], sizeof(lines[5]), "features  #%u level %.3f, onset %s, tempo %.0f bpm, note %s",
+                  cur.seq, cur.level, cur.onset ? "*" : "-", cur.tempo, note );
+        char key[16], chord[16], pitch[24] = "-";
+        if( cur.voiced )
+            snprintf( pitch, sizeof(pitch), "%.1f Hz (%.2f)", cur.pitch, cur.pitchClarity );
+        snprintf( lines[6], sizeof(lines[6]), "harmony   key %s, chord %s, pitch %s",
+                  harmony_name( cur.key, key, sizeof(key) ),
+                  harmony_name( cur.chord, chord, sizeof(chord) ), pitch );
+        snprintf( lines[7], sizeof(lines[7]),
+                  "loudness  %.1f LUFS (short-term %.1f), rms %.1f dB, peak %.1f dB, true peak %.1f dB",
+                  cur.momentary, cur.shortTerm, 20 * log10( cur.rms + 1e-6f ),
+                  20 * log10( cur.peak + 1e-6f ), 20 * log10( cur.truePeak + 1e-6f ) );
+        snprintf( lines[8], sizeof(lines[8]),
+                  "spectrum  centroid %.0f Hz, spread %.0f Hz, rolloff %.0f Hz, flatness %.3f, flux %.3f",
+                  cur.centroid, cur.spread, cur.rolloff, cur.flatness, cur.flux );
+    }
+    if( g_publishSpec || g_subscribeSpec )
+    {
+        NetFeedStats feed;
+        char line[128];
+        netfeed_stats( &g_feed, &feed );
+        netfeed_format( &feed, g_subscribeSpec != NULL, line, sizeof(line) );
+        snprintf( lines[9], sizeof(lines[9]), "feed      %s", line );
+    }
+    if( g_busName || g_attachName )
+    {
+        char line[128];
+        shmbus_format( &g_bus, line, sizeof(line) );
+        snprintf( lines[10], sizeof(lines[10]), "bus       %s", line );
+    }
+    if( g_recording )
+    {
+        char line[128];
+        recorder_format( &g_recorder, line, sizeof(line) );
+        snprintf( lines[11], sizeof(lines[11]), "record    %s", line );
+    }
+
+    // pixel coordinates, origin bottom left
+    glMatrixMode( GL_PROJECTION );
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D( 0, view.width, 0, view.height );
+    glMatrixMode( GL_MODELVIEW );
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable( GL_DEPTH_TEST );
+
+    glColor3f( 1, 1, 1 );
+    for( int i = 0, y = view.height - 20; i < NUM_LINES; i++ )
+    {
+        if( !lines[i][0] )
+            continue;
+        glRasterPos2i( 10, y );
+        for( const char * c = lines[i]; *c; c++ )
+            glutBitmapCharacter( GLUT_BITMAP_8_BY_13, *c );
+        y -= 15;
+    }
+
+    glEnable( GL_DEPTH_TEST );
+    glPopMatrix();
+    glMatrixMode( GL_PROJECTION );
+    glPopMatrix();
+    glMatrixMode( GL_MODELVIEW );
+}
+
+const float DEG2RAD = 3.14159 / 180;
+ 
+void drawCircle(float radius) {
+    glBegin(GL_LINE_LOOP);
+    for (int i = 180; i < 361; i++) {
+        float degInRad = i*DEG2RAD;
+        glVertex2f(cos(degInRad) * radius, sin(degInRad) * radius);
+    }
+    glEnd();
+}
+
+void drawSemiCircle(float radius) {
+    glBegin(GL_LINE_LOOP);
+    for (int i = 0; i < 181; i++) {
+        float degInRad = i*DEG2RAD;
+        glVertex2f(cos(degInRad) * radius, sin(degInRad) * radius);
+    }
+    glEnd();
+}
+
+Colorf g_centralCol;
+float g_centralColTimer = 0;
+Colorf g_secondaryCol;
+int g_secondaryColTracker = 0;
+
+GLboolean g_forceRave = false;
+
+// what a frame draws, worked out once by updateFrame() for every window
+struct DrawState {
+    Colorf raveCol;             // background, when raving on a flash
+    Colorf lineCol[2];          // slower and faster waveform lines
+    float zRotWavesC;           // rotations as of this frame
+    float zRotWaves;
+    float zRotWaves2;
+    int scalePicks[MAX_STATES]; // spectrum scaling per history state
+};
+DrawState g_drawState;
+
+//-----------------------------------------------------------------------------
+// Name: displayFunc( )
+// Desc: callback function invoked to draw the client area. the first
+//       window moves the frame on, then has the others redraw it
+//-----------------------------------------------------------------------------
+void displayFunc( )
+{
+    View * view = currentView();
+    bool lead = view == &g_views[0];
+
+    if( lead )
+    {
+        updateFrame();
+        for( int i = 1; i < g_numViews; i++ )
+            glutPostWindowRedisplay( g_views[i].window );
+    }
+    drawView( *view );
+
+    // capture health: overlay on request
+    if( view->showOverlay )
+        drawOverlay( *view );
+
+    // flush!
+    glFlush( );
+    if( lead )
+    {
+        // grab the frame before it's swapped away
+        if( g_goldenDir )
+            offlineCaptureFrame();
+        g_frameNumber++;
+    }
+    // swap the double buffer
+    glutSwapBuffers( );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: updateFrame( )
+// Desc: once per frame, whatever the number of windows: read the audio,
+//       analyze it, advance the animation and build the shared geometry.
+//       a layer's state moves on if any window shows it
+//-----------------------------------------------------------------------------
+void updateFrame( )
+{
+    // nothing per frame may touch the heap (checked with APB_ALLOC_CHECK)
+    ALLOC_CHECK_BEGIN();
+    // time step for this frame
+    advanceClock();
+    if( g_recording )
+        recorder_frame( &g_recorder, g_frameNumber, g_dt, g_wavPath ? g_offlinePos / g_srate : 0,
+                        netfeed_clock() );
+    // playback: the last block has gone to the analysis
+    if( g_playing && decoder_finished( &g_decoder ) )
+        playFinish();
+    // offline: pull this frame's audio from the file
+    if( g_wavPath )
+        offlineReadBlock();
+    // render-only: rebuild it from the newest feature frame
+    else if( g_subscribeSpec )
+        feedReadBlock();
+    // render-only: take the newest block off the bus
+    else if( g_attachName )
+        busReadBlock();
+    // per-frame decay of pulse colors, as a factor over g_dt
+    float pulseDecay = pow(1 - 0.005, g_frameScale);
+
+    // calculate central color (every 6 reference frames)
+    if (g_centralColTimer <= 0) {
+        g_centralCol.red = (rng_int(RNG_CENTRAL_COLOR, 6) / 100.00) + 0.94;
+        g_centralCol.green = (rng_int(RNG_CENTRAL_COLOR, 5) / 100.00) + 0.45;
+        g_centralCol.blue = (rng_int(RNG_CENTRAL_COLOR, 5) / 100.00) + 0.01;
+        
+        g_secondaryCol.red = 1.0;
+        g_secondaryCol.green = 1.0;;
+        g_secondaryCol.blue = 1.0;;
+        g_secondaryColTracker++;
+        g_centralColTimer += 6;
+        if (g_centralColTimer < 0)
+            g_centralColTimer = 0;
+    }
+    g_centralColTimer -= g_frameScale;
+
+
+    // drive the motion from the momentary loudness of the newest feature
+    // frame, back on the scale it was tuned on: mean |x| (of a sine, 0.9
+    // of its rms)
+    float avgTDWaveformVal = MEAN_ABS_PER_RMS * loudness_amplitude( latestLoudness() );
+
+    // cerr << "avgTDWaveformVal = " << avgTDWaveformVal << endl;
+
+    g_flashFR = floor(pow(5000 * avgTDWaveformVal, 0.5) * 2);
+    // cerr << g_flashFR << endl;
 
     if (g_flashFrame > g_flashFR) {
         g_flashFrame = 0;
         g_flash = !g_flash;
     }
-    g_flashFrame++;
+    g_flashFrame += g_frameScale;
 
     if (avgTDWaveformVal > 0.015)
         g_forceRave = true;
     else 
         g_forceRave = FALSE;
 
-    // local state
-    static GLfloat zrot = 0.0f, c = 0.0f;
+    // which layers any window shows
+    GLboolean rave = FALSE, td = FALSE, fd = FALSE, bass = FALSE, mid = FALSE;
+    for( int i = 0; i < g_numViews; i++ )
+    {
+        const View & v = g_views[i];
+        rave = rave || v.toggleRave || (g_forceRave && v.allowAutoRave);
+        td = td || v.toggleTDWaveform;
+        fd = fd || v.toggleFDWaveform;
+        bass = bass || v.toggleBassPulses;
+        mid = mid || v.toggleMidPulses;
+    }
+
+    // rave background color
+    if (rave && g_flash) {
+        // draw in a fixed order (argument evaluation order is unspecified)
+        g_drawState.raveCol.red = rng_int(RNG_RAVE_COLOR, 100) / 100.00;
+        g_drawState.raveCol.green = rng_int(RNG_RAVE_COLOR, 100) / 100.00;
+        g_drawState.raveCol.blue = rng_int(RNG_RAVE_COLOR, 100) / 100.00;
+    }
+
+    if (td) {
+        // time domain waveform circular, from the raw block
+        for (int i = 0; i < 360; i++)
+        {
+            float degInRad = i * DEG2RAD;
+            g_circleVerts[2 * i] = cos(degInRad) * (g_rad + (1 * g_buffer[i + 360]));
+            g_circleVerts[2 * i + 1] = sin(degInRad) * (g_rad + (1 * g_buffer[i + 360]));
+        }
+        // pulsate the circle
+        if (g_rad >= 1.4) {
+            g_deltaRad = -(pow(avgTDWaveformVal, 0.4) / 25.0);
+            // g_deltaRad = -0.0075;
+        }
+        else if (g_rad <= 1.2) {
+            g_deltaRad = (pow(avgTDWaveformVal, 0.4) / 25.0);
+            // g_deltaRad = 0.005;
+        }
+        g_rad += g_deltaRad * g_frameScale;
+        g_drawState.zRotWavesC = g_zRotWavesC;
+        g_zRotWavesC += 0.3 * g_frameScale;
+    }
+
+    // apply window to buf
+    dsp_apply_window( g_buffer, g_window, g_windowSize );
+
+    if (td) {
+        // time domain waveform line plot
+        // define a starting point
+        GLfloat x = -8;
+        // compute increment
+        GLfloat xinc = ::fabs(x*2 / g_bufferSize);
+        for( int i = 0; i < g_bufferSize; i++ )
+        {
+            g_waveVerts[2 * i] = x;
+            g_waveVerts[2 * i + 1] = ((10 * g_buffer[i]));
+            x += xinc;
+        }
+        // horizon line
+        x = -7;
+        for( int i = 0; i < g_bufferSize; i++ )
+        {
+            g_horizonVerts[2 * i] = x;
+            g_horizonVerts[2 * i + 1] = g_buffer[i];
+            x += xinc;
+        }
+
+        // random colors for the slower and faster lines
+        for (int k = 0; k < 2; k++) {
+            // draw in a fixed order (argument evaluation order is unspecified)
+            g_drawState.lineCol[k].red = rng_int(RNG_LINE_COLOR, 100) / 100.00;
+            g_drawState.lineCol[k].green = rng_int(RNG_LINE_COLOR, 100) / 100.00;
+            g_drawState.lineCol[k].blue = rng_int(RNG_LINE_COLOR, 100) / 100.00;
+        }
+
+        g_drawState.zRotWaves = g_zRotWaves;
+        // g_zRotWaves += ((rand() % 100) / 100.00) + 1;
+        g_zRotWaves += pow((avgTDWaveformVal * 100.00), 0.15) * 2 * g_frameScale;
+        g_drawState.zRotWaves2 = g_zRotWaves2;
+        // g_zRotWaves2 -= ((rand() % 400) / 100.00) + 2;
+        g_zRotWaves2 -= pow((avgTDWaveformVal * 100.00), 0.15) * 3 * g_frameScale;
+    }
     
-    // clear the color and depth buffers
-    if (g_toggleRave || (g_forceRave && g_allowAutoRave)) {
-        if (g_flash)
-            glClearColor(((rand() % 100) / 100.00), ((rand() % 100) / 100.00), ((rand() % 100) / 100.00), 1.0);
-        else 
-            glClearColor(0.0, 0.0, 0.0, 1.0);
+    // the magnitudes, once for all the consumers below: the analysis
+    // stage's, which took them from this same (windowed) block; from the
+    // feed, g_mag already came with the frame; only the bus's raw block
+    // still needs its own transform
+    if( g_attachName ) {
+        memcpy( g_fftBuf, g_buffer, sizeof(SAMPLE) * g_bufferSize );
+        dsp_rfft( g_fftBuf, g_windowSize / 2, FFT_FORWARD );
+        dsp_magnitude( (complex *)g_fftBuf, g_mag, g_windowSize / 2 );
+    }
+    else if( !g_subscribeSpec ) {
+        if( !analysis_latest_spectrum( g_mag, g_windowSize / 2 ) )
+            memset( g_mag, 0, sizeof(SAMPLE) * (g_windowSize / 2) );
+    }
+
+// BASS PULSES
+    if (bass) {
+        // check for bass pulses
+        for (int i = 0; i < ((g_windowSize / 2) / 100) * 4; i++) {
+            if (g_mag[i] > 0.001) {
+                g_bassPulseCounter += g_frameScale;
+                if (g_bassPulseCounter >= BASS_PULSE_STAGGER) {
+                    g_bassPulseCounter -= BASS_PULSE_STAGGER;
+                    // cerr << g_mag[i] << endl;
+                    int g_bassPulseLastIndex = ((g_bassPulseIndex == 0) ? MAX_BASS_PULSES : g_bassPulseIndex) - 1;
+                    for (int j = g_bassPulseIndex; j != g_bassPulseLastIndex; j = (j + 1) % MAX_BASS_PULSES) {
+                        if (j == g_bassPulseIndex) {
+                            // cerr << ". ";
+                            g_bassPulses[j].on = true;
+                            g_bassPulses[j].rad = g_rad * 2;
+                            g_bassPulses[j].col.green = (rng_int(RNG_PULSE_COLOR, 30) / 100.00) + 0.2;
+                            g_bassPulses[j].col.blue = (rng_int(RNG_PULSE_COLOR, 10) / 100.00) + 0.9;
+                            g_bassPulses[j].col.red = (rng_int(RNG_PULSE_COLOR, 30) / 100.00) + 0.3;
+                            g_bassPulses[j].lineWidth = 30.0;
+                            g_bassPulses[j].transZ = -0.0000000001;
+                        }
+                    }
+                    g_bassPulseIndex = (g_bassPulseIndex + 1) % MAX_BASS_PULSES;
+                }
+            }
+        }
+
+        // move bass pulses out
+        for (int i = 0; i < MAX_BASS_PULSES; i++) {
+            if (g_bassPulses[i].on) {
+                if (g_bassPulses[i].rad < 10) 
+                g_bassPulses[i].rad = g_bassPulses[i].rad + 0.075 * g_frameScale;
+                g_bassPulses[i].col.red *= pulseDecay;
+                g_bassPulses[i].col.green *= pulseDecay;
+                g_bassPulses[i].col.blue *= pulseDecay;
+                g_bassPulses[i].lineWidth -= 0.01 * g_frameScale;
+                g_bassPulses[i].transZ -= 0.03 * g_frameScale;
+            }
+        }
+    }
+    
+
+//  MID PULSES
+    if (mid) {
+        // check for mid pulses
+        for (int i = 1 + ((g_windowSize / 2) / 100) * 4; i < ((g_windowSize / 2) / 100) * 80; i++) {
+            if (g_mag[i] > 0.0004) {
+                g_midPulseCounter += g_frameScale;
+                if (g_midPulseCounter >= MID_PULSE_STAGGER) {
+                    g_midPulseCounter -= MID_PULSE_STAGGER;
+                    int g_midPulseLastIndex = ((g_midPulseIndex == 0) ? MAX_MID_PULSES : g_midPulseIndex) - 1;
+                    for (int j = g_midPulseIndex; j != g_midPulseLastIndex; j = (j + 1) % MAX_MID_PULSES) {
+                        if (j == g_midPulseIndex) {
+                            // cerr << ". ";
+                            g_midPulses[j].on = true;
+                            g_midPulses[j].rad = 0.25;
+                            g_midPulses[j].col.green = (rng_int(RNG_PULSE_COLOR, 30) / 100.00) + 0.2;
+                            g_midPulses[j].col.red = (rng_int(RNG_PULSE_COLOR, 10) / 100.00) + 0.9;
+                            g_midPulses[j].col.blue = (rng_int(RNG_PULSE_COLOR, 30) / 100.00) + 0.3;
+                            g_midPulses[j].lineWidth = 5.0;
+                            g_midPulses[j].transZ = -0.000000000000;
+                        }
+                    }
+                    g_midPulseIndex = (g_midPulseIndex + 1) % MAX_MID_PULSES;
+                }
+            }
+        }
+
+        // move mid pulses out
+        for (int i = 0; i < MAX_MID_PULSES; i++) {
+            if (g_midPulses[i].on) {
+                if (g_midPulses[i].rad < 10)
+                    g_midPulses[i].rad = g_midPulses[i].rad + 0.075 * g_frameScale;
+                g_midPulses[i].col.red *= pulseDecay;
+                g_midPulses[i].col.green *= pulseDecay;
+                g_midPulses[i].col.blue *= pulseDecay;
+                g_midPulses[i].lineWidth -= 0.01 * g_frameScale;
+                g_midPulses[i].transZ -= 0.04 * g_frameScale;
+            }
+        }
+    }
+         
+    if (fd) {
+        // save frequency domain buffer state
+        // cerr << endl << endl << "Shifting buffer history by one" << endl;
+        // (only what's drawn)
+        for (int i = g_nHistoryStates - 1; i > 0; i--) {
+            memcpy(g_FDBufHistory[i], g_FDBufHistory[i - 1], sizeof(SAMPLE) * g_specPoints);
+        }
+        if (g_nHistoryStates < MAX_STATES) 
+            g_nHistoryStates++;
+        // cerr << "Copying current cBuf into history" << endl;
+        if (g_specBands)
+            filterbank_apply(&g_filterBank, g_mag, g_FDBufHistory[0]);
+        else
+            memcpy(g_FDBufHistory[0], g_mag, sizeof(SAMPLE) * g_specPoints);
+
+        // freq domain plot, one strip per history state
+        // reset x
+        float x = -g_rad * 2;
+        // compute increment
+        float xinc = ::fabs(1.2 * x / (2 * (g_windowSize / 2)));
+        // bands: spread over the same width
+        if (g_specBands)
+            xinc *= (float)(((g_windowSize / 2) / 100) * 100) / g_specPoints;
+        // scaling picks for every history state, drawn in one batch
+        rng_fill_int(RNG_SPECTRUM, g_drawState.scalePicks, g_nHistoryStates, 100);
+        for (int i = 0; i < g_nHistoryStates; i++) {
+            GLfloat * verts = g_specVerts + 2 * i * g_specPoints;
+            x = -g_rad * 2.2;
+            // shoot up scaling by percentage
+            float scalingFactor = 20;
+            if (g_drawState.scalePicks[i] > 90) 
+                scalingFactor = 13;
+            else 
+                scalingFactor = 7;
+            // loop over buffer to build spectrum
+            for(int j = 0; j < g_specPoints; j++)
+            // for(int j = 1 + ((g_windowSize / 2) / 100) * 4; j < ((g_windowSize / 2) / 100) * 100; j++)
+            {
+                // plot the magnitude,
+                // with scaling, and also "compression" via pow(...)
+                // (bands hold power, so half the exponent)
+                verts[2 * j] = x;
+                if (g_specBands)
+                    verts[2 * j + 1] = scalingFactor * pow( g_FDBufHistory[i][j], .2 );
+                else
+                    verts[2 * j + 1] = scalingFactor * pow( g_FDBufHistory[i][j], .4 );
+                // increment x
+                x += xinc;
+            }
+        }
     }
+    
+    ALLOC_CHECK_END();
+
+    // capture health: log line now and then
+    healthTick();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Name: drawView( )
+// Desc: draw the current frame into the current window, with its layers.
+//       changes nothing but gl state, so any number of windows can
+//-----------------------------------------------------------------------------
+void drawView( const View & view )
+{
+    ALLOC_CHECK_BEGIN();
+
+    // clear the color and depth buffers
+    if ((view.toggleRave || (g_forceRave && view.allowAutoRave)) && g_flash)
+        glClearColor(g_drawState.raveCol.red, g_drawState.raveCol.green, g_drawState.raveCol.blue, 1.0);
     else    
         glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
@@ -570,208 +2200,59 @@ void displayFunc( )
     // color
     glColor3f(g_centralCol.red, g_centralCol.green, g_centralCol.blue);
 
-    if (g_toggleTDWaveform) {
+    if (view.toggleTDWaveform) {
         // time domain waveform circular
         glPushMatrix();
-            glRotatef(g_zRotWavesC, 0, 0, 1);
-            glBegin(GL_POLYGON);
-                for (int i = 0; i < 360; i++)
-                {
-                    float degInRad = i * DEG2RAD;
-                    glVertex2f(cos(degInRad) * (g_rad + (1 * g_buffer[i + 360])), sin(degInRad) * (g_rad + (1 * g_buffer[i + 360])));
-                }
-                // pulsate the circle
-                    if (g_rad >= 1.4) {
-                        g_deltaRad = -(pow(avgTDWaveformVal, 0.4) / 25.0);
-                        // g_deltaRad = -0.0075;
-                    }
-                    else if (g_rad <= 1.2) {
-                        g_deltaRad = (pow(avgTDWaveformVal, 0.4) / 25.0);
-                        // g_deltaRad = 0.005;
-                    }
-                    g_rad += g_deltaRad;
-            glEnd();
-            g_zRotWavesC += 0.3;
+            glRotatef(g_drawState.zRotWavesC, 0, 0, 1);
+            glVertexPointer( 2, GL_FLOAT, 0, g_circleVerts );
+            glDrawArrays( GL_POLYGON, 0, 360 );
         glPopMatrix();
 
         // line width
         glLineWidth( 1.0 );
 
-        // apply window to buf
-        apply_window( g_buffer, g_window, g_windowSize );
-
-        // for rotating the time domain waveforms
-        glPushMatrix();
-            glRotatef(g_zRotWaves, 0, 0, 1);
-            // draw time domain waveform line plot
-            // define a starting point
-            GLfloat x = -8;
-            // compute increment
-            GLfloat xinc = ::fabs(x*2 / g_bufferSize);
-            // color
-            // glColor3f(1, 0.5, 0.5);
-            glColor3f(((rand() % 100) / 100.00), ((rand() % 100) / 100.00), ((rand() % 100) / 100.00));
-            // save transformation state
+        // the same lines, rotated two ways
+        glVertexPointer( 2, GL_FLOAT, 0, g_waveVerts );
+        for (int k = 0; k < 2; k++) {
+            if (k == 1)
+                glLineWidth(2.5);
             glPushMatrix();
-                // translate
-                glTranslatef( 0, 0, 0 );
-                // start primitive
-                glBegin( GL_LINE_STRIP );
-                    // loop over buffer
-                    for( int i = 0; i < g_bufferSize; i++ )
-                    {
-                        // plot
-                        glVertex2f( x, ((10 * g_buffer[i])) );
-                        // increment x
-                        x += xinc;
-                    }
-                // end primitive
-                glEnd();
-            // pop
-            glPopMatrix();
-
-            x = -8;
-            // save transformation state
-            glPushMatrix();
-                // translate
-                glRotatef(90, 0, 0, 1);
-                glTranslatef( 0, 0, 0 );
-                // start primitive
-                glBegin( GL_LINE_STRIP );
-                    // loop over buffer
-                    for( int i = 0; i < g_bufferSize; i++ )
-                    {
-                        // plot
-                        glVertex2f( x, ((10 * g_buffer[i])) );
-                        // increment x
-                        x += xinc;
-                    }
-                // end primitive
-                glEnd();
-            // pop
-            glPopMatrix();
-            // g_zRotWaves += ((rand() % 100) / 100.00) + 1;
-            g_zRotWaves += pow((avgTDWaveformVal * 100.00), 0.15) * 2;
-        glPopMatrix();
-
-        glLineWidth(2.5);
-
-        // for faster rotating the time domain waveforms
-        glPushMatrix();
-            glRotatef(g_zRotWaves2, 0, 0, 1);
-            // draw time domain waveform line plot
-            // define a starting point
-            x = -8;
-            // random color
-            glColor3f(((rand() % 100) / 100.00), ((rand() % 100) / 100.00), ((rand() % 100) / 100.00));
-            // save transformation state
-            glPushMatrix();
-                // translate
-                glTranslatef( 0, 0, 0 );
-                // start primitive
-                glBegin( GL_LINE_STRIP );
-                    // loop over buffer
-                    for( int i = 0; i < g_bufferSize; i++ )
-                    {
-                        // plot
-                        glVertex2f( x, ((10 * g_buffer[i])) );
-                        // increment x
-                        x += xinc;
-                    }
-                // end primitive
-                glEnd();
-            // pop
-            glPopMatrix();
-
-            x = -8;
-            // save transformation state
-            glPushMatrix();
-                // translate
-                glRotatef(90, 0, 0, 1);
-                glTranslatef( 0, 0, 0 );
-                // start primitive
-                glBegin( GL_LINE_STRIP );
-                    // loop over buffer
-                    for( int i = 0; i < g_bufferSize; i++ )
-                    {
-                        // plot
-                        glVertex2f( x, ((10 * g_buffer[i])) );
-                        // increment x
-                        x += xinc;
-                    }
-                // end primitive
-                glEnd();
-            // pop
+                glRotatef(k == 0 ? g_drawState.zRotWaves : g_drawState.zRotWaves2, 0, 0, 1);
+                glColor3f(g_drawState.lineCol[k].red, g_drawState.lineCol[k].green, g_drawState.lineCol[k].blue);
+                // save transformation state
+                glPushMatrix();
+                    // translate
+                    glTranslatef( 0, 0, 0 );
+                    glDrawArrays( GL_LINE_STRIP, 0, g_bufferSize );
+                // pop
+                glPopMatrix();
+                // save transformation state
+                glPushMatrix();
+                    // translate
+                    glRotatef(90, 0, 0, 1);
+                    glTranslatef( 0, 0, 0 );
+                    glDrawArrays( GL_LINE_STRIP, 0, g_bufferSize );
+                // pop
+                glPopMatrix();
             glPopMatrix();
-            // g_zRotWaves2 -= ((rand() % 400) / 100.00) + 2;
-            g_zRotWaves2 -= pow((avgTDWaveformVal * 100.00), 0.15) * 3;
-        glPopMatrix();
+        }
 
 
         // horizon line
-
-        x = -7;
         // save transformation state
         glPushMatrix();
             // translate
             glTranslatef( 0, 0, 0 );
             glLineWidth(12.0);
             glColor3f(g_secondaryCol.red, g_secondaryCol.green, g_secondaryCol.blue);
-            // start primitive
-            glBegin( GL_LINE_STRIP );
-                // loop over buffer
-                for( int i = 0; i < g_bufferSize; i++ )
-                {
-                    // plot
-                    glVertex2f( x, g_buffer[i] );
-                    // increment x
-                    x += xinc;
-                }
-            // end primitive
-            glEnd();
+            glVertexPointer( 2, GL_FLOAT, 0, g_horizonVerts );
+            glDrawArrays( GL_LINE_STRIP, 0, g_bufferSize );
         // pop
         glPopMatrix();
     }
-    else {
-        // apply window to buf
-        apply_window( g_buffer, g_window, g_windowSize );
-    }
-    
-    // copy into the fft buf
-    memcpy( g_fftBuf, g_buffer, sizeof(SAMPLE) * g_bufferSize );
-    
-    // take forward FFT (time domain signal -> frequency domain signal)
-    rfft( g_fftBuf, g_windowSize / 2, FFT_FORWARD );
-    // cast the result to a buffer of complex values (re,im)
-    complex * cbuf = (complex *)g_fftBuf;
 
 // BASS PULSES
-    if (g_toggleBassPulses) {
-        // check for bass pulses
-        for (int i = 0; i < ((g_windowSize / 2) / 100) * 4; i++) {
-            if (cmp_abs(cbuf[i]) > 0.001) {
-                g_bassPulseCounter = (g_bassPulseCounter + 1) % BASS_PULSE_STAGGER;
-                if (g_bassPulseCounter == 0) {
-                    // cerr << cmp_abs(cbuf[i]) << endl;
-                    int g_bassPulseLastIndex = ((g_bassPulseIndex == 0) ? MAX_BASS_PULSES : g_bassPulseIndex) - 1;
-                    for (int j = g_bassPulseIndex; j != g_bassPulseLastIndex; j = (j + 1) % MAX_BASS_PULSES) {
-                        if (j == g_bassPulseIndex) {
-                            // cerr << ". ";
-                            g_bassPulses[j].on = true;
-                            g_bassPulses[j].rad = g_rad * 2;
-                            g_bassPulses[j].col.green = (rand() % 30 / 100.00) + 0.2;
-                            g_bassPulses[j].col.blue = (rand() % 10 / 100.00) + 0.9;
-                            g_bassPulses[j].col.red = (rand() % 30 / 100.00) + 0.3;
-                            g_bassPulses[j].lineWidth = 30.0;
-                            g_bassPulses[j].transZ = -0.0000000001;
-                        }
-                    }
-                    g_bassPulseIndex = (g_bassPulseIndex + 1) % MAX_BASS_PULSES;
-                }
-            }
-        }
-
-
+    if (view.toggleBassPulses) {
         // draw bass pulses
         for (int i = 0; i < MAX_BASS_PULSES; i++) {
             // cerr << "index = " << i << endl
@@ -779,13 +2260,6 @@ void displayFunc( )
             glLineWidth(5.0);
             glColor3f(0.5, 0.5, 1.0);
             if (g_bassPulses[i].on) {
-                if (g_bassPulses[i].rad < 10) 
-                g_bassPulses[i].rad = g_bassPulses[i].rad + 0.075;
-                g_bassPulses[i].col.red -= (g_bassPulses[i].col.red * 0.005);
-                g_bassPulses[i].col.green -= (g_bassPulses[i].col.green * 0.005);
-                g_bassPulses[i].col.blue -= (g_bassPulses[i].col.blue * 0.005);
-                g_bassPulses[i].lineWidth -= 0.01;
-                g_bassPulses[i].transZ -= 0.03;
                 glPushMatrix();
                     glColor3f(g_bassPulses[i].col.red, g_bassPulses[i].col.green, g_bassPulses[i].col.blue);
                     glLineWidth(g_bassPulses[i].lineWidth);
@@ -799,30 +2273,7 @@ void displayFunc( )
     
 
 //  MID PULSES
-    if (g_toggleMidPulses) {
-        // check for mid pulses
-        for (int i = 1 + ((g_windowSize / 2) / 100) * 4; i < ((g_windowSize / 2) / 100) * 80; i++) {
-            if (cmp_abs(cbuf[i]) > 0.0004) {
-                g_midPulseCounter = (g_midPulseCounter + 1) % MID_PULSE_STAGGER;
-                if (g_midPulseCounter == 0) {
-                    int g_midPulseLastIndex = ((g_midPulseIndex == 0) ? MAX_MID_PULSES : g_midPulseIndex) - 1;
-                    for (int j = g_midPulseIndex; j != g_midPulseLastIndex; j = (j + 1) % MAX_MID_PULSES) {
-                        if (j == g_midPulseIndex) {
-                            // cerr << ". ";
-                            g_midPulses[j].on = true;
-                            g_midPulses[j].rad = 0.25;
-                            g_midPulses[j].col.green = (rand() % 30 / 100.00) + 0.2;
-                            g_midPulses[j].col.red = (rand() % 10 / 100.00) + 0.9;
-                            g_midPulses[j].col.blue = (rand() % 30 / 100.00) + 0.3;
-                            g_midPulses[j].lineWidth = 5.0;
-                            g_midPulses[j].transZ = -0.000000000000;
-                        }
-                    }
-                    g_midPulseIndex = (g_midPulseIndex + 1) % MAX_MID_PULSES;
-                }
-            }
-        }
-
+    if (view.toggleMidPulses) {
         // draw mid pulses
         for (int i = 0; i < MAX_MID_PULSES; i++) {
             // cerr << "index = " << i << endl
@@ -830,13 +2281,6 @@ void displayFunc( )
             glLineWidth(5.0);
             glColor3f(0.5, 0.5, 1.0);
             if (g_midPulses[i].on) {
-                if (g_midPulses[i].rad < 10)
-                    g_midPulses[i].rad = g_midPulses[i].rad + 0.075;
-                g_midPulses[i].col.red -= (g_midPulses[i].col.red * 0.005);
-                g_midPulses[i].col.green -= (g_midPulses[i].col.green * 0.005);
-                g_midPulses[i].col.blue -= (g_midPulses[i].col.blue * 0.005);
-                g_midPulses[i].lineWidth -= 0.01;
-                g_midPulses[i].transZ -= 0.04;
                 glPushMatrix();
                     glColor3f(g_midPulses[i].col.red, g_midPulses[i].col.green, g_midPulses[i].col.blue);
                     glLineWidth(g_midPulses[i].lineWidth);
@@ -848,32 +2292,15 @@ void displayFunc( )
         }
     }
          
-    if (g_toggleFDWaveform) {
-        // save frequency domain buffer state
-        // cerr << endl << endl << "Shifting buffer history by one" << endl;
-        for (int i = g_nHistoryStates - 1; i > 0; i--) {
-            memcpy(g_FDBufHistory[i], g_FDBufHistory[i - 1], sizeof(complex) * (g_windowSize / 2));
-        }
-        if (g_nHistoryStates < MAX_STATES) 
-            g_nHistoryStates++;
-        // cerr << "Copying current cBuf into history" << endl;
-        memcpy(g_FDBufHistory[0], cbuf, sizeof(complex) * (g_windowSize / 2));
-
-        
+    if (view.toggleFDWaveform) {
         // Drawing freq domain plot
         glPushMatrix();
             glLineWidth(2);
-            // define a starting point
             // set color to green
             // glColor3f(1, 1, 1);
             glColor3f(g_secondaryCol.red, g_secondaryCol.green, g_secondaryCol.blue);
-            // reset x
-            float x = -g_rad * 2;
-            // compute increment
-            float xinc = ::fabs(1.2 * x / (2 * (g_windowSize / 2)));
             // glRotatef(-25, 1, 0, 0);
             glTranslatef(0, 0, 0.00001);
-            // glColor3f(((rand() % 100) / 100.00), ((rand() % 100) / 100.00), ((rand() % 100) / 100.00));
             // for (int i = 0; i < 1; i++) {
             for (int i = 0; i < g_nHistoryStates; i++) {
                 glPushMatrix();
@@ -884,27 +2311,8 @@ void displayFunc( )
                     glPushMatrix();
                         // translate
                         // glTranslatef(0, -1, -(i / 2.0));
-                        // start primitive
-                        glBegin( GL_LINE_STRIP );
-                            x = -g_rad * 2.2;
-                            // shoot up scaling by percentage
-                            float scalingFactor = 20;
-                            if (rand() % 100 > 90) 
-                                scalingFactor = 13;
-                            else 
-                                scalingFactor = 7;
-                            // loop over buffer to draw spectrum
-                            for(int j = 0; j < ((g_windowSize / 2) / 100) * 100; j++)
-                            // for(int j = 1 + ((g_windowSize / 2) / 100) * 4; j < ((g_windowSize / 2) / 100) * 100; j++)
-                            {
-                                // plot the magnitude,
-                                // with scaling, and also "compression" via pow(...)
-                                glVertex2f( x, scalingFactor * pow( cmp_abs(g_FDBufHistory[i][j]), .4 ) );
-                                // increment x
-                                x += xinc;
-                            }
-                        // end primitive
-                        glEnd();
+                        glVertexPointer( 2, GL_FLOAT, 0, g_specVerts + 2 * i * g_specPoints );
+                        glDrawArrays( GL_LINE_STRIP, 0, g_specPoints );
                     glPopMatrix();
                 // restore transformations
                 glPopMatrix();
@@ -931,8 +2339,5 @@ void displayFunc( )
         //     g_rad2 += g_deltaRad2;
         // glEnd();
     
-    // flush!
-    glFlush( );
-    // swap the double buffer
-    glutSwapBuffers( );
+    ALLOC_CHECK_END();
 }
@@ -0,0 +1,504 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - wavfile.cpp
+// desc: minimal WAV and AIFF reader
+//-----------------------------------------------------------------------------
+#include "wavfile.h"
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+using namespace std;
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: le16() / le32()
+// desc: little endian field access, independent of host byte order
+//-----------------------------------------------------------------------------
+static inline uint32_t le16( const unsigned char * p )
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t le32( const unsigned char * p )
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t le64( const unsigned char * p )
+{
+    return le32( p ) | ((uint64_t)le32( p + 4 ) << 32);
+}
+
+static inline uint32_t be16( const unsigned char * p )
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t be32( const unsigned char * p )
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: supported()
+// desc: a layout we can decode; checked before anything divides by the
+//       frame size, which is 0 for no channels or sub-byte samples
+//-----------------------------------------------------------------------------
+static bool supported( const WavFile * wav )
+{
+    return wav->channels > 0 &&
+        ( (wav->format == WAV_FORMAT_PCM && (wav->bitsPerSample == 8 ||
+           wav->bitsPerSample == 16 || wav->bitsPerSample == 24 ||
+           wav->bitsPerSample == 32)) ||
+          (wav->format == WAV_FORMAT_FLOAT && (wav->bitsPerSample == 32 ||
+           wav->bitsPerSample == 64)) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: aiffOpen()
+// desc: the FORM's COMM and SSND chunks; AIFF-C only in its uncompressed
+//       flavours (big-endian or "sowt" little-endian PCM, 32/64-bit float).
+//       the rate is an 80-bit extended float
+//-----------------------------------------------------------------------------
+static bool aiffOpen( WavFile * wav, bool aifc )
+{
+    bool haveComm = false;
+    unsigned char chunk[8];
+    wav->format = WAV_FORMAT_PCM;
+    wav->aiff = true;
+    wav->bigEndian = true;
+    while( fread( chunk, 1, 8, wav->fd ) == 8 )
+    {
+        uint32_t size = be32( chunk + 4 );
+        if( !memcmp( chunk, "COMM", 4 ) )
+        {
+            unsigned char comm[22];
+            uint32_t n = size < sizeof(comm) ? size : sizeof(comm);
+            if( n < 18 || fread( comm, 1, n, wav->fd ) != n )
+                return false;
+            wav->channels = be16( comm );
+            wav->frames = be32( comm + 2 );
+            wav->bitsPerSample = be16( comm + 6 );
+            int exponent = (int)(be16( comm + 8 ) & 0x7fff) - 16383 - 63;
+            uint64_t mantissa = ((uint64_t)be32( comm + 10 ) << 32) | be32( comm + 14 );
+            wav->srate = (unsigned int)(ldexp( (double)mantissa, exponent ) + 0.5);
+            if( aifc && n >= 22 )
+            {
+                if( !memcmp( comm + 18, "sowt", 4 ) )
+                    wav->bigEndian = false;
+                else if( !memcmp( comm + 18, "fl32", 4 ) || !memcmp( comm + 18, "FL32", 4 ) ||
+                         !memcmp( comm + 18, "fl64", 4 ) || !memcmp( comm + 18, "FL64", 4 ) )
+                    wav->format = WAV_FORMAT_FLOAT;
+                else if( memcmp( comm + 18, "NONE", 4 ) )
+                    return false;
+            }
+            fseek( wav->fd, size - n + (size & 1), SEEK_CUR );
+            haveComm = true;
+        }
+        else if( !memcmp( chunk, "SSND", 4 ) )
+        {
+            unsigned char ssnd[8];
+            if( !haveComm || !supported( wav ) || fread( ssnd, 1, 8, wav->fd ) != 8 )
+                return false;
+            wav->dataOffset = ftell( wav->fd ) + be32( ssnd );
+            // the header's frame count, unless the chunk holds fewer
+            long room = (size - 8 - be32( ssnd )) / (wav->channels * (wav->bitsPerSample / 8));
+            if( room < wav->frames )
+                wav->frames = room;
+            return true;
+        }
+        else
+            fseek( wav->fd, size + (size & 1), SEEK_CUR );
+    }
+    return false;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: mapFile()
+// desc: map the whole file for reading front to back; a header that
+//       claims more frames than the file holds (a recording cut short)
+//       is cut down to what's there, so no read runs off the mapping
+//-----------------------------------------------------------------------------
+static void mapFile( WavFile * wav )
+{
+    struct stat st;
+    int fd = fileno( wav->fd );
+    if( fstat( fd, &st ) || st.st_size <= wav->dataOffset )
+        return;
+    void * map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( map == MAP_FAILED )
+        return;
+    madvise( map, st.st_size, MADV_SEQUENTIAL );
+    wav->map = (const unsigned char *)map;
+    wav->mapSize = st.st_size;
+
+    long held = (st.st_size - wav->dataOffset) / (wav->channels * (wav->bitsPerSample / 8));
+    if( held < wav->frames )
+        wav->frames = held;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: wav_open()
+// desc: walk the RIFF chunks for "fmt " and "data"; in RF64 the sizes
+//       that don't fit 32 bits are in a "ds64" chunk up front
+//-----------------------------------------------------------------------------
+bool wav_open( WavFile * wav, const char * path )
+{
+    memset( wav, 0, sizeof(WavFile) );
+    wav->fd = fopen( path, "rb" );
+    if( !wav->fd )
+    {
+        cerr << "wav: can't open " << path << endl;
+        return false;
+    }
+
+    unsigned char hdr[12];
+    bool read = fread( hdr, 1, 12, wav->fd ) == 12;
+    bool aiff = read && !memcmp( hdr, "FORM", 4 ) &&
+        (!memcmp( hdr + 8, "AIFF", 4 ) || !memcmp( hdr + 8, "AIFC", 4 ));
+    if( !aiff && (!read || (memcmp( hdr, "RIFF", 4 ) && memcmp( hdr, "RF64", 4 )) ||
+                  memcmp( hdr + 8, "WAVE", 4 )) )
+    {
+        cerr << "wav: " << path << " is not a RIFF/WAVE, RF64 or AIFF file" << endl;
+        wav_close( wav );
+        return false;
+    }
+
+    bool haveFmt = aiff && aiffOpen( wav, !memcmp( hdr + 8, "AIFC", 4 ) );
+    uint64_t dataSize64 = 0;
+    unsigned char chunk[8];
+    while( !aiff && fread( chunk, 1, 8, wav->fd ) == 8 )
+    {
+        uint32_t size = le32( chunk + 4 );
+        if( !memcmp( chunk, "ds64", 4 ) )
+        {
+            // riff size, data size, sample count, table
+            unsigned char ds64[16];
+            if( size < 16 || fread( ds64, 1, 16, wav->fd ) != 16 )
+                break;
+            dataSize64 = le64( ds64 + 8 );
+            fseek( wav->fd, size - 16 + (size & 1), SEEK_CUR );
+        }
+        else if( !memcmp( chunk, "fmt ", 4 ) )
+        {
+            unsigned char fmt[40];
+            uint32_t n = size < sizeof(fmt) ? size : sizeof(fmt);
+            if( n < 16 || fread( fmt, 1, n, wav->fd ) != n )
+                break;
+            wav->format = le16( fmt );
+            wav->channels = le16( fmt + 2 );
+            wav->srate = le32( fmt + 4 );
+            wav->bitsPerSample = le16( fmt + 14 );
+            // extensible: the real format is the first word of the subformat GUID
+            if( wav->format == WAV_FORMAT_EXTENSIBLE && n >= 26 )
+                wav->format = le16( fmt + 24 );
+            fseek( wav->fd, size - n + (size & 1), SEEK_CUR );
+            haveFmt = true;
+        }
+        else if( !memcmp( chunk, "data", 4 ) )
+        {
+            if( !haveFmt || !supported( wav ) )
+                break;
+            wav->dataOffset = ftell( wav->fd );
+            uint64_t bytes = size == 0xFFFFFFFF && dataSize64 ? dataSize64 : size;
+            wav->frames = bytes / (wav->channels * (wav->bitsPerSample / 8));
+            break;
+        }
+        else
+            fseek( wav->fd, size + (size & 1), SEEK_CUR );
+    }
+
+    if( wav->dataOffset <= 0 || !supported( wav ) )
+    {
+        cerr << "wav: " << path << ": unsupported or missing format/data" << endl;
+        wav_close( wav );
+        return false;
+    }
+
+    if( !aiff )
+        mapFile( wav );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: sample_at()
+// desc: decode one sample to float in [-1, 1)
+//-----------------------------------------------------------------------------
+static inline float sample_at( const unsigned char * p, unsigned int bits,
+                               unsigned int format )
+{
+    if( format == WAV_FORMAT_FLOAT )
+    {
+        if( bits == 32 )
+        {
+            uint32_t u = le32( p ); float f;
+            memcpy( &f, &u, 4 );
+            return f;
+        }
+        uint64_t u = le32( p ) | ((uint64_t)le32( p + 4 ) << 32); double d;
+        memcpy( &d, &u, 8 );
+        return (float)d;
+    }
+
+    switch( bits )
+    {
+        case 8: return (p[0] - 128) / 128.0f;
+        case 16: return (int16_t)le16( p ) / 32768.0f;
+        case 24: return (int32_t)(le32( p - 1 ) & 0xFFFFFF00) / 2147483648.0f;
+        default: return (int32_t)le32( p ) / 2147483648.0f;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: convert()
+// desc: n frames, as WAV stores them, to mono float in out and, if
+//       windowed isn't NULL, times window in windowed. one instance per
+//       sample format, so the per-sample decode has no branches left
+//-----------------------------------------------------------------------------
+template<unsigned int BITS, unsigned int FORMAT>
+static void convertAs( const unsigned char * raw, long n, unsigned int channels,
+                       float * out, const float * window, float * windowed )
+{
+    const unsigned int frameBytes = BITS / 8 * channels;
+    const float gain = 1.0f / channels;
+    for( long i = 0; i < n; i++, raw += frameBytes )
+    {
+        float sum = 0;
+        for( unsigned int c = 0; c < channels; c++ )
+            sum += sample_at( raw + c * (BITS / 8), BITS, FORMAT );
+        out[i] = sum * gain;
+        if( windowed )
+            windowed[i] = out[i] * window[i];
+    }
+}
+
+static void convert( const WavFile * wav, const unsigned char * raw, long n,
+                     float * out, const float * window, float * windowed )
+{
+    unsigned int ch = wav->channels;
+    if( wav->format == WAV_FORMAT_FLOAT )
+    {
+        if( wav->bitsPerSample == 32 )
+            convertAs<32, WAV_FORMAT_FLOAT>( raw, n, ch, out, window, windowed );
+        else
+            convertAs<64, WAV_FORMAT_FLOAT>( raw, n, ch, out, window, windowed );
+        return;
+    }
+    switch( wav->bitsPerSample )
+    {
+        case 8: convertAs<8, WAV_FORMAT_PCM>( raw, n, ch, out, window, windowed ); break;
+        case 16: convertAs<16, WAV_FORMAT_PCM>( raw, n, ch, out, window, windowed ); break;
+        case 24: convertAs<24, WAV_FORMAT_PCM>( raw, n, ch, out, window, windowed ); break;
+        default: convertAs<32, WAV_FORMAT_PCM>( raw, n, ch, out, window, windowed ); break;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: toWavLayout()
+// desc: AIFF samples as WAV would store them: little-endian, 8-bit
+//       offset binary
+//-----------------------------------------------------------------------------
+static void toWavLayout( unsigned char * p, long samples, unsigned int bytes, bool bigEndian )
+{
+    if( bytes == 1 )
+    {
+        for( long i = 0; i < samples; i++ )
+            p[i] ^= 0x80;
+        return;
+    }
+    if( !bigEndian )
+        return;
+    for( long i = 0; i < samples; i++, p += bytes )
+        for( unsigned int a = 0, b = bytes - 1; a < b; a++, b-- )
+        {
+            unsigned char t = p[a];
+            p[a] = p[b];
+            p[b] = t;
+        }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: wav_read() / wav_read_windowed()
+// desc: mapped, convert straight out of the mapping; otherwise seek, read in
+//       fixed-size chunks and convert those
+//-----------------------------------------------------------------------------
+static long readFrames( WavFile * wav, long start, float * out, const float * window,
+                        float * windowed, long count )
+{
+    long avail = wav->frames - start;
+    if( avail < 0 ) avail = 0;
+    long n = count < avail ? count : avail;
+
+    const unsigned int bytes = wav->bitsPerSample / 8;
+    const long frameBytes = bytes * wav->channels;
+    long done = 0;
+    if( wav->map )
+    {
+        convert( wav, wav->map + wav->dataOffset + start * frameBytes, n, out, window, windowed );
+        done = n;
+    }
+    else
+    {
+        // one extra leading byte so 24-bit samples can be read as a 32-bit word
+        unsigned char raw[1 + 8192];
+        const long chunkFrames = 8192 / frameBytes;
+
+        fseek( wav->fd, wav->dataOffset + start * frameBytes, SEEK_SET );
+        while( done < n )
+        {
+            long want = n - done < chunkFrames ? n - done : chunkFrames;
+            long got = fread( raw + 1, frameBytes, want, wav->fd );
+            if( wav->aiff )
+                toWavLayout( raw + 1, got * wav->channels, bytes, wav->bigEndian );
+            convert( wav, raw + 1, got, out + done, window ? window + done : NULL,
+                     windowed ? windowed + done : NULL );
+            done += got;
+            if( got < want )
+                break;
+        }
+    }
+
+    // zero-fill the remainder
+    for( long i = done; i < count; i++ )
+        out[i] = 0;
+    for( long i = done; windowed && i < count; i++ )
+        windowed[i] = 0;
+
+    return done;
+}
+
+long wav_read( WavFile * wav, long start, float * out, long count )
+{
+    return readFrames( wav, start, out, NULL, NULL, count );
+}
+
+long wav_read_windowed( WavFile * wav, long start, const float * window, float * out,
+                        float * windowed, long count )
+{
+    return readFrames( wav, start, out, window, windowed, count );
+}
+
+const float * wav_view( WavFile * wav, long start, long count )
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if( wav->map && wav->format == WAV_FORMAT_FLOAT && wav->bitsPerSample == 32 &&
+        wav->channels == 1 && wav->dataOffset % sizeof(float) == 0 &&
+        start >= 0 && start + count <= wav->frames )
+        return (const float *)(wav->map + wav->dataOffset) + start;
+#endif
+    return NULL;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: hashWords()
+// desc: FNV-1a's step on 8-byte words instead of bytes, over four lanes
+//       taking a word in turn, so the multiplies don't wait on each other;
+//       bytes past the last whole 32 go through lane 0 one at a time
+//-----------------------------------------------------------------------------
+#define HASH_PRIME 0x100000001b3ULL
+
+static void hashWords( uint64_t * lanes, const unsigned char * p, size_t n )
+{
+    size_t i = 0;
+    for( ; i + 32 <= n; i += 32 )
+        for( int k = 0; k < 4; k++ )
+        {
+            uint64_t w;
+            memcpy( &w, p + i + 8 * k, 8 );
+            lanes[k] = (lanes[k] ^ w) * HASH_PRIME;
+        }
+    for( ; i < n; i++ )
+        lanes[0] = (lanes[0] ^ p[i]) * HASH_PRIME;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: wav_hash()
+// desc: the format fields, the data's length and its words, off the
+//       mapping or read in large chunks (whole 32s, so the lanes line up
+//       the same either way); memory speed, or disk speed cold, once per
+//       render
+//-----------------------------------------------------------------------------
+uint64_t wav_hash( WavFile * wav )
+{
+    uint64_t lanes[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL,
+                          0xcbf29ce4cbf29ce4ULL, 0x8422232584222325ULL };
+    long left = wav->frames * wav->channels * (wav->bitsPerSample / 8);
+    if( wav->map )
+        hashWords( lanes, wav->map + wav->dataOffset, left );
+    else
+    {
+        unsigned char raw[65536];
+        fseek( wav->fd, wav->dataOffset, SEEK_SET );
+        while( left > 0 )
+        {
+            size_t want = left < (long)sizeof(raw) ? left : sizeof(raw);
+            size_t got = fread( raw, 1, want, wav->fd );
+            hashWords( lanes, raw, got );
+            if( got < want )
+                break;
+            left -= got;
+        }
+    }
+
+    uint64_t words[9] = { wav->srate, wav->channels, wav->bitsPerSample, wav->format,
+                          (uint64_t)wav->frames, lanes[0], lanes[1], lanes[2], lanes[3] };
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for( int i = 0; i < 9; i++ )
+        h = (h ^ words[i]) * HASH_PRIME;
+    return h;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: wav_close()
+// desc: release the file
+//-----------------------------------------------------------------------------
+void wav_close( WavFile * wav )
+{
+    if( wav->map )
+        munmap( (void *)wav->map, wav->mapSize );
+    wav->map = NULL;
+    if( wav->fd )
+        fclose( wav->fd );
+    wav->fd = NULL;
+}
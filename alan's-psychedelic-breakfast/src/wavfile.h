@@ -0,0 +1,56 @@
+//-----------------------------------------------------------------------------
+// name: Alan's Psychedelic Breakfast - wavfile.h
+// desc: minimal WAV (RF64 too, past 4 GB) and AIFF/AIFF-C reader for
+//       offline renders and the decoder; PCM 8/16/24/32-bit and float
+//       32/64, any channel count, read back as mono float. WAVs are
+//       mapped, not read: blocks convert straight out of the page cache,
+//       and a float32 mono file's blocks are views of it, no copy at all
+//-----------------------------------------------------------------------------
+#ifndef __APB_WAVFILE_H__
+#define __APB_WAVFILE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+struct WavFile
+{
+    FILE * fd;
+    unsigned int srate;
+    unsigned int channels;
+    unsigned int bitsPerSample;
+    // 1 = integer PCM, 3 = IEEE float
+    unsigned int format;
+    // AIFF: 8-bit samples are signed, and the rest big-endian unless
+    // it's AIFF-C "sowt"
+    bool aiff;
+    bool bigEndian;
+    long dataOffset;
+    // length in sample frames
+    long frames;
+    // the whole file, mapped read-only (WAV only; NULL where it can't be)
+    const unsigned char * map;
+    size_t mapSize;
+};
+
+// open and parse the header (WAV or AIFF, by its signature); prints the
+// reason and returns false on failure
+bool wav_open( WavFile * wav, const char * path );
+// read up to count frames starting at frame start, mixed down to mono;
+// frames past the end are zero-filled. returns frames actually read
+long wav_read( WavFile * wav, long start, float * out, long count );
+// the same, and in the same pass out[i] * window[i] into windowed
+long wav_read_windowed( WavFile * wav, long start, const float * window, float * out,
+                        float * windowed, long count );
+// count frames from start as they lie in the mapping, if the file is
+// float32 mono and they're all there; NULL if not (use wav_read then)
+const float * wav_view( WavFile * wav, long start, long count );
+// 64-bit hash of the sample data as stored (the data chunk), with the
+// format; the same audio hashes the same whatever else the file holds
+uint64_t wav_hash( WavFile * wav );
+// close the file
+void wav_close( WavFile * wav );
+
+
+#endif